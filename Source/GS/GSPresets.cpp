@@ -12,8 +12,8 @@ GSPresets::GSPresets()
 {
     parseXmlInfo();
 
-    addSynthsPresets();
-    sort();
+    // Built right away, so that the audio thread has a set from its first block
+    publishPresetSet(buildPresetSet(PresetSettings(), nullptr));
 }
 
 void GSPresets::parseXmlInfo()
@@ -78,7 +78,7 @@ void GSPresets::parseXmlInfo()
     }
 }
 
-ADSR GSPresets::getADSRInfo(int programId)
+ADSR GSPresets::getADSRInfo(int programId) const
 {
     switch (programId)
     {
@@ -151,14 +151,14 @@ ADSR GSPresets::getADSRInfo(int programId)
     return ADSR();
 }
 
-void GSPresets::addSynthsPresets()
+void GSPresets::addSynthsPresets(PresetSet& set) const
 {
     auto addAll = [&](auto& list)
     {
         for (auto& id : list)
         {
             if (auto* preset = buildGSSynthPreset(static_cast<uint8_t>(id)))
-                m_presets.push_back(preset);
+                set.m_presets.push_back(preset);
         }
     };
 
@@ -167,7 +167,7 @@ void GSPresets::addSynthsPresets()
     addAll(m_triPresets);
 }
 
-bool GSPresets::validateGSSynth(unsigned short presetId, const std::string& synthName, const ADSR& adsr)
+bool GSPresets::validateGSSynth(unsigned short presetId, const std::string& synthName, const ADSR& adsr) const
 {
     if (m_pwmPresets.empty() && m_sawPresets.empty() && m_triPresets.empty())
         return false;
@@ -206,7 +206,7 @@ bool GSPresets::validateGSSynth(unsigned short presetId, const std::string& synt
     return bIsValid;
 }
 
-Preset* GSPresets::buildCustomSynthPreset(unsigned short presetId, const std::string& synthName, const ADSR& adsr)
+Preset* GSPresets::buildCustomSynthPreset(unsigned short presetId, const std::string& synthName, const ADSR& adsr) const
 {
     if (!validateGSSynth(presetId, synthName, adsr))
         return nullptr;
@@ -214,7 +214,7 @@ Preset* GSPresets::buildCustomSynthPreset(unsigned short presetId, const std::st
     return buildGSSynthPreset(presetId);
 }
 
-Preset* GSPresets::buildGSSynthPreset(unsigned short presetId)
+Preset* GSPresets::buildGSSynthPreset(unsigned short presetId) const
 {
     const auto bankId = 0;
 
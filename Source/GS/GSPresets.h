@@ -8,18 +8,18 @@ struct GSPresets : public PresetsHandler
 {
     GSPresets();
 
-    void addSynthsPresets() override;
+    void addSynthsPresets(PresetSet& set) const override;
     const ProgramList& getGamesProgramList() const override;
 
-    Preset* buildCustomSynthPreset(unsigned short presetId, const std::string& synthName, const ADSR& adsr) override;
+    Preset* buildCustomSynthPreset(unsigned short presetId, const std::string& synthName, const ADSR& adsr) const override;
 
 private:
     void parseXmlInfo();
 
-    ADSR getADSRInfo(int programId);
+    ADSR getADSRInfo(int programId) const;
 
-    bool validateGSSynth(unsigned short presetId, const std::string& synthName, const ADSR& adsr);
-    Preset* buildGSSynthPreset(unsigned short presetId);
+    bool validateGSSynth(unsigned short presetId, const std::string& synthName, const ADSR& adsr) const;
+    Preset* buildGSSynthPreset(unsigned short presetId) const;
 
     std::vector<int> m_pwmPresets;
     std::vector<int> m_sawPresets;
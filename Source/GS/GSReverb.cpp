@@ -1,5 +1,6 @@
 #include "GSReverb.h"
 
+#include <algorithm>
 #include <assert.h>
 
 namespace GSVST {
@@ -15,12 +16,21 @@ ReverbGS1::~ReverbGS1()
 {
 }
 
+void ReverbGS1::Reset()
+{
+    ReverbEffect::Reset();
+
+    std::fill(gsBuffer.begin(), gsBuffer.end(), sample{ 0.0f, 0.0f });
+    bufferPos2 = 0;
+    resetGS = false;
+}
+
 size_t ReverbGS1::getBlocksPerGsBuffer() const
 {
     return gsBuffer.size();
 }
 
-size_t ReverbGS1::processInternal(sample* buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
+size_t ReverbGS1::processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
 {
     auto requestedNumSamples = numSamples;
 
@@ -60,14 +70,14 @@ size_t ReverbGS1::processInternal(sample* buffer, const size_t numSamples, const
     size_t processedSamples = c;
 
     do {
-        float mixL = buffer->left  + gsBuffer[bufferPos2].left;
-        float mixR = buffer->right + gsBuffer[bufferPos2].right;
+        float mixL = *buffer.left  + gsBuffer[bufferPos2].left;
+        float mixR = *buffer.right + gsBuffer[bufferPos2].right;
 
         float lA = rbuf[bufferPos].left;
         float rA = rbuf[bufferPos].right;
 
-        buffer->left  = rbuf[bufferPos].left  = mixL;
-        buffer->right = rbuf[bufferPos].right = mixR;
+        *buffer.left  = rbuf[bufferPos].left  = mixL;
+        *buffer.right = rbuf[bufferPos].right = mixR;
 
         float lRMix = 0.25f * mixL + 0.25f * rA;
         float rRMix = 0.25f * mixR + 0.25f * lA;
@@ -75,7 +85,7 @@ size_t ReverbGS1::processInternal(sample* buffer, const size_t numSamples, const
         gsBuffer[bufferPos2].left  = lRMix;
         gsBuffer[bufferPos2].right = rRMix;
 
-        buffer++;
+        buffer += 1;
 
         bufferPos++;
         bufferPos2++;
@@ -111,7 +121,18 @@ ReverbGS2::~ReverbGS2()
 {
 }
 
-size_t ReverbGS2::processInternal(sample *buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
+void ReverbGS2::Reset()
+{
+    ReverbEffect::Reset();
+
+    std::fill(gs2Buffer.begin(), gs2Buffer.end(), sample{ 0.0f, 0.0f });
+    bufferPos2 = (getBlocksPerBuffer() * 176) / 528;
+    gs2Pos = 0;
+    reset2 = false;
+    resetgs2 = false;
+}
+
+size_t ReverbGS2::processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
 {
     assert(numSamples > 0);
     std::vector<sample>& rbuf = reverbBuffer;
@@ -162,14 +183,14 @@ size_t ReverbGS2::processInternal(sample *buffer, const size_t numSamples, const
     size_t processedSamples = c;
 
     do {
-        float mixL = buffer->left  + gs2Buffer[gs2Pos].left;
-        float mixR = buffer->right + gs2Buffer[gs2Pos].right;
+        float mixL = *buffer.left  + gs2Buffer[gs2Pos].left;
+        float mixR = *buffer.right + gs2Buffer[gs2Pos].right;
 
         float lA = rbuf[bufferPos].left;
         float rA = rbuf[bufferPos].right;
 
-        buffer->left  = rbuf[bufferPos].left  = mixL;
-        buffer->right = rbuf[bufferPos].right = mixR;
+        *buffer.left  = rbuf[bufferPos].left  = mixL;
+        *buffer.right = rbuf[bufferPos].right = mixR;
 
         float lRMix = lA * rPrimFac + rA * rSecFac;
         float rRMix = rA * rPrimFac + lA * rSecFac;
@@ -180,7 +201,7 @@ size_t ReverbGS2::processInternal(sample *buffer, const size_t numSamples, const
         gs2Buffer[gs2Pos].left  = lRMix + lB;
         gs2Buffer[gs2Pos].right = rRMix + rB;
 
-        buffer++;
+        buffer += 1;
 
         bufferPos++;
         bufferPos2++;
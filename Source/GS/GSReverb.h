@@ -9,8 +9,10 @@ class ReverbGS1 : public ReverbEffect
 public:
     ReverbGS1(uint8_t intensity, size_t samplesPerBufferForComputation, uint8_t numAgbBuffers);
     ~ReverbGS1() override;
+    void Reset() override;
+    bool UsesIntensity() const override { return false; }
 protected:
-    size_t processInternal(sample *buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate) override;
+    size_t processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate) override;
     size_t getBlocksPerGsBuffer() const;
     std::vector<sample> gsBuffer;
 
@@ -23,8 +25,10 @@ public:
     ReverbGS2(uint8_t intesity, size_t samplesPerBufferForComputation, uint8_t numAgbBuffers,
             float rPrimFac, float rSecFac);
     ~ReverbGS2() override;
+    void Reset() override;
+    bool UsesIntensity() const override { return false; }
 protected:
-    size_t processInternal(sample *buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate) override;
+    size_t processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate) override;
     std::vector<sample> gs2Buffer;
     size_t gs2Pos;
     float rPrimFac, rSecFac;
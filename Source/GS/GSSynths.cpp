@@ -1,10 +1,13 @@
 #include "GSSynths.h"
+#include "Processor/VoicePool.h"
+#include "Processor/DSPKernels.h"
 
 #include <assert.h>
+#include <algorithm>
 
 namespace GSVST {
 
-GSSynth* GSSynth::createSynth(EDSPType type, const Note& in_note)
+GSSynth* GSSynth::createSynth(EDSPType type, const Note& in_note, VoicePool& pool)
 {
     switch (type)
     {
@@ -15,17 +18,17 @@ GSSynth* GSSynth::createSynth(EDSPType type, const Note& in_note)
         assert(false);
         break;
     case EDSPType::Saw:
-        return new GSSawSynth(in_note);
+        return pool.createVoice<GSSawSynth>(in_note);
     case EDSPType::Tri:
-        return new GSTriangleSynth(in_note);
+        return pool.createVoice<GSTriangleSynth>(in_note);
     }
 
     return nullptr;
 }
 
-GSPWMSynth* GSPWMSynth::createPWMSynth(const PWMData& pwmdata, const Note& in_note)
+GSPWMSynth* GSPWMSynth::createPWMSynth(const PWMData& pwmdata, const Note& in_note, VoicePool& pool)
 {
-    return new GSPWMSynth(pwmdata, in_note);
+    return pool.createVoice<GSPWMSynth>(pwmdata, in_note);
 }
 
 void GSSynth::updateArgs(const MixingArgs& args)
@@ -75,92 +78,122 @@ void GSPWMSynth::processStart(const MixingArgs& args, size_t currentSample, size
     }
 }
 
-void GSPWMSynth::process(sample* buffer, size_t numSamples, const MixingArgs& args)
+size_t GSSynth::getRunSize(size_t numSamples, const MixingArgs& args) const
 {
+    assert(args.scratchBuffer && args.scratchSize > 0);
+    return std::min({ numSamples, getSamplesUntilUpdate(args), args.scratchSize });
+}
+
+template <typename TSynth>
+void GSSynth::processWave(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
+{
+    auto* synth = static_cast<TSynth*>(this);
+    const auto& kernels = getDSPKernels();
+
+    // The wave is generated in the left side of the scratch buffer, one sub-frame at most at a time,
+    // then mixed to both sides
     size_t i = 0;
     do {
-        processStart(args, i, numSamples);
+        synth->processStart(args, i, numSamples);
 
-        float baseSamp = interPos < m_fThreshold ? 0.5f : -0.5f;
-        // correct dc offset
-        baseSamp += 0.5f - m_fThreshold;
-        m_fThreshold += m_threshStep;
-        buffer->left += baseSamp * cargs.lVol;
-        buffer->right += baseSamp * cargs.rVol;
-        buffer++;
-        i++;
+        const size_t runSize = getRunSize(numSamples, args);
+        float* wave = args.scratchBuffer.left;
+        synth->generate(wave, runSize);
+
+        mixRun(buffer, { wave, wave }, runSize, i, args, kernels);
+        numSamples -= runSize;
+    } while (numSamples > 0);
+}
+
+void GSPWMSynth::process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
+{
+    processWave<GSPWMSynth>(buffer, numSamples, args);
+}
+
+void GSPWMSynth::generate(float* wave, size_t numSamples)
+{
+    // Local copies: the wave could alias the members as far as the compiler knows
+    const float interStep = cargs.interStep;
+    const float threshStep = m_threshStep;
+    float phase = interPos;
+    float threshold = m_fThreshold;
 
-        cargs.lVol += cargs.lVolStep;
-        cargs.rVol += cargs.rVolStep;
+    for (size_t k = 0; k < numSamples; k++)
+    {
+        float baseSamp = phase < threshold ? 0.5f : -0.5f;
+        // correct dc offset
+        baseSamp += 0.5f - threshold;
+        threshold += threshStep;
+        wave[k] = baseSamp;
 
-        interPos += cargs.interStep;
+        phase += interStep;
         // this below might glitch for too high frequencies, which usually shouldn't be used anyway
-        if (interPos >= 1.0f) interPos -= 1.0f;
+        if (phase >= 1.0f) phase -= 1.0f;
+    }
 
-        processEnd(args, i);
-    } while (--numSamples > 0);
+    interPos = phase;
+    m_fThreshold = threshold;
 }
 
-void GSSawSynth::process(sample* buffer, size_t numSamples, const MixingArgs& args)
+void GSSawSynth::process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
 {
-    const uint32_t fix = 0x70;
+    processWave<GSSawSynth>(buffer, numSamples, args);
+}
 
-    size_t i = 0;
-    do {
-        processStart(args, i, numSamples);
+void GSSawSynth::generate(float* wave, size_t numSamples)
+{
+    const uint32_t fix = 0x70;
+    const float interStep = cargs.interStep;
+    float phase = interPos;
+    uint32_t acc = pos;
 
+    for (size_t k = 0; k < numSamples; k++)
+    {
         /*
          * Sorry that the baseSamp calculation looks ugly.
          * For accuracy it's a 1 to 1 translation of the original assembly code
          * Could probably be reimplemented easier. Not sure if it's a perfect saw wave
          */
-        interPos += cargs.interStep;
-        if (interPos >= 1.0f) interPos -= 1.0f;
-        uint32_t var1 = uint32_t(interPos * 256) - fix;
-        uint32_t var2 = uint32_t(interPos * 65536.0f) << 17;
+        phase += interStep;
+        if (phase >= 1.0f) phase -= 1.0f;
+        uint32_t var1 = uint32_t(phase * 256) - fix;
+        uint32_t var2 = uint32_t(phase * 65536.0f) << 17;
         uint32_t var3 = var1 - (var2 >> 27);
-        pos = var3 + uint32_t(int32_t(pos) >> 1);
+        acc = var3 + uint32_t(int32_t(acc) >> 1);
 
-        float baseSamp = float((int32_t)pos) / 256.0f;
-
-        buffer->left += baseSamp * cargs.lVol;
-        buffer->right += baseSamp * cargs.rVol;
-        buffer++;
-        i++;
+        float baseSamp = float((int32_t)acc) / 256.0f;
+        wave[k] = baseSamp;
+    }
 
-        cargs.lVol += cargs.lVolStep;
-        cargs.rVol += cargs.rVolStep;
+    interPos = phase;
+    pos = acc;
+}
 
-        processEnd(args, i);
-    } while (--numSamples > 0);
+void GSTriangleSynth::process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
+{
+    processWave<GSTriangleSynth>(buffer, numSamples, args);
 }
 
-void GSTriangleSynth::process(sample* buffer, size_t numSamples, const MixingArgs& args)
+void GSTriangleSynth::generate(float* wave, size_t numSamples)
 {
-    size_t i = 0;
-    do {
-        processStart(args, i, numSamples);
+    const float interStep = cargs.interStep;
+    float phase = interPos;
 
-        interPos += cargs.interStep;
-        if (interPos >= 1.0f) interPos -= 1.0f;
+    for (size_t k = 0; k < numSamples; k++)
+    {
+        phase += interStep;
+        if (phase >= 1.0f) phase -= 1.0f;
         float baseSamp;
-        if (interPos < 0.5f) {
-            baseSamp = (4.0f * interPos) - 1.0f;
+        if (phase < 0.5f) {
+            baseSamp = (4.0f * phase) - 1.0f;
         }
         else {
-            baseSamp = 3.0f - (4.0f * interPos);
+            baseSamp = 3.0f - (4.0f * phase);
         }
+        wave[k] = baseSamp;
+    }
 
-        buffer->left += baseSamp * cargs.lVol;
-        buffer->right += baseSamp * cargs.rVol;
-        buffer++;
-        i++;
-
-        cargs.lVol += cargs.lVolStep;
-        cargs.rVol += cargs.rVolStep;
-
-        processEnd(args, i);
-    } while (--numSamples > 0);
+    interPos = phase;
 }
 
 }
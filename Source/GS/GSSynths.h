@@ -4,6 +4,8 @@
 
 namespace GSVST {
 
+class VoicePool;
+
 struct SynthInfo
 {
     SynthInfo(EDSPType inType)
@@ -28,16 +30,24 @@ public:
     void updateArgs(const MixingArgs& args) override;
     int getMidCFreq() const final { return midCfreq; }
 
-    static GSSynth* createSynth(EDSPType type, const Note& in_note);
+    static GSSynth* createSynth(EDSPType type, const Note& in_note, VoicePool& pool);
 
 protected:
+    // Samples that can be generated before the next processStart update
+    size_t getRunSize(size_t numSamples, const MixingArgs& args) const;
+
+    // Generates the wave of TSynth in the scratch buffer one run at a time, and mixes it to buffer.
+    // Resolved at compile time, so TSynth::generate is inlined in the loop
+    template <typename TSynth>
+    void processWave(StereoBuffer buffer, size_t numSamples, const MixingArgs& args);
+
     const int midCfreq = 16738;
 
     uint32_t pos = 0;
     float interPos = 0.0f;
 };
 
-class GSPWMSynth : public GSSynth
+class GSPWMSynth final : public GSSynth
 {
 public:
     GSPWMSynth(const PWMData& pwmdata, const Note& in_note)
@@ -47,16 +57,19 @@ public:
 
     EDSPType getType() const final { return EDSPType::ModPulse; }
     void processStart(const MixingArgs& args, size_t currentSample, size_t numSamples) final;
-    void process(sample* buffer, size_t numSamples, const MixingArgs& args) final;
+    void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) final;
 
     void updatePWMData(const PWMData& in_data) final
     {
         m_data = PWMData(in_data);
     }
 
-    static GSPWMSynth* createPWMSynth(const PWMData& pwmdata, const Note& in_note);
+    static GSPWMSynth* createPWMSynth(const PWMData& pwmdata, const Note& in_note, VoicePool& pool);
 
 private:
+    friend class GSSynth;
+    void generate(float* wave, size_t numSamples);
+
     void calculateModPulseThreshold(float nBlocksReciprocal);
 
     float m_deltaThresh = 0.0f;
@@ -67,7 +80,7 @@ private:
     PWMData m_data;
 };
 
-class GSSawSynth : public GSSynth
+class GSSawSynth final : public GSSynth
 {
 public:
     GSSawSynth(const Note& in_note)
@@ -75,10 +88,14 @@ public:
     {}
 
     EDSPType getType() const final { return EDSPType::Saw; }
-    void process(sample* buffer, size_t numSamples, const MixingArgs& args) final;
+    void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) final;
+
+private:
+    friend class GSSynth;
+    void generate(float* wave, size_t numSamples);
 };
 
-class GSTriangleSynth : public GSSynth
+class GSTriangleSynth final : public GSSynth
 {
 public:
     GSTriangleSynth(const Note& in_note)
@@ -86,7 +103,11 @@ public:
     {}
 
     EDSPType getType() const final { return EDSPType::Tri; }
-    void process(sample* buffer, size_t numSamples, const MixingArgs& args) final;
+    void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) final;
+
+private:
+    friend class GSSynth;
+    void generate(float* wave, size_t numSamples);
 };
 
 }
\ No newline at end of file
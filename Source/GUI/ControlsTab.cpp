@@ -178,11 +178,8 @@ void ControlsTab::presetComboChanged()
     auto selectedChannel = m_comboChannel->getSelectedId();
     auto [bankId, programId] = m_comboPreset->getSelectedProgramId();
 
-    auto& channelState = m_audioProcessor.GetChannelState(selectedChannel - 1);
-    channelState.setPreset(bankId, programId, m_audioProcessor.getPresets());
-
-    refresh();
-    m_mainWindow.refreshGlobalTab(false);
+    // The tabs are refreshed once the audio thread has applied it
+    m_audioProcessor.setChannelPreset(selectedChannel - 1, bankId, programId);
 }
 
 void ControlsTab::updateCheckboxState()
@@ -192,46 +189,26 @@ void ControlsTab::updateCheckboxState()
 
 void ControlsTab::setPropertyVal(EProperty prop, uint8_t val)
 {
-    auto& channelState = m_audioProcessor.GetChannelState(m_currentMidiChannel);
-    auto adsr = channelState.getADSR();
-    auto pwmData = channelState.getPWMData();
+    ChannelCommand command;
+    command.midiChannel = m_currentMidiChannel;
+    command.value = val;
 
     switch (prop)
     {
-    case EProperty::Volume:
-        channelState.setVolume(val);
-        break;
-    case EProperty::Pan:
-        channelState.setPan(val);
-        break;
-    case EProperty::Reverb:
-        channelState.setReverbLevel(val);
-        break;
-    case EProperty::Attack:   adsr.att = val; break;
-    case EProperty::Decay:    adsr.dec = val; break;
-    case EProperty::Sustain:  adsr.sus = val; break;
-    case EProperty::Release:  adsr.rel = val; break;
-    case EProperty::InitDuty: pwmData.initDuty = val; break;
-    case EProperty::DutyBase: pwmData.dutyBase = val; break;
-    case EProperty::DutyStep: pwmData.dutyStep = val; break;
-    case EProperty::Depth:    pwmData.depth = val; break;
+    case EProperty::Volume:   command.type = EChannelCommand::SetVolume; break;
+    case EProperty::Pan:      command.type = EChannelCommand::SetPan; break;
+    case EProperty::Reverb:   command.type = EChannelCommand::SetReverbLevel; break;
+    case EProperty::Attack:   command.type = EChannelCommand::SetAttack; break;
+    case EProperty::Decay:    command.type = EChannelCommand::SetDecay; break;
+    case EProperty::Sustain:  command.type = EChannelCommand::SetSustain; break;
+    case EProperty::Release:  command.type = EChannelCommand::SetRelease; break;
+    case EProperty::InitDuty: command.type = EChannelCommand::SetInitDuty; break;
+    case EProperty::DutyBase: command.type = EChannelCommand::SetDutyBase; break;
+    case EProperty::DutyStep: command.type = EChannelCommand::SetDutyStep; break;
+    case EProperty::Depth:    command.type = EChannelCommand::SetDepth; break;
     }
 
-    auto adsrChanged = [&prop]() {
-        return (prop == EProperty::Attack || prop == EProperty::Decay
-            || prop == EProperty::Sustain || prop == EProperty::Release);
-    };
-
-    auto pwmChanged = [&prop]() {
-        return (prop == EProperty::InitDuty || prop == EProperty::DutyBase
-            || prop == EProperty::DutyStep || prop == EProperty::Depth);
-    };
-
-    if (adsrChanged())
-        channelState.updateADSR(adsr);
-
-    if (pwmChanged())
-        channelState.updatePWMData(pwmData);
+    m_audioProcessor.pushChannelCommand(command);
 }
 
 
@@ -258,7 +235,11 @@ void ControlsTab::reverbComboChanged()
     }
     else // Apply to curent channel
     {
-        m_audioProcessor.GetChannelState(m_currentMidiChannel).setReverbType(reverbType);
+        ChannelCommand command;
+        command.type = EChannelCommand::SetReverbType;
+        command.midiChannel = m_currentMidiChannel;
+        command.value = static_cast<int>(reverbType);
+        m_audioProcessor.pushChannelCommand(command);
     }
 
     m_reverbSliderEnabled = (reverbType == EReverbType::Default);
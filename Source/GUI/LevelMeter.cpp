@@ -1,12 +1,46 @@
 #include "LevelMeter.h"
 
+#include "Processor/AudioBus.h"
+
+#include <cmath>
+
 namespace GSVST {
 
+static float getSmoothingFactor(float timeMs, float elapsedMs)
+{
+    if (timeMs <= 0.0f)
+        return 1.0f;
+
+    return 1.0f - std::exp(-elapsedMs / timeMs);
+}
+
+void LevelMeter::update(const BusLevels& levels, float elapsedMs)
+{
+    for (int side = 0; side < 2; side++)
+    {
+        const auto rmsTime = (levels.rms[side] > m_rms[side]) ? m_ballistics.attackMs : m_ballistics.releaseMs;
+        m_rms[side] += (levels.rms[side] - m_rms[side]) * getSmoothingFactor(rmsTime, elapsedMs);
+
+        if (levels.peak[side] >= m_peak[side])
+        {
+            m_peak[side] = levels.peak[side];
+            m_peakHoldMs[side] = m_ballistics.peakHoldMs;
+        }
+        else if (m_peakHoldMs[side] > 0.0f)
+        {
+            m_peakHoldMs[side] -= elapsedMs;
+        }
+        else
+        {
+            m_peak[side] += (levels.peak[side] - m_peak[side]) * getSmoothingFactor(m_ballistics.releaseMs, elapsedMs);
+        }
+    }
+}
+
 void LevelMeter::paint(juce::Graphics& g)
 {
     int width = getWidth();
     int height = getHeight();
-    float level = (float)std::exp(std::log(m_level) / 3.0);
 
     auto outerCornerSize = 3.0f;
     auto outerBorderWidth = 2.0f;
@@ -17,30 +51,37 @@ void LevelMeter::paint(juce::Graphics& g)
     g.fillRoundedRectangle(0.0f, 0.0f, static_cast<float> (width), static_cast<float> (height), outerCornerSize);
 
     auto doubleOuterBorderWidth = 2.0f * outerBorderWidth;
-    auto numBlocks = juce::roundToInt((float)totalBlocks * level);
 
     auto blockWidth = ((float)width - doubleOuterBorderWidth) / static_cast<float> (totalBlocks);
-    auto blockHeight = (float)height - doubleOuterBorderWidth;
+    // One row per side
+    auto rowHeight = ((float)height - doubleOuterBorderWidth) / 2.0f;
 
     auto blockRectWidth = (1.0f - 2.0f * spacingFraction) * blockWidth;
+    auto blockRectHeight = rowHeight - 2.0f * spacingFraction * blockWidth;
     auto blockRectSpacing = spacingFraction * blockWidth;
 
     auto blockCornerSize = 0.1f * blockWidth;
 
     auto c = m_colour;
 
-    for (auto i = 0; i < totalBlocks; ++i)
+    for (int side = 0; side < 2; side++)
     {
-        if (i >= numBlocks)
-            g.setColour(c.withAlpha(0.5f));
-        else
-            g.setColour(i < totalBlocks - 1 ? c : juce::Colours::red);
+        auto numBlocks = juce::roundToInt((float)totalBlocks * std::cbrt(m_rms[side]));
+        auto peakBlock = juce::roundToInt((float)totalBlocks * std::cbrt(m_peak[side])) - 1;
+
+        for (auto i = 0; i < totalBlocks; ++i)
+        {
+            if (i >= numBlocks && i != peakBlock)
+                g.setColour(c.withAlpha(0.5f));
+            else
+                g.setColour(i < totalBlocks - 1 ? c : juce::Colours::red);
 
-        g.fillRoundedRectangle(outerBorderWidth + ((float)i * blockWidth) + blockRectSpacing,
-            outerBorderWidth,
-            blockRectWidth,
-            blockHeight,
-            blockCornerSize);
+            g.fillRoundedRectangle(outerBorderWidth + ((float)i * blockWidth) + blockRectSpacing,
+                outerBorderWidth + (float)side * rowHeight + blockRectSpacing,
+                blockRectWidth,
+                blockRectHeight,
+                blockCornerSize);
+        }
     }
 }
 
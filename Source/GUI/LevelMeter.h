@@ -4,16 +4,37 @@
 
 namespace GSVST {
 
+struct BusLevels;
+
 class LevelMeter : public juce::Component
 {
 public:
+    // Time taken by the display to move about two thirds of the way to a louder (attack) or quieter (release) level
+    struct Ballistics
+    {
+        float attackMs = 10.0f;
+        float releaseMs = 300.0f;
+        // The peak mark stays up this long before falling back
+        float peakHoldMs = 1000.0f;
+    };
+
     void paint(juce::Graphics& g) override;
 
-    void setLevel(float lev) { m_level = lev; }
+    void setBallistics(const Ballistics& ballistics) { m_ballistics = ballistics; }
+    const Ballistics& getBallistics() const { return m_ballistics; }
+
+    // Levels measured over the elapsedMs since the previous update
+    void update(const BusLevels& levels, float elapsedMs);
     void setColour(juce::Colour colour) { m_colour = colour; }
 
 private:
-    float m_level = 0.0f;
+    Ballistics m_ballistics;
+
+    // Left then right, as displayed
+    float m_rms[2] = { 0.0f, 0.0f };
+    float m_peak[2] = { 0.0f, 0.0f };
+    float m_peakHoldMs[2] = { 0.0f, 0.0f };
+
     juce::Colour m_colour;
 };
 
@@ -7,6 +7,7 @@
 #include "AboutWindow.h"
 #include "ControlsTab.h"
 #include "OverviewTab.h"
+#include "PerformanceTab.h"
 #include "CustomLookAndFeel.h"
 
 namespace GSVST {
@@ -24,12 +25,14 @@ MainWindow::MainWindow (Processor& p)
 
     m_mainTab.reset(new ControlsTab(p, *this));
     m_globalViewTab.reset(new GlobalViewTab(p, *this));
+    m_performanceTab.reset(new PerformanceTab(p, *this));
     m_settingsWindow.reset(new SettingsWindow(p, *this));
 
     addAndMakeVisible(m_tabbedComponent.get());
     m_tabbedComponent->setOrientation(juce::TabbedButtonBar::TabsAtBottom);
     m_tabbedComponent->addTab("Controls", juce::Colours::black, m_mainTab.get(), true);
     m_tabbedComponent->addTab("Overview", juce::Colours::black, m_globalViewTab.get(), true);
+    m_tabbedComponent->addTab("Performance", juce::Colours::black, m_performanceTab.get(), true);
 
     addAndMakeVisible(*m_settingsButton.get());
     m_settingsButton->setButtonText("Settings");
@@ -59,6 +62,7 @@ MainWindow::~MainWindow()
 
     m_mainTab.reset();
     m_globalViewTab.reset();
+    m_performanceTab.reset();
     m_settingsWindow.reset();
 }
 
@@ -8,6 +8,7 @@ class Processor;
 
 class ControlsTab;
 class GlobalViewTab;
+class PerformanceTab;
 class SettingsWindow;
 class AboutWindow;
 class CustomLookAndFeel;
@@ -43,6 +44,7 @@ private:
 
     std::unique_ptr<ControlsTab> m_mainTab;
     std::unique_ptr<GlobalViewTab> m_globalViewTab;
+    std::unique_ptr<PerformanceTab> m_performanceTab;
     std::unique_ptr<SettingsWindow> m_settingsWindow;
     std::unique_ptr<AboutWindow> m_aboutWindow;
 
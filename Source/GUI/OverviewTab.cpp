@@ -11,6 +11,7 @@
 #include "MainWindow.h"
 
 #define DISPLAYED_MIDI_CHANNELS 10
+#define METER_REFRESH_RATE 20
 
 namespace GSVST {
 
@@ -43,7 +44,7 @@ GlobalViewTab::GlobalViewTab(Processor& p, MainWindow& e)
         addAndMakeVisible(*m_channelDescs[i].m_meter.get());
     }
    
-    startTimerHz(20);
+    startTimerHz(METER_REFRESH_RATE);
 }
 
 void GlobalViewTab::timerCallback()
@@ -51,12 +52,9 @@ void GlobalViewTab::timerCallback()
     // Only showing 10 channels for now (TODO: add <-> selector)
     for (int i = 0; i < DISPLAYED_MIDI_CHANNELS; i++)
     {
-        auto& channelState = m_audioProcessor.GetChannelState(i);
-        float level = 0.0f;
-        if (channelState.isActive())
-            level = channelState.getAverageLevel();
+        const auto levels = m_audioProcessor.GetChannelState(i).readLevels();
 
-        m_channelDescs[i].m_meter->setLevel(level);
+        m_channelDescs[i].m_meter->update(levels, 1000.0f / METER_REFRESH_RATE);
         m_channelDescs[i].m_meter->repaint();
     }
 }
@@ -117,16 +115,12 @@ void GlobalViewTab::resized()
 void GlobalViewTab::presetComboChanged(int channel)
 {
     auto [bankId, programId] = m_channelDescs[channel].m_presetCombo->getSelectedProgramId();
-    auto& channelState = m_audioProcessor.GetChannelState(channel);
-    channelState.setPreset(bankId, programId, m_audioProcessor.getPresets());
-
-    refresh();
+    m_audioProcessor.setChannelPreset(channel, bankId, programId);
 }
 
 void GlobalViewTab::refresh()
 {
-    const auto& presetsHandler = m_audioProcessor.getPresets();
-    const auto& programInfo = presetsHandler.getProgramInfo();
+    const PresetsHandler::LockedPresetSet presetSet(m_audioProcessor.getPresets());
 
     for (int i = 0; i < DISPLAYED_MIDI_CHANNELS; i++)
     {
@@ -141,7 +135,7 @@ void GlobalViewTab::refresh()
             desc.m_deviceColour = colour;
             desc.m_meter->setColour(colour);
         }
-        else if (auto* info = presetsHandler.findProgramInfo(programInfo, bankId, programId))
+        else if (auto* info = presetSet->findProgramInfo(bankId, programId))
         {
             desc.m_deviceName = info->device;
             auto colour = getDeviceColour(info->device);
@@ -0,0 +1,155 @@
+#include "PerformanceTab.h"
+#include "CustomLookAndFeel.h"
+#include "MainWindow.h"
+
+#include "Processor/Processor.h"
+#include "Processor/RealtimeCheck.h"
+
+#include <algorithm>
+
+namespace GSVST {
+
+static const char* dspTypeNames[NUM_DSP_TYPES] = { "PCM", "Fixed", "PWM", "Saw", "Tri", "Square" };
+
+static juce::String formatLoad(float load)
+{
+    return juce::String(load * 100.0f, 1) + "%";
+}
+
+PerformanceTab::PerformanceTab(Processor& p, MainWindow& e)
+    : m_audioProcessor(p)
+    , m_mainWindow(e)
+{
+    addAndMakeVisible(m_resetButton);
+    m_resetButton.setButtonText("Reset");
+    m_resetButton.onClick = [this]
+    {
+        m_audioProcessor.getPerformanceStats().requestReset();
+        RealtimeCheck::reset();
+        m_peakLoad = 0.0f;
+    };
+
+    startTimerHz(10);
+}
+
+void PerformanceTab::timerCallback()
+{
+    if (!isShowing())
+        return;
+
+    m_snapshot = m_audioProcessor.getPerformanceStats().read();
+    m_peakLoad = std::max(m_peakLoad, m_snapshot.peakLoad);
+    repaint();
+}
+
+void PerformanceTab::paint(juce::Graphics& g)
+{
+    auto* lnf = m_mainWindow.getCustomLookAndFeel();
+
+    lnf->drawWindowBackground(g, 0, 0, getWidth() - 2, 240);
+    lnf->drawCustomBox(g, 0, 0, 200, 240);
+    lnf->drawCustomBox(g, 205, 0, getWidth() - 205, 115);
+    lnf->drawCustomBox(g, 205, 120, getWidth() - 205, 120);
+
+    g.setFont(lnf->getDefaultFont());
+    g.setFont(lnf->getLabelFontSize() - 1);
+    g.setColour(juce::Colours::white);
+
+    auto currentY = 8;
+    auto drawLine = [&](const juce::String& text)
+    {
+        g.drawText(text, 10, currentY, 185, 15, juce::Justification::centredLeft);
+        currentY += 16;
+    };
+
+    drawLine("CPU load: " + formatLoad(m_snapshot.load));
+    drawLine("Average: " + formatLoad(m_snapshot.averageLoad) + " Peak: " + formatLoad(m_peakLoad));
+    drawLine("Reverb: " + formatLoad(m_snapshot.reverbLoad));
+    drawLine("Overruns: " + juce::String(m_snapshot.numOverruns) + " / " + juce::String(m_snapshot.numBlocks) + " blocks");
+    drawLine("Voices started: " + juce::String(m_snapshot.numVoiceAllocations));
+    drawLine("Pool overflows: " + juce::String(m_snapshot.numPoolOverflows));
+    drawLine("Voices stolen: " + juce::String(m_snapshot.numStolenVoices));
+
+    if (RealtimeCheck::isEnabled())
+    {
+        juce::String text = "RT violations: " + juce::String(RealtimeCheck::getNumViolations());
+        if (const char* site = RealtimeCheck::getWorstSite())
+            text += " (" + juce::String(site) + ")";
+
+        drawLine(text);
+    }
+
+    currentY += 4;
+    for (int i = 0; i < NUM_DSP_TYPES; i += 2)
+    {
+        drawLine(juce::String(dspTypeNames[i]) + ": " + juce::String(m_snapshot.numVoices[i])
+            + "   " + dspTypeNames[i + 1] + ": " + juce::String(m_snapshot.numVoices[i + 1]));
+    }
+
+    paintHistogram(g, juce::Rectangle<int>(205, 0, getWidth() - 205, 115).reduced(10, 8));
+    paintChannelLoads(g, juce::Rectangle<int>(205, 120, getWidth() - 205, 120).reduced(10, 8));
+}
+
+void PerformanceTab::paintHistogram(juce::Graphics& g, juce::Rectangle<int> area)
+{
+    g.setColour(juce::Colours::white);
+    g.drawText("Block time (% of the block duration)", area.removeFromTop(15), juce::Justification::centredLeft);
+    auto labels = area.removeFromBottom(12);
+
+    const auto maxCount = *std::max_element(std::begin(m_snapshot.histogram), std::end(m_snapshot.histogram));
+    const auto binWidth = static_cast<float>(area.getWidth()) / PERF_HISTOGRAM_BINS;
+
+    for (int i = 0; i < PERF_HISTOGRAM_BINS; i++)
+    {
+        const auto x = static_cast<float>(area.getX()) + binWidth * i;
+        const auto fraction = maxCount > 0 ? static_cast<float>(m_snapshot.histogram[i]) / static_cast<float>(maxCount) : 0.0f;
+        const auto height = static_cast<float>(area.getHeight()) * fraction;
+
+        // Past 100%, the block took longer than its audio
+        g.setColour(i < 10 ? juce::Colours::lightgreen : juce::Colours::red);
+        g.fillRect(x + 1.0f, static_cast<float>(area.getBottom()) - height, binWidth - 2.0f, height);
+    }
+
+    g.setColour(juce::Colours::white);
+    g.setFont(9.0f);
+    for (int percent = 0; percent <= 200; percent += 50)
+    {
+        const auto x = area.getX() + juce::roundToInt(binWidth * percent / 10.0f);
+        g.drawText(juce::String(percent), x - 15, labels.getY(), 30, labels.getHeight(), juce::Justification::centred);
+    }
+}
+
+void PerformanceTab::paintChannelLoads(juce::Graphics& g, juce::Rectangle<int> area)
+{
+    g.setColour(juce::Colours::white);
+    g.drawText("Cost per midi channel (average % of the block duration)", area.removeFromTop(15), juce::Justification::centredLeft);
+    auto labels = area.removeFromBottom(12);
+    auto values = area.removeFromTop(12);
+
+    // Scaled to the most expensive channel, with at least 10% of the block as full scale
+    const auto maxLoad = std::max(0.1f, *std::max_element(std::begin(m_snapshot.channelLoads), std::end(m_snapshot.channelLoads)));
+    const auto barWidth = static_cast<float>(area.getWidth()) / MAX_MIDI_CHANNELS;
+
+    g.setFont(9.0f);
+    for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
+    {
+        const auto load = m_snapshot.channelLoads[i];
+        const auto x = static_cast<float>(area.getX()) + barWidth * i;
+        const auto height = static_cast<float>(area.getHeight()) * std::min(load / maxLoad, 1.0f);
+
+        g.setColour(juce::Colour(66, 162, 200));
+        g.fillRect(x + 2.0f, static_cast<float>(area.getBottom()) - height, barWidth - 4.0f, height);
+
+        g.setColour(juce::Colours::white);
+        g.drawText(juce::String(i + 1), juce::roundToInt(x), labels.getY(), juce::roundToInt(barWidth), labels.getHeight(), juce::Justification::centred);
+        if (load >= 0.001f)
+            g.drawText(juce::String(load * 100.0f, 1), juce::roundToInt(x) - 4, values.getY(), juce::roundToInt(barWidth) + 8, values.getHeight(), juce::Justification::centred);
+    }
+}
+
+void PerformanceTab::resized()
+{
+    m_resetButton.setBounds(10, 210, 80, 20);
+}
+
+}
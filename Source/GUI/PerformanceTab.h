@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Processor/PerformanceStats.h"
+
+namespace GSVST {
+
+class Processor;
+class MainWindow;
+
+// Engine cost: CPU load relative to the block duration, block time histogram, cost of each midi channel
+class PerformanceTab : public juce::Component,
+    public juce::Timer
+{
+public:
+    PerformanceTab(Processor& p, MainWindow& e);
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+    void timerCallback() override;
+
+private:
+    void paintHistogram(juce::Graphics& g, juce::Rectangle<int> area);
+    void paintChannelLoads(juce::Graphics& g, juce::Rectangle<int> area);
+
+    juce::TextButton m_resetButton;
+
+    PerfSnapshot m_snapshot;
+    // Highest peak since the last reset, PerfSnapshot only having the one since the previous read
+    float m_peakLoad = 0.0f;
+
+    Processor& m_audioProcessor;
+    MainWindow& m_mainWindow;
+};
+
+}
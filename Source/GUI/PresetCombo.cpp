@@ -107,7 +107,8 @@ void PresetCombo::refresh(const PresetsHandler& presets, const ProgramInfo* cust
     menu->clear();
     m_programNames.clear();
 
-    for (auto& preset : presets.m_presets)
+    PresetsHandler::LockedPresetSet presetSet(presets);
+    for (auto& preset : presetSet->m_presets)
     {
         juce::String presetName = getFullPresetName(preset->bankid, preset->programid, preset->name, customInfo ? customInfo->name : juce::String());
 
@@ -4,6 +4,7 @@
 
 #include "Processor/Processor.h"
 #include "Processor/ReverbEffect.h"
+#include "Processor/Trace.h"
 #include "Presets/PresetsHandler.h"
 
 namespace GSVST {
@@ -45,13 +46,18 @@ SettingsWindow::SettingsWindow(Processor& p, MainWindow& e)
     addButton(m_browseSoundfontButton, "Browse");
     addButton(m_clearSoundfontButton, "Clear");
 
+    if (Trace::isEnabled())
+        addButton(m_exportTraceButton, "Export trace");
+
     m_labelProgramNameMode.setText("Program names:", juce::dontSendNotification);
     m_labelTheme.setText("UI:", juce::dontSendNotification);
+    m_labelVoicePoolCapacity.setText("Voices per type:", juce::dontSendNotification);
     m_labelAutoReplaceSynths.setText("Auto-replace synths with better ones:", juce::dontSendNotification);
 
     addAndMakeVisible(m_labelSoundfont);
     addAndMakeVisible(m_labelProgramNameMode);
     addAndMakeVisible(m_labelTheme);
+    addAndMakeVisible(m_labelVoicePoolCapacity);
     addAndMakeVisible(m_labelAutoReplaceSynths);
 
     addAndMakeVisible(m_gsSynthModeToggleButton);
@@ -66,6 +72,18 @@ SettingsWindow::SettingsWindow(Processor& p, MainWindow& e)
     m_hideUnknownPresetsButton.setButtonText("Hide unknown instruments");
     m_hideUnknownPresetsButton.onClick = [this] { toggleButtonStateChanged(&m_hideUnknownPresetsButton); };
 
+    addAndMakeVisible(m_sharedReverbButton);
+    m_sharedReverbButton.setButtonText("Shared reverb (as on GBA)");
+    m_sharedReverbButton.onClick = [this] { toggleButtonStateChanged(&m_sharedReverbButton); };
+
+    addAndMakeVisible(m_multiThreadedButton);
+    m_multiThreadedButton.setButtonText("Multi-threaded rendering");
+    m_multiThreadedButton.onClick = [this] { toggleButtonStateChanged(&m_multiThreadedButton); };
+
+    addAndMakeVisible(m_mappedSoundfontButton);
+    m_mappedSoundfontButton.setButtonText("Memory-mapped soundfont");
+    m_mappedSoundfontButton.onClick = [this] { toggleButtonStateChanged(&m_mappedSoundfontButton); };
+
     {
         m_comboTheme.addItem("GS", EUITheme::GS);
         m_comboTheme.addItem("CotM", EUITheme::CoTM);
@@ -73,17 +91,27 @@ SettingsWindow::SettingsWindow(Processor& p, MainWindow& e)
         addAndMakeVisible(m_comboTheme);
     }
 
+    {
+        for (int capacity = 32; capacity <= 512; capacity *= 2)
+            m_comboVoicePoolCapacity.addItem(juce::String(capacity), capacity);
+
+        m_comboVoicePoolCapacity.onChange = [this] { comboChangedVoicePoolCapacity(); };
+        addAndMakeVisible(m_comboVoicePoolCapacity);
+    }
+
     m_lookAndFeel.reset(new ComboLookAndFeel(&e));
     getLookAndFeel().setDefaultSansSerifTypeface(m_lookAndFeel->getTypeface());
 
     m_comboProgramNameMode.setLookAndFeel(m_lookAndFeel.get());
     m_comboTheme.setLookAndFeel(m_lookAndFeel.get());
+    m_comboVoicePoolCapacity.setLookAndFeel(m_lookAndFeel.get());
 }
 
 SettingsWindow::~SettingsWindow()
 {
     m_comboProgramNameMode.setLookAndFeel(nullptr);
     m_comboTheme.setLookAndFeel(nullptr);
+    m_comboVoicePoolCapacity.setLookAndFeel(nullptr);
 }
 
 void SettingsWindow::paint(juce::Graphics& g)
@@ -99,7 +127,8 @@ void SettingsWindow::resized()
 
     auto buttonArea = bounds.removeFromTop(20);
     m_browseSoundfontButton.setBounds(buttonArea.removeFromLeft(60).withWidth(60));
-    m_clearSoundfontButton.setBounds(buttonArea.withWidth(60));
+    m_clearSoundfontButton.setBounds(buttonArea.removeFromLeft(60));
+    m_exportTraceButton.setBounds(buttonArea.removeFromRight(100));
 
     auto programModeArea = bounds.removeFromTop(20);
     m_labelProgramNameMode.setBounds(programModeArea.removeFromLeft(150));
@@ -107,7 +136,10 @@ void SettingsWindow::resized()
 
     auto themeArea = bounds.removeFromTop(20);
     m_labelTheme.setBounds(themeArea.removeFromLeft(35));
-    m_comboTheme.setBounds(themeArea.withWidth(100));
+    m_comboTheme.setBounds(themeArea.removeFromLeft(100));
+    themeArea.removeFromLeft(20);
+    m_labelVoicePoolCapacity.setBounds(themeArea.removeFromLeft(110));
+    m_comboVoicePoolCapacity.setBounds(themeArea.withWidth(70));
 
     bounds.removeFromTop(10);
 
@@ -118,7 +150,12 @@ void SettingsWindow::resized()
     m_gbSynthModeToggleButton.setBounds(firstRow);
 
     auto secondRow = bounds.removeFromTop(20);
-    m_hideUnknownPresetsButton.setBounds(secondRow);
+    m_hideUnknownPresetsButton.setBounds(secondRow.removeFromLeft(halfWidth));
+    m_sharedReverbButton.setBounds(secondRow);
+
+    auto thirdRow = bounds.removeFromTop(20);
+    m_multiThreadedButton.setBounds(thirdRow.removeFromLeft(halfWidth));
+    m_mappedSoundfontButton.setBounds(thirdRow);
 }
 
 void SettingsWindow::refresh(bool /*bForce*/)
@@ -138,8 +175,12 @@ void SettingsWindow::refresh(bool /*bForce*/)
     m_gsSynthModeToggleButton.setToggleState(presets.getAutoReplaceGSSynths(), juce::dontSendNotification);
     m_gbSynthModeToggleButton.setToggleState(presets.getAutoReplaceGBSynths(), juce::dontSendNotification);
     m_hideUnknownPresetsButton.setToggleState(presets.getHideUnknownInstruments(), juce::dontSendNotification);
+    m_sharedReverbButton.setToggleState(m_audioProcessor.getSharedReverb(), juce::dontSendNotification);
+    m_multiThreadedButton.setToggleState(m_audioProcessor.getMultiThreaded(), juce::dontSendNotification);
+    m_mappedSoundfontButton.setToggleState(m_audioProcessor.getMappedSoundfont(), juce::dontSendNotification);
 
     m_comboTheme.setSelectedId(m_mainWindow.getSelectedTheme(), juce::dontSendNotification);
+    m_comboVoicePoolCapacity.setSelectedId(m_audioProcessor.getVoicePoolCapacity(), juce::dontSendNotification);
 }
 
 void SettingsWindow::buttonClicked(juce::Button* button)
@@ -169,6 +210,28 @@ void SettingsWindow::buttonClicked(juce::Button* button)
         m_mainWindow.refreshMainTab();
         m_mainWindow.refreshGlobalTab();
     }
+    else if (button == &m_exportTraceButton)
+    {
+        fileChooser = std::make_unique<juce::FileChooser>(
+            "Save the Chrome trace...",
+            juce::File::getSpecialLocation(juce::File::userHomeDirectory).getChildFile("gsvst_trace.json"),
+            "*.json");
+
+        auto saveChooserFlags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting;
+
+        fileChooser->launchAsync(saveChooserFlags, [](const juce::FileChooser& chooser)
+        {
+            juce::File traceFile(chooser.getResult());
+            if (traceFile == juce::File())
+                return;
+
+            if (!Trace::writeChromeJson(std::string(traceFile.getFullPathName().getCharPointer())))
+            {
+                juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                    "Export trace", "Couldn't write " + traceFile.getFullPathName());
+            }
+        });
+    }
 }
 
 void SettingsWindow::toggleButtonStateChanged(juce::ToggleButton* button)
@@ -179,6 +242,12 @@ void SettingsWindow::toggleButtonStateChanged(juce::ToggleButton* button)
         m_audioProcessor.setAutoReplaceGBSynths(button->getToggleState());
     else if (button == &m_hideUnknownPresetsButton)
         m_audioProcessor.setHideUnknownInstruments(button->getToggleState());
+    else if (button == &m_sharedReverbButton)
+        m_audioProcessor.setSharedReverb(button->getToggleState());
+    else if (button == &m_multiThreadedButton)
+        m_audioProcessor.setMultiThreaded(button->getToggleState());
+    else if (button == &m_mappedSoundfontButton)
+        m_audioProcessor.setMappedSoundfont(button->getToggleState());
 
     m_mainWindow.refreshMainTab();
     m_mainWindow.refreshGlobalTab();
@@ -193,6 +262,12 @@ void SettingsWindow::comboChangedProgramNameMode()
     m_mainWindow.refreshGlobalTab();
 }
 
+void SettingsWindow::comboChangedVoicePoolCapacity()
+{
+    if (auto capacity = m_comboVoicePoolCapacity.getSelectedId(); capacity > 0)
+        m_audioProcessor.setVoicePoolCapacity(capacity);
+}
+
 void SettingsWindow::comboChangedTheme()
 {
     auto theme = m_comboTheme.getSelectedId();
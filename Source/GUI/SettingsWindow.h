@@ -24,6 +24,7 @@ public:
 private:
     void comboChangedProgramNameMode();
     void comboChangedTheme();
+    void comboChangedVoicePoolCapacity();
     void buttonClicked(juce::Button* button) override;
     void toggleButtonStateChanged(juce::ToggleButton* button);
 
@@ -39,10 +40,20 @@ private:
     juce::Label m_labelTheme;
     juce::ComboBox m_comboTheme;
 
+    // The item ids are the capacities
+    juce::Label m_labelVoicePoolCapacity;
+    juce::ComboBox m_comboVoicePoolCapacity;
+
     juce::Label m_labelAutoReplaceSynths;
     juce::ToggleButton m_gsSynthModeToggleButton;
     juce::ToggleButton m_gbSynthModeToggleButton;
     juce::ToggleButton m_hideUnknownPresetsButton;
+    juce::ToggleButton m_sharedReverbButton;
+    juce::ToggleButton m_multiThreadedButton;
+    juce::ToggleButton m_mappedSoundfontButton;
+
+    // Only shown when built with ENABLE_TRACING
+    juce::TextButton m_exportTraceButton;
 
     std::unique_ptr<ComboLookAndFeel> m_lookAndFeel;
 
@@ -1,12 +1,13 @@
 #include "CGBSynthPresets.h"
 #include "Processor/CGBChannel.h"
+#include "Processor/VoicePool.h"
 
 namespace GSVST {
 
 //-----------------------------------------------------------------------------
-Instrument* SquareSynthPreset::createPlayingInstance(const Note& note) const
+Instrument* SquareSynthPreset::createPlayingInstance(const Note& note, VoicePool& pool) const
 {
-    return new SquareChannel(dutyCycle, note, 0);
+    return pool.createVoice<SquareChannel>(dutyCycle, note, 0, pool);
 }
 
 }
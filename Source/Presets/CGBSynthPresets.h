@@ -17,7 +17,7 @@ public:
         , dutyCycle(in_dutyCycle)
     {}
 
-    Instrument* createPlayingInstance(const Note& note) const final;
+    Instrument* createPlayingInstance(const Note& note, VoicePool& pool) const final;
     EDSPType getDSPType() const final { return EDSPType::Square; }
     const ADSR& getADSR() const final { return adsr; }
 
@@ -0,0 +1,281 @@
+#include "CompiledSoundfont.h"
+#include "SoundfontCache.h"
+
+#include "Processor/Resampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+// Of every section in the file, from its start
+#define COMPILED_SOUNDFONT_ALIGNMENT 64
+
+struct CompiledSoundfontHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    SoundfontIdentity identity;
+
+    uint32_t numPresets;
+    uint32_t numRegions;
+    uint64_t namesSize;
+    uint64_t numSamples16;
+    uint64_t numSamples8;
+
+    uint64_t presetsOffset;
+    uint64_t regionsOffset;
+    uint64_t namesOffset;
+    uint64_t samples16Offset;
+    uint64_t samples8Offset;
+};
+
+static const char compiledSoundfontMagic[8] = { 'G', 'S', 'V', 'S', 'T', 'S', 'F', 'C' };
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+bool CompiledSoundfont::getIdentity(const std::string& sf2Path, SoundfontIdentity& out_identity)
+{
+    const juce::File file(sf2Path);
+    juce::FileInputStream stream(file);
+    if (!stream.openedOk())
+        return false;
+
+    out_identity.size = static_cast<uint64_t>(stream.getTotalLength());
+    out_identity.modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    char riffHeader[12];
+    if (stream.read(riffHeader, sizeof(riffHeader)) != sizeof(riffHeader))
+        return false;
+    hash = hashBytes(hash, riffHeader, sizeof(riffHeader));
+
+    // The INFO and pdta lists are hashed, the sdta one only by its header: reading the samples would cost as much as loading them
+    std::vector<char> buffer(1 << 16);
+    char chunkHeader[12];
+    while (stream.read(chunkHeader, 8) == 8)
+    {
+        uint32_t chunkSize;
+        memcpy(&chunkSize, chunkHeader + 4, sizeof(chunkSize));
+        const int64_t dataEnd = stream.getPosition() + chunkSize;
+        if (static_cast<uint64_t>(dataEnd) > out_identity.size)
+            return false;
+
+        // Odd-sized chunks are followed by a pad byte, which some writers omit at the end of the file
+        const int64_t chunkEnd = std::min<int64_t>(dataEnd + (chunkSize & 1), static_cast<int64_t>(out_identity.size));
+
+        size_t headerSize = 8;
+        if (memcmp(chunkHeader, "LIST", 4) == 0 && chunkSize >= 4)
+        {
+            if (stream.read(chunkHeader + 8, 4) != 4)
+                return false;
+            headerSize = 12;
+        }
+        hash = hashBytes(hash, chunkHeader, headerSize);
+
+        if (headerSize == 12 && memcmp(chunkHeader + 8, "sdta", 4) == 0)
+        {
+            stream.setPosition(chunkEnd);
+            continue;
+        }
+
+        while (stream.getPosition() < dataEnd)
+        {
+            const auto toRead = static_cast<int>(std::min<int64_t>(dataEnd - stream.getPosition(), static_cast<int64_t>(buffer.size())));
+            if (stream.read(buffer.data(), toRead) != toRead)
+                return false;
+            hash = hashBytes(hash, buffer.data(), static_cast<size_t>(toRead));
+        }
+
+        stream.setPosition(chunkEnd);
+    }
+
+    out_identity.hash = hash;
+    return true;
+}
+
+std::string CompiledSoundfont::getCachePath(const std::string& sf2Path)
+{
+    const juce::File file(sf2Path);
+    const auto directory = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("GoldenSunVST").getChildFile("SoundfontCache");
+
+    // The path hash tells apart the soundfonts having the same name
+    const auto name = file.getFileNameWithoutExtension() + "_" + juce::String::toHexString(file.getFullPathName().hashCode64()) + ".gsvstsf";
+    return directory.getChildFile(name).getFullPathName().toStdString();
+}
+
+// The tables are then used without any check when building the presets and playing
+static bool validateTables(const SoundfontData& data)
+{
+    if (data.namesSize == 0 || data.names[data.namesSize - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < data.numPresets; i++)
+    {
+        const auto& preset = data.presets[i];
+        if (preset.firstRegion > data.numRegions || preset.numRegions > data.numRegions - preset.firstRegion
+            || preset.nameOffset >= data.namesSize || preset.synthNameOffset >= data.namesSize
+            || preset.synth > ECompiledSynth::GB || preset.dutyCycle > 3)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < data.numRegions; i++)
+    {
+        const auto& region = data.regions[i];
+        if (!region.bGuarded || (region.format != ESampleFormat::Int16 && region.format != ESampleFormat::Int8))
+            return false;
+
+        // Played as midi notes and sample positions
+        if (region.loKey > region.hiKey || region.hiKey > 127 || region.loVelocity > region.hiVelocity || region.hiVelocity > 127
+            || region.notePitch > 127 || region.loopStart > region.loopEnd)
+            return false;
+
+        const size_t numSamples = (region.format == ESampleFormat::Int8 ? data.numSamples8 : data.numSamples16);
+        if (region.sampleOffset > numSamples || size_t(region.loopEnd) + SAMPLE_GUARD_SIZE > numSamples - region.sampleOffset)
+            return false;
+    }
+
+    return true;
+}
+
+std::unique_ptr<SoundfontData> CompiledSoundfont::load(const std::string& cachePath, const SoundfontIdentity& identity, bool bMapped)
+{
+    const juce::File file(cachePath);
+    if (!file.exists())
+        return nullptr;
+
+    auto data = std::make_unique<SoundfontData>();
+    const char* fileStart = nullptr;
+    size_t fileSize = 0;
+
+    if (bMapped)
+    {
+        data->mappedFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+        fileStart = static_cast<const char*>(data->mappedFile->getData());
+        fileSize = data->mappedFile->getSize();
+    }
+    else
+    {
+        data->fileData = std::make_unique<juce::MemoryBlock>();
+        if (!file.loadFileAsData(*data->fileData))
+            return nullptr;
+
+        fileStart = static_cast<const char*>(data->fileData->getData());
+        fileSize = data->fileData->getSize();
+    }
+
+    if (!fileStart || fileSize < sizeof(CompiledSoundfontHeader) || reinterpret_cast<uintptr_t>(fileStart) % alignof(uint64_t) != 0)
+        return nullptr;
+
+    CompiledSoundfontHeader header;
+    memcpy(&header, fileStart, sizeof(header));
+
+    if (memcmp(header.magic, compiledSoundfontMagic, sizeof(header.magic)) != 0
+        || header.version != COMPILED_SOUNDFONT_VERSION
+        || header.headerSize != sizeof(header)
+        || !(header.identity == identity))
+        return nullptr;
+
+    auto getSection = [&](uint64_t offset, uint64_t count, size_t elementSize) -> const char*
+    {
+        if (offset % COMPILED_SOUNDFONT_ALIGNMENT != 0 || offset > fileSize || count > (fileSize - offset) / elementSize)
+            return nullptr;
+        return fileStart + offset;
+    };
+
+    data->presets = reinterpret_cast<const CompiledPreset*>(getSection(header.presetsOffset, header.numPresets, sizeof(CompiledPreset)));
+    data->numPresets = header.numPresets;
+    data->regions = reinterpret_cast<const CompiledRegion*>(getSection(header.regionsOffset, header.numRegions, sizeof(CompiledRegion)));
+    data->numRegions = header.numRegions;
+    data->names = getSection(header.namesOffset, header.namesSize, sizeof(char));
+    data->namesSize = static_cast<size_t>(header.namesSize);
+    data->samples16 = reinterpret_cast<const int16_t*>(getSection(header.samples16Offset, header.numSamples16, sizeof(int16_t)));
+    data->numSamples16 = static_cast<size_t>(header.numSamples16);
+    data->samples8 = reinterpret_cast<const int8_t*>(getSection(header.samples8Offset, header.numSamples8, sizeof(int8_t)));
+    data->numSamples8 = static_cast<size_t>(header.numSamples8);
+
+    if (!data->presets || !data->regions || !data->names || !data->samples16 || !data->samples8 || !validateTables(*data))
+        return nullptr;
+
+    return data;
+}
+
+bool CompiledSoundfont::write(const std::string& cachePath, const SoundfontIdentity& identity, const SoundfontData& data)
+{
+    const juce::File file(cachePath);
+    if (!file.getParentDirectory().createDirectory())
+        return false;
+
+    CompiledSoundfontHeader header = {};
+    memcpy(header.magic, compiledSoundfontMagic, sizeof(header.magic));
+    header.version = COMPILED_SOUNDFONT_VERSION;
+    header.headerSize = sizeof(header);
+    header.identity = identity;
+    header.numPresets = data.numPresets;
+    header.numRegions = data.numRegions;
+    header.namesSize = data.namesSize;
+    header.numSamples16 = data.numSamples16;
+    header.numSamples8 = data.numSamples8;
+
+    uint64_t fileSize = sizeof(header);
+    auto addSection = [&](uint64_t size)
+    {
+        const uint64_t offset = (fileSize + COMPILED_SOUNDFONT_ALIGNMENT - 1) / COMPILED_SOUNDFONT_ALIGNMENT * COMPILED_SOUNDFONT_ALIGNMENT;
+        fileSize = offset + size;
+        return offset;
+    };
+
+    header.presetsOffset = addSection(data.numPresets * sizeof(CompiledPreset));
+    header.regionsOffset = addSection(data.numRegions * sizeof(CompiledRegion));
+    header.namesOffset = addSection(data.namesSize);
+    header.samples16Offset = addSection(data.numSamples16 * sizeof(int16_t));
+    header.samples8Offset = addSection(data.numSamples8 * sizeof(int8_t));
+
+    // Written next to the cache file, then moved: other instances may be loading it
+    juce::TemporaryFile tempFile(file);
+    {
+        juce::FileOutputStream stream(tempFile.getFile());
+        if (!stream.openedOk())
+            return false;
+
+        uint64_t position = 0;
+        auto writeSection = [&](uint64_t offset, const void* bytes, size_t size)
+        {
+            static const char padding[COMPILED_SOUNDFONT_ALIGNMENT] = {};
+            const bool bPadded = (offset == position || stream.write(padding, static_cast<size_t>(offset - position)));
+            position = offset + size;
+            return bPadded && (size == 0 || stream.write(bytes, size));
+        };
+
+        if (!writeSection(0, &header, sizeof(header))
+            || !writeSection(header.presetsOffset, data.presets, data.numPresets * sizeof(CompiledPreset))
+            || !writeSection(header.regionsOffset, data.regions, data.numRegions * sizeof(CompiledRegion))
+            || !writeSection(header.namesOffset, data.names, data.namesSize)
+            || !writeSection(header.samples16Offset, data.samples16, data.numSamples16 * sizeof(int16_t))
+            || !writeSection(header.samples8Offset, data.samples8, data.numSamples8 * sizeof(int8_t)))
+            return false;
+
+        stream.flush();
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+}
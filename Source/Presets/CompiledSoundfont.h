@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "Processor/Types.h"
+
+namespace GSVST {
+
+struct SoundfontData;
+
+// To be increased whenever the layout below or the conversions done when compiling change
+#define COMPILED_SOUNDFONT_VERSION 4
+
+enum class ECompiledSynth : uint8_t
+{
+    None,
+    GS,
+    GB
+};
+
+// Soundfont preset, with what PresetsHandler needs to build it whatever the settings
+struct CompiledPreset
+{
+    int32_t bankId;
+    int32_t programId;
+    uint32_t firstRegion;
+    uint32_t numRegions;
+    // Zero-terminated strings in the name table
+    uint32_t nameOffset;
+    uint32_t synthNameOffset;
+
+    // Synth that can replace the preset: first region's sample name and ADSR, duty cycle of GB synths
+    ECompiledSynth synth;
+    uint8_t dutyCycle;
+    uint8_t padding[2];
+    ADSR synthADSR;
+};
+
+// Playable region of a preset, converted to the values of its SoundfontSampleInfo
+struct CompiledRegion
+{
+    int32_t midCfreq;
+    uint32_t sampleRate;
+    uint32_t sampleOffset;
+    uint32_t loopStart;
+    uint32_t loopEnd;
+    ADSR adsr;
+    uint8_t loKey;
+    uint8_t hiKey;
+    uint8_t loVelocity;
+    uint8_t hiVelocity;
+    uint8_t notePitch;
+    int8_t rhythmPan;
+    ESampleFormat format;
+    bool bLoopEnabled;
+    bool bFixed;
+    bool bGuarded;
+    uint8_t padding[2];
+};
+
+static_assert(std::is_trivially_copyable<CompiledPreset>::value && sizeof(CompiledPreset) == 32, "CompiledPreset is stored as is");
+static_assert(std::is_trivially_copyable<CompiledRegion>::value && sizeof(CompiledRegion) == 36, "CompiledRegion is stored as is");
+
+// The SF2 file a compiled soundfont was built from
+struct SoundfontIdentity
+{
+    uint64_t size = 0;
+    int64_t modificationTime = 0;
+    // Of all the chunks except the sample data
+    uint64_t hash = 0;
+
+    bool operator==(const SoundfontIdentity& other) const
+    {
+        return size == other.size && modificationTime == other.modificationTime && hash == other.hash;
+    }
+};
+
+/*
+ * On-disk cache of the compiled soundfonts, in the user application data directory.
+ * The file holds the preset, region and name tables and the guarded samples, at aligned offsets,
+ * so that it can be used in place once mapped or read.
+ */
+class CompiledSoundfont
+{
+public:
+    static bool getIdentity(const std::string& sf2Path, SoundfontIdentity& out_identity);
+    static std::string getCachePath(const std::string& sf2Path);
+
+    // nullptr if the cache is missing, invalid or compiled from another file. Mapped or read in memory
+    static std::unique_ptr<SoundfontData> load(const std::string& cachePath, const SoundfontIdentity& identity, bool bMapped);
+
+    // Only for soundfonts whose regions are all guarded
+    static bool write(const std::string& cachePath, const SoundfontIdentity& identity, const SoundfontData& data);
+};
+
+}
@@ -2,6 +2,7 @@
 #include "PresetsHandler.h"
 
 #include "Processor/SampleInstrument.h"
+#include "Processor/VoicePool.h"
 #include "GS/GSSynths.h"
 
 #include <map>
@@ -15,194 +16,110 @@ namespace GSVST {
 
 const ADSR SoundfontPreset::m_emptyADSR;
 
-std::string EnumToString_EPresetType(EPresetType type)
+void RegionIndex::build(const std::vector<Range>& regionRanges)
 {
-    switch (type)
+    m_layers.clear();
+
+    for (int key = 0; key < 128; key++)
     {
-    case EPresetType::Sample: return "Sample";
-    case EPresetType::Soundfont: return "Sf2";
-    case EPresetType::Synth: return "Synth";
+        m_keyLayers[key] = static_cast<uint32_t>(m_layers.size());
+
+        for (size_t i = 0; i < regionRanges.size(); i++)
+        {
+            const auto& range = regionRanges[i];
+            if (key >= range.loKey && key <= range.hiKey && range.loVelocity <= range.hiVelocity)
+            {
+                m_layers.push_back({ static_cast<uint8_t>(std::min<uint16_t>(range.loVelocity, 127)),
+                    static_cast<uint8_t>(std::min<uint16_t>(range.hiVelocity, 127)), static_cast<uint16_t>(i) });
+            }
+        }
     }
 
-    return "";
+    m_keyLayers[128] = static_cast<uint32_t>(m_layers.size());
 }
 
-//-----------------------------------------------------------------------------
-Instrument* SynthPreset::createPlayingInstance(const Note& note) const
+int RegionIndex::find(int key, int velocity) const
 {
-    assert(synthType == EDSPType::Saw || synthType == EDSPType::Tri);
-    return GSSynth::createSynth(synthType, note);
-}
+    if (key < 0 || key > 127)
+        return -1;
 
-//-----------------------------------------------------------------------------
-Instrument* PWMSynthPreset::createPlayingInstance(const Note& note) const
-{
-    return GSPWMSynth::createPWMSynth(pwmdata, note);
-}
+    for (auto i = m_keyLayers[key]; i < m_keyLayers[key + 1]; i++)
+    {
+        const auto& layer = m_layers[i];
+        if (velocity >= layer.loVelocity && velocity <= layer.hiVelocity)
+            return layer.region;
+    }
 
-//-----------------------------------------------------------------------------
-SamplePreset::SamplePreset(int in_bankid, int in_programid, std::string&& in_name, std::string&& in_filepath, ADSR&& in_adsr, SampleInfo&& in_info)
-    : Preset(in_bankid, in_programid, EPresetType::Sample, std::move(in_name))
-    , m_filepath(std::move(in_filepath))
-    , m_info(std::move(in_info))
-{
-    m_info.adsr = std::move(in_adsr);
+    return -1;
 }
 
-
-Instrument* SamplePreset::createPlayingInstance(const Note& note) const
+std::string EnumToString_EPresetType(EPresetType type)
 {
-    auto* sampleInfo = new SampleInfo(m_info);
-    sampleInfo->numChannels = m_numChannels;
-    sampleInfo->sampleBuffer = m_audioBuffer.getArrayOfReadPointers();
-
-    if (!sampleInfo->loopEnabled)
+    switch (type)
     {
-        sampleInfo->endPos = m_lengthInSamples;
+    case EPresetType::Sample: return "Sample";
+    case EPresetType::Soundfont: return "Sf2";
+    case EPresetType::Synth: return "Synth";
     }
 
-    return new SampleInstrument(std::move(sampleInfo), note);
+    return "";
 }
 
-bool SamplePreset::loadFile(juce::AudioFormatManager& formatManager)
+//-----------------------------------------------------------------------------
+Instrument* SynthPreset::createPlayingInstance(const Note& note, VoicePool& pool) const
 {
-    auto file = juce::File(m_filepath);
-    if (!file.exists())
-        return false;
-
-    auto* reader = formatManager.createReaderFor(file);
-    m_audioBuffer.setSize(reader->numChannels, reader->lengthInSamples);
-    reader->read(&m_audioBuffer, 0, reader->lengthInSamples, 0, true, true);
-    m_numChannels = reader->numChannels;
-    m_lengthInSamples = reader->lengthInSamples;
-
-    delete reader;
-
-    return true;
+    assert(synthType == EDSPType::Saw || synthType == EDSPType::Tri);
+    return GSSynth::createSynth(synthType, note, pool);
 }
 
 //-----------------------------------------------------------------------------
-SampleMultiPreset::SampleMultiPreset(int in_bankid, int in_programid, std::string&& in_name, ADSR&& in_adsr, std::vector<MultiSample>&& in_info)
-    : Preset(in_bankid, in_programid, EPresetType::Sample, std::move(in_name))
-    , samples(std::move(in_info))
-    , adsr(std::move(in_adsr))
-
+Instrument* PWMSynthPreset::createPlayingInstance(const Note& note, VoicePool& pool) const
 {
+    return GSPWMSynth::createPWMSynth(pwmdata, note, pool);
 }
 
-Instrument* SampleMultiPreset::createPlayingInstance(const Note& note) const
+//-----------------------------------------------------------------------------
+SoundfontPreset::SoundfontPreset(int in_bankid, int in_programid, std::string&& in_name, const SoundfontData& in_soundfont, std::vector<SoundfontSampleInfo>&& in_samples)
+    : Preset(in_bankid, in_programid, EPresetType::Soundfont, std::move(in_name))
+    , m_soundfont(in_soundfont)
+    , samples(std::move(in_samples))
 {
-    auto noteNum = note.midiKeyPitch;
-    auto found = std::find_if(samples.begin(), samples.end(), [noteNum](auto& s) { return noteNum >= s.keyRange.first && noteNum <= s.keyRange.second; });
-    if (found == samples.end())
-        return nullptr;
-
-    auto* sample = &(*found);
-
-    auto* sampleInfo = new SampleInfo(sample->info);
-    sampleInfo->numChannels = sample->numChannels;
-    sampleInfo->sampleBuffer = sample->audioBuffer.getArrayOfReadPointers();
-
-    sampleInfo->loopEnabled = sample->loopEnabled;
-    if (sample->loopEnabled)
-    {
-        sampleInfo->loopPos = sample->loopStart;
-        sampleInfo->endPos = sample->loopEnd;
-    }
-    else
+    std::vector<RegionIndex::Range> ranges(samples.size());
+    for (size_t i = 0; i < samples.size(); i++)
     {
-        sampleInfo->endPos = sample->lengthInSamples;
+        ranges[i] = { samples[i].keyRange.first, samples[i].keyRange.second,
+            samples[i].velocityRange.first, samples[i].velocityRange.second };
     }
 
-    Note noteToUse = note;
-    noteToUse.rhythmPan = sampleInfo->rhythmPan;
-
-    return new SampleInstrument(std::move(sampleInfo), noteToUse);
+    m_regionIndex.build(ranges);
 }
 
-void SampleMultiPreset::getLoopTimesFromFile(juce::AudioFormatManager& formatManager, std::string filePath, int& loopStart, int& loopEnd)
+Instrument* SoundfontPreset::createPlayingInstance(const Note& note, VoicePool& pool) const
 {
-    auto file = juce::File(filePath);
-    if (!file.exists())
-        return;
-
-    auto* reader = formatManager.createReaderFor(file);
-
-    juce::String defaultVal = "";
-    auto startVal = reader->metadataValues.getValue("Cue0Offset", defaultVal);
-    auto endVal = reader->metadataValues.getValue("Cue1Offset", defaultVal);
-
-    loopStart = std::stoi(std::string(startVal.getCharPointer()));
-    loopEnd = std::stoi(std::string(endVal.getCharPointer()));
-
-    delete reader;
-}
-
-
-bool SampleMultiPreset::loadFiles(juce::AudioFormatManager& formatManager, bool bSearchForLoopPoints)
-{
-    bool bHasErrors = false;
-
-    for (auto& sample : samples)
-    {
-        auto file = juce::File(sample.filePath);
-        if (!file.exists())
-        {
-            bHasErrors = true;
-            continue;
-        }
-
-        auto* reader = formatManager.createReaderFor(file);
-        sample.audioBuffer.setSize(reader->numChannels, reader->lengthInSamples);
-        reader->read(&sample.audioBuffer, 0, reader->lengthInSamples, 0, true, true);
-        sample.numChannels = reader->numChannels;
-        sample.lengthInSamples = reader->lengthInSamples;
-
-        sample.info.setMidCFreq(0, sample.info.rootNote, std::round(reader->sampleRate));
-
-        if (bSearchForLoopPoints)
-        {
-            juce::String defaultVal = "";
-            auto startVal = reader->metadataValues.getValue("Cue0Offset", defaultVal);
-            auto endVal = reader->metadataValues.getValue("Cue1Offset", defaultVal);
-
-            if (startVal != "")
-                sample.loopStart = std::stoi(std::string(startVal.getCharPointer()));
-            if (endVal != "")
-                sample.loopEnd = std::stoi(std::string(endVal.getCharPointer()));
-
-            sample.loopEnabled = true;
-        }
-        else
-        {
-            sample.loopEnabled = false;
-        }
-
-        delete reader;
-    }
+    auto regionId = m_regionIndex.find(note.midiKeyPitch, note.midiVelocity);
+    if (regionId < 0)
+        return nullptr;
 
-    return !bHasErrors;
-}
+    auto* sample = &samples[regionId];
 
-//-----------------------------------------------------------------------------
-Instrument* SoundfontPreset::createPlayingInstance(const Note& note) const
-{
-    auto noteNum = note.midiKeyPitch;
-    auto found = std::find_if(samples.begin(), samples.end(), [noteNum](auto& s) { return noteNum >= s.keyRange.first && noteNum <= s.keyRange.second; });
-    if (found == samples.end())
+    // Pools full: the note is dropped
+    auto* sampleInfo = pool.createSampleInfo(*sample);
+    if (!sampleInfo)
         return nullptr;
 
-    auto* sample = &(*found);
-
-    auto* sampleInfo = new SoundfontSampleInfo(*sample);
-    sampleInfo->numChannels = 1;
-    sampleInfo->soundFontSamplePtr = m_presetsHandler.getSoundfontBuffer(sample->offset);
+    sampleInfo->soundFontSamplePtr = m_soundfont.getSamples(sample->format, sample->offset);
 
     Note noteToUse = note;
     noteToUse.rhythmPan = sampleInfo->rhythmPan;
     noteToUse.midiKeyPitch = sampleInfo->fixed ? sampleInfo->notePitch : note.midiKeyPitch;
 
-    auto* newInstance = new SoundfontSampleInstrument(std::move(sampleInfo), noteToUse);
+    auto* newInstance = pool.createVoice<SoundfontSampleInstrument>(sampleInfo, noteToUse, pool);
+    if (!newInstance)
+    {
+        pool.destroySampleInfo(sampleInfo);
+        return nullptr;
+    }
+
     bool bUseTrackADSR = (!sampleInfo->fixed && samples.size() == 1);
     newInstance->useTrackADSR(bUseTrackADSR);
 
@@ -18,7 +18,8 @@ struct tsf;
 namespace GSVST {
 
 class Instrument;
-struct PresetsHandler;
+class VoicePool;
+struct SoundfontData;
 
 enum class EPresetType : uint8_t
 {
@@ -40,7 +41,7 @@ public:
     {}
     virtual ~Preset() {}
 
-    virtual Instrument* createPlayingInstance(const Note& note) const = 0;
+    virtual Instrument* createPlayingInstance(const Note& note, VoicePool& pool) const = 0;
     virtual EDSPType getDSPType() const = 0;
     virtual const ADSR& getADSR() const = 0;
     virtual void getPWMData(PWMData&) const {}
@@ -52,6 +53,37 @@ public:
     const std::string name;
 };
 
+// Region played by each key and velocity, built once with the preset: a note-on only checks the
+// regions covering its key. The first region in the preset's order wins when several overlap
+class RegionIndex
+{
+public:
+    struct Range
+    {
+        uint16_t loKey = 0;
+        uint16_t hiKey = 127;
+        uint16_t loVelocity = 0;
+        uint16_t hiVelocity = 127;
+    };
+
+    void build(const std::vector<Range>& regionRanges);
+
+    // -1 if no region plays this note
+    int find(int key, int velocity) const;
+
+private:
+    struct Layer
+    {
+        uint8_t loVelocity;
+        uint8_t hiVelocity;
+        uint16_t region;
+    };
+
+    // Layers of a key are [m_keyLayers[key], m_keyLayers[key + 1])
+    uint32_t m_keyLayers[129] = {};
+    std::vector<Layer> m_layers;
+};
+
 class SynthPreset : public Preset
 {
 public:
@@ -61,7 +93,7 @@ public:
         , adsr(std::move(in_adsr))
     {}
 
-    Instrument* createPlayingInstance(const Note& note) const final;
+    Instrument* createPlayingInstance(const Note& note, VoicePool& pool) const final;
     EDSPType getDSPType() const final { return synthType; }
     const ADSR& getADSR() const final { return adsr; }
 
@@ -80,7 +112,7 @@ public:
         , pwmdata(std::move(in_data))
     {}
 
-    Instrument* createPlayingInstance(const Note& note) const final;
+    Instrument* createPlayingInstance(const Note& note, VoicePool& pool) const final;
     EDSPType getDSPType() const final { return EDSPType::ModPulse; }
     const ADSR& getADSR() const final { return adsr; }
     void getPWMData(PWMData& out_data) const final { out_data = pwmdata; }
@@ -89,87 +121,21 @@ public:
     const PWMData pwmdata;
 };
 
-class SamplePreset : public Preset
-{
-public:
-    SamplePreset(int in_bankid, int in_programid, std::string&& in_name, std::string&& in_filepath, ADSR&& in_adsr, SampleInfo&& in_info);
-
-    Instrument* createPlayingInstance(const Note& note) const final;
-    EDSPType getDSPType() const final { return EDSPType::PCM; }
-    const ADSR& getADSR() const final { return m_info.adsr; }
-
-    bool loadFile(juce::AudioFormatManager& formatManager);
-
-private:
-    const std::string m_filepath;
-    SampleInfo m_info;
-
-    juce::AudioBuffer<float> m_audioBuffer;
-    unsigned int m_numChannels = 0;
-    int64_t m_lengthInSamples = 0;
-};
-
-class SampleMultiPreset : public Preset
-{
-public:
-    struct MultiSample
-    {
-        MultiSample(std::string&& in_filePath, SampleInfo&& in_info, uint16_t lowRange, uint16_t upRange)
-            : filePath(std::move(in_filePath))
-            , info(std::move(in_info))
-        {
-            keyRange.first = lowRange;
-            keyRange.second = upRange;
-        }
-
-        std::string filePath;
-        SampleInfo info;
-        std::pair<uint16_t, uint16_t> keyRange;
-
-        juce::AudioBuffer<float> audioBuffer;
-        unsigned int numChannels = 0;
-        int64_t lengthInSamples = 0;
-
-        bool loopEnabled = false;
-        int loopStart = 0;
-        int loopEnd = 0;
-    };
-
-    SampleMultiPreset(int in_bankid, int in_programid, std::string&& in_name, ADSR&& in_adsr, std::vector<MultiSample>&& in_info);
-
-    Instrument* createPlayingInstance(const Note& note) const final;
-    EDSPType getDSPType() const final { return EDSPType::PCM; }
-    const ADSR& getADSR() const final { return adsr; }
-    bool isDrumMap() const const { return m_bIsDrumMap; }
-
-    bool loadFiles(juce::AudioFormatManager& formatManager, bool bSearchForLoopPoints);
-    void setIsDrumMap(bool bSet) { m_bIsDrumMap = bSet; }
-
-    static void getLoopTimesFromFile(juce::AudioFormatManager& formatManager, std::string filePath, int& loopStart, int& loopEnd);
-
-private:
-    std::vector<MultiSample> samples;
-    ADSR adsr;
-    bool m_bIsDrumMap = false;
-};
-
 class SoundfontPreset : public Preset
 {
 public:
-    SoundfontPreset(int in_bankid, int in_programid, std::string&& in_name, const PresetsHandler& in_presetsHandler, std::vector<SoundfontSampleInfo>&& in_samples)
-        : Preset(in_bankid, in_programid, EPresetType::Soundfont, std::move(in_name))
-        , m_presetsHandler(in_presetsHandler)
-        , samples(std::move(in_samples))
-    {}
+    SoundfontPreset(int in_bankid, int in_programid, std::string&& in_name, const SoundfontData& in_soundfont, std::vector<SoundfontSampleInfo>&& in_samples);
 
-    Instrument* createPlayingInstance(const Note& note) const final;
+    Instrument* createPlayingInstance(const Note& note, VoicePool& pool) const final;
     EDSPType getDSPType() const final;
     const ADSR& getADSR() const final;
 
 private:
 
-    const PresetsHandler& m_presetsHandler;
+    // Kept alive by the preset set
+    const SoundfontData& m_soundfont;
     std::vector<SoundfontSampleInfo> samples;
+    RegionIndex m_regionIndex;
 
     static const ADSR m_emptyADSR;
 };
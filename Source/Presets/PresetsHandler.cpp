@@ -4,6 +4,7 @@
 
 #include "Processor/SampleInstrument.h"
 #include "Processor/CGBChannel.h"
+#include "Processor/Trace.h"
 
 #include "GS/GSPresets.h"
 
@@ -11,159 +12,97 @@
 #include "External/tinysoundfont/tsf.h"
 
 #include <map>
+#include <set>
 #include <algorithm>
+#include <chrono>
 #include <assert.h>
 
 #include <JuceHeader.h>
 
 namespace GSVST {
 
-PresetsHandler::PresetsHandler()
-{
-    m_formatManager.reset(new juce::AudioFormatManager());
-    m_formatManager->registerBasicFormats();
-}
-
-PresetsHandler::~PresetsHandler()
-{
-    clear();
-}
-
-void PresetsHandler::sort()
-{
-    std::sort(m_presets.begin(), m_presets.end(),
-        [](const auto* l, const auto* r)
-        {
-            if (l->bankid != r->bankid)
-                return l->bankid < r->bankid;
-            return l->programid < r->programid;
-        }
-    );
-}
-
-const ProgramInfo* PresetsHandler::findProgramInfo(const std::list<ProgramInfo>& list, int bankid, int programid) const
+// Sample layout of a region, as played by SoundfontSampleInfo, within the smplCount samples of the font.
+// False if the region starts outside of them or loops before its start
+static bool getRegionLoop(const tsf_region& region, unsigned int smplCount, bool& out_bLoopEnabled, uint32_t& out_loopStart, uint32_t& out_loopEnd)
 {
-    const auto& it = std::find_if(list.begin(), list.end(), [&](const auto& e) {
-        return e.bankid == bankid && e.programid == programid; });
-
-    if (it != list.end())
-        return &(*it);
+    out_bLoopEnabled = (region.loop_mode == 1);
 
-    return nullptr;
-}
-
-const std::list<ProgramInfo>& PresetsHandler::getProgramInfo() const
-{
-    if (m_selectedGame == "SF2")
-    {
-        return m_emptyList;
-    }
-    else
-    {
-        auto& programList = getGamesProgramList();
-        if (programList.find(m_selectedGame) != programList.end())
-            return programList.at(m_selectedGame);
-    }
+    if (region.offset >= smplCount || region.end < region.offset)
+        return false;
 
-    return m_emptyList;
-}
+    if (out_bLoopEnabled && (region.loop_start < region.offset || region.loop_end < region.offset))
+        return false;
 
-void PresetsHandler::setSoundfont(const std::string& path)
-{
-    soundFontPath = path;
+    // tsf clamps the loop end to the last sample, which the loop includes
+    const uint32_t maxLength = smplCount - region.offset;
+    const uint32_t length = std::min(region.end - region.offset, maxLength);
 
-    clearPresetsOfType(EPresetType::Synth);
-    clearPresetsOfType(EPresetType::Soundfont);
+    out_loopStart = (out_bLoopEnabled ? region.loop_start - region.offset : 0);
+    out_loopEnd = (out_bLoopEnabled ? std::min((region.loop_end - region.offset) + 1, maxLength) : length);
 
-    if (juce::File(path).exists())
+    // Inverted loop points: played once
+    if (out_loopStart > out_loopEnd)
     {
-        addSoundFontPresets();
-        sort();
+        out_bLoopEnabled = false;
+        out_loopStart = 0;
+        out_loopEnd = length;
     }
-    else
-    {
-        addSynthsPresets();
-    }
-}
 
-float* PresetsHandler::getSoundfontBuffer(unsigned int offset) const
-{
-    return &(soundFont->fontSamples[offset]);
+    return true;
 }
 
-void PresetsHandler::setAutoReplaceGSSynths(bool bEnable)
+// Appends the sample and its guard samples, divided by scale to fit in T
+template <typename T>
+static unsigned int appendGuardedSample(std::vector<T>& samples, const int16_t* src, int scale, bool bLoop, uint32_t loopStart, uint32_t loopEnd)
 {
-    if (m_bAutoReplaceGSSynthsEnabled != bEnable)
-    {
-        m_bAutoReplaceGSSynthsEnabled = bEnable;
+    const auto guardedOffset = static_cast<unsigned int>(samples.size());
+    for (uint32_t i = 0; i < loopEnd; i++)
+        samples.push_back(static_cast<T>(src[i] / scale));
 
-        if (!bEnable)
-            clearPresetsOfType(EPresetType::Synth);
-
-        addSoundFontPresets();
-        sort();
-    }
-}
-
-void PresetsHandler::setAutoReplaceGBSynths(bool bEnable)
-{
-    if (m_bAutoReplaceGBSynthsEnabled != bEnable)
+    // What the resampler reads after the end: the loop start, or silence
+    for (uint32_t i = 0; i < SAMPLE_GUARD_SIZE; i++)
     {
-        m_bAutoReplaceGBSynthsEnabled = bEnable;
-
-        addSoundFontPresets();
-        sort();
+        if (bLoop)
+            samples.push_back(static_cast<T>(src[loopStart + i % (loopEnd - loopStart)] / scale));
+        else
+            samples.push_back(0);
     }
-}
-
-void PresetsHandler::setHideUnknownInstruments(bool bHide)
-{
-    if (m_bHideUnknownInstruments != bHide)
-    {
-        m_bHideUnknownInstruments = bHide;
 
-        addSoundFontPresets();
-        sort();
-    }
+    return guardedOffset;
 }
 
-void PresetsHandler::setSelectedGame(const std::string& gameName)
+struct GuardedSample
 {
-    if (m_selectedGame != gameName)
-    {
-        m_selectedGame = gameName;
+    ESampleFormat format;
+    unsigned int offset;
+};
 
-        addSoundFontPresets();
-        sort();
-    }
-}
+// (sample offset in the font, loop start, end, loop enabled) -> location of the guarded copy
+typedef std::map<std::tuple<unsigned int, uint32_t, uint32_t, bool>, GuardedSample> GuardedSampleMap;
 
-void PresetsHandler::clear()
+static const GuardedSample& addGuardedSample(SoundfontData& data, GuardedSampleMap& guardedSamples, const int16_t* fontSamples, unsigned int fontOffset, bool bLoopEnabled, uint32_t loopStart, uint32_t loopEnd)
 {
-    for (auto* preset : m_presets)
-    {
-        delete preset;
-    }
-
-    m_presets.clear();
-}
+    // Regions often share the same sample and loop points
+    const auto key = std::make_tuple(fontOffset, loopStart, loopEnd, bLoopEnabled);
+    auto found = guardedSamples.find(key);
+    if (found != guardedSamples.end())
+        return found->second;
+
+    const int16_t* src = fontSamples + fontOffset;
+    const bool bLoop = bLoopEnabled && loopEnd > loopStart;
+
+    // GBA samples are 8 bits, stored in the high byte by the rippers
+    GuardedSample guarded;
+    guarded.format = getCompactSampleFormat(src, loopEnd);
+    if (guarded.format == ESampleFormat::Int8)
+        guarded.offset = appendGuardedSample(data.guardedSamples8, src, 256, bLoop, loopStart, loopEnd);
+    else
+        guarded.offset = appendGuardedSample(data.guardedSamples16, src, 1, bLoop, loopStart, loopEnd);
 
-void PresetsHandler::clearPresetsOfType(EPresetType type)
-{
-    for (auto it = m_presets.begin(); it != m_presets.end(); )
-    {
-        auto* preset = (*it);
-        if (preset->type == type)
-        {
-            delete preset;
-            it = m_presets.erase(it);
-        }
-        else
-            ++it;
-    }
+    return guardedSamples[key] = guarded;
 }
 
-bool PresetsHandler::isGSSynth(int bankId, const std::string& presetName)
+static bool isGSSynth(int bankId, const std::string& presetName)
 {
     if (bankId != 0)
         return false;
@@ -176,7 +115,7 @@ bool PresetsHandler::isGSSynth(int bankId, const std::string& presetName)
     return false;
 }
 
-bool PresetsHandler::isGBSynth(const std::string& presetName)
+static bool isGBSynth(const std::string& presetName)
 {
     if (presetName.find("square ") != std::string::npos)
         return true;
@@ -184,20 +123,7 @@ bool PresetsHandler::isGBSynth(const std::string& presetName)
     return false;
 }
 
-bool PresetsHandler::isSynth(const tsf_preset& preset)
-{
-    if (preset.regionNum == 0)
-        return false;
-
-    auto& region = preset.regions[0];
-
-    if (isGBSynth(region.sampleName) || isGSSynth(preset.bank, region.sampleName))
-        return true;
-
-    return false;
-}
-
-ADSR PresetsHandler::getSoundfontADSR(const tsf_region& region)
+static ADSR getSoundfontADSR(const tsf_region& region)
 {
     auto& adsr = region.ampenv;
 
@@ -264,132 +190,629 @@ ADSR PresetsHandler::getSoundfontADSR(const tsf_region& region)
     }
 }
 
-void PresetsHandler::addSoundFontPresets()
+// Same as tsf_load, except that the sample chunk is located but not read nor converted
+static tsf* loadPresetTables(const void* fileData, size_t fileSize, size_t& out_smplOffset, unsigned int& out_smplCount)
 {
-    if (soundFontPath.empty())
-        return;
+    struct tsf_stream_memory memory = { static_cast<const char*>(fileData), static_cast<unsigned int>(fileSize), 0 };
+    struct tsf_stream stream = { &memory, (int(*)(void*, void*, unsigned int))&tsf_stream_memory_read, (int(*)(void*, unsigned int))&tsf_stream_memory_skip };
 
-    clearPresetsOfType(EPresetType::Soundfont);
-    clearPresetsOfType(EPresetType::Synth);
+    struct tsf_riffchunk chunkHead, chunkList, chunk;
+    if (!tsf_riffchunk_read(nullptr, &chunkHead, &stream) || !TSF_FourCCEquals(chunkHead.id, "sfbk"))
+        return nullptr;
 
-    cleanupSoundfont();
-    soundFont = tsf_load_filename(soundFontPath.c_str());
+    struct tsf_hydra hydra;
+    memset(&hydra, 0, sizeof(hydra));
+    out_smplCount = 0;
 
-    if (!soundFont)
-        return;
+    while (tsf_riffchunk_read(&chunkHead, &chunkList, &stream))
+    {
+        if (TSF_FourCCEquals(chunkList.id, "pdta"))
+        {
+            while (tsf_riffchunk_read(&chunkList, &chunk, &stream))
+            {
+                #define HandleChunk(chunkName, sizeInFile) (TSF_FourCCEquals(chunk.id, #chunkName) && !(chunk.size % sizeInFile) && !hydra.chunkName##s) \
+                    { \
+                        hydra.chunkName##Num = static_cast<int>(chunk.size / sizeInFile); \
+                        hydra.chunkName##s = (struct tsf_hydra_##chunkName*)TSF_MALLOC(hydra.chunkName##Num * sizeof(struct tsf_hydra_##chunkName)); \
+                        if (!hydra.chunkName##s) break; \
+                        for (int i = 0; i < hydra.chunkName##Num; ++i) tsf_hydra_read_##chunkName(&hydra.chunkName##s[i], &stream); \
+                    }
+                if      HandleChunk(phdr, 38) else if HandleChunk(pbag, 4) else if HandleChunk(pmod, 10)
+                else if HandleChunk(pgen, 4) else if HandleChunk(inst, 22) else if HandleChunk(ibag, 4)
+                else if HandleChunk(imod, 10) else if HandleChunk(igen, 4) else if HandleChunk(shdr, 46)
+                else stream.skip(stream.data, chunk.size);
+                #undef HandleChunk
+            }
+        }
+        else if (TSF_FourCCEquals(chunkList.id, "sdta"))
+        {
+            while (tsf_riffchunk_read(&chunkList, &chunk, &stream))
+            {
+                if (TSF_FourCCEquals(chunk.id, "smpl") && out_smplCount == 0 && chunk.size >= sizeof(short))
+                {
+                    out_smplOffset = memory.pos;
+                    out_smplCount = chunk.size / sizeof(short);
+                }
+                stream.skip(stream.data, chunk.size);
+            }
+        }
+        else stream.skip(stream.data, chunkList.size);
+    }
 
-    for (int i = 0; i < tsf_get_presetcount(soundFont); i++)
+    tsf* res = nullptr;
+    if (hydra.phdrs && hydra.pbags && hydra.pmods && hydra.pgens && hydra.insts && hydra.ibags && hydra.imods && hydra.igens && hydra.shdrs
+        && out_smplCount > 0)
     {
-        const auto& preset = soundFont->presets[i];
-        auto bankId = preset.bank;
-        auto presetId = preset.preset;
-        auto name = tsf_get_presetname(soundFont, i);
+        res = (tsf*)TSF_MALLOC(sizeof(tsf));
+        if (res)
+        {
+            memset(res, 0, sizeof(tsf));
+            if (tsf_load_presets(res, &hydra, out_smplCount))
+            {
+                res->outSampleRate = 44100.0f;
+            }
+            else
+            {
+                TSF_FREE(res);
+                res = nullptr;
+            }
+        }
+    }
 
-        if (std::find_if(m_presets.begin(), m_presets.end(), [&](auto* p) { return p->programid == presetId && p->bankid == bankId; }) != m_presets.end())
-            continue; // Don't add presets if there's already a Sample or Synth version of it
+    TSF_FREE(hydra.phdrs); TSF_FREE(hydra.pbags); TSF_FREE(hydra.pmods);
+    TSF_FREE(hydra.pgens); TSF_FREE(hydra.insts); TSF_FREE(hydra.ibags);
+    TSF_FREE(hydra.imods); TSF_FREE(hydra.igens); TSF_FREE(hydra.shdrs);
+    return res;
+}
 
-        const auto& friendlyNames = getProgramInfo();
-        const auto* foundFriendlyName = findProgramInfo(friendlyNames, bankId, presetId);
-        if (m_bHideUnknownInstruments && !foundFriendlyName)
-            continue;
+static uint32_t addName(std::vector<char>& names, const char* name)
+{
+    const auto offset = static_cast<uint32_t>(names.size());
+    names.insert(names.end(), name, name + strlen(name) + 1);
+    return offset;
+}
+
+// Converts everything the presets are built from, whatever the settings. Without fontSamples,
+// the regions read the smplCount samples of the SF2 file in place, without guard samples
+static void compileSoundfont(const tsf& font, const int16_t* fontSamples, unsigned int smplCount, SoundfontData& data)
+{
+    GuardedSampleMap guardedSamples;
+    data.nameTable.push_back('\0');
+
+    for (int i = 0; i < font.presetNum; i++)
+    {
+        const auto& preset = font.presets[i];
+        const bool bIsEveryKeySplit = (std::string(preset.presetName).find("Type 128") != std::string::npos);
 
+        CompiledPreset compiled = {};
+        compiled.bankId = preset.bank;
+        compiled.programId = preset.preset;
+        compiled.firstRegion = static_cast<uint32_t>(data.regionTable.size());
+        compiled.nameOffset = addName(data.nameTable, preset.presetName);
+        compiled.synth = ECompiledSynth::None;
+
+        if (preset.regionNum > 0 && !bIsEveryKeySplit)
         {
-            std::string friendlyName = (foundFriendlyName ? foundFriendlyName->name : "");
-            auto* newPreset = buildSoundfontPreset(preset, name, friendlyName);
-            assert(newPreset);
-            if (newPreset)
+            const auto& firstRegion = preset.regions[0];
+            const std::string synthName = firstRegion.sampleName;
+
+            if (isGSSynth(preset.bank, synthName))
+            {
+                compiled.synth = ECompiledSynth::GS;
+            }
+            else if (isGBSynth(synthName))
+            {
+                auto dutyCycle = WaveDuty::D12;
+                if (synthName.find("square 12.5%") != std::string::npos)
+                    dutyCycle = WaveDuty::D12;
+                else if (synthName.find("square 25%") != std::string::npos)
+                    dutyCycle = WaveDuty::D25;
+                else if (synthName.find("square 50%") != std::string::npos)
+                    dutyCycle = WaveDuty::D50;
+                else if (synthName.find("square 75%") != std::string::npos) // Requires a modified version of GBA Mus Ripper
+                    dutyCycle = WaveDuty::D75;
+
+                compiled.synth = ECompiledSynth::GB;
+                compiled.dutyCycle = static_cast<uint8_t>(dutyCycle);
+            }
+
+            if (compiled.synth != ECompiledSynth::None)
             {
-                m_presets.push_back(newPreset);
+                compiled.synthNameOffset = addName(data.nameTable, firstRegion.sampleName);
+                compiled.synthADSR = getSoundfontADSR(firstRegion);
             }
         }
+
+        for (int j = 0; j < preset.regionNum; j++)
+        {
+            const auto& region = preset.regions[j];
+            // Never played
+            if (region.hivel == 0 || region.lokey > region.hikey || region.lokey > 127 || region.lovel > region.hivel || region.lovel > 127)
+                continue;
+
+            CompiledRegion compiledRegion = {};
+            if (!getRegionLoop(region, smplCount, compiledRegion.bLoopEnabled, compiledRegion.loopStart, compiledRegion.loopEnd))
+                continue;
+
+            SampleInfo pitchInfo;
+            pitchInfo.setMidCFreq(region.tune, region.pitch_keycenter, region.sample_rate);
+            compiledRegion.midCfreq = pitchInfo.midCfreq;
+
+            compiledRegion.sampleRate = region.sample_rate;
+            compiledRegion.bFixed = (region.pitch_keytrack == 0);
+            compiledRegion.adsr = getSoundfontADSR(region);
+            compiledRegion.loKey = static_cast<uint8_t>(region.lokey);
+            compiledRegion.hiKey = static_cast<uint8_t>(std::min<int>(region.hikey, 127));
+            compiledRegion.loVelocity = static_cast<uint8_t>(region.lovel);
+            compiledRegion.hiVelocity = static_cast<uint8_t>(std::min<int>(region.hivel, 127));
+            // 255 is for unpitched samples, which the SF2 specification plays as 60
+            compiledRegion.notePitch = static_cast<uint8_t>(region.pitch_keycenter >= 0 && region.pitch_keycenter <= 127 ? region.pitch_keycenter : 60);
+
+            if (bIsEveryKeySplit && region.pan)
+            {
+                compiledRegion.rhythmPan = static_cast<int8_t>(std::round((region.pan * 256)));
+            }
+
+            if (fontSamples)
+            {
+                const auto& guarded = addGuardedSample(data, guardedSamples, fontSamples, region.offset,
+                    compiledRegion.bLoopEnabled, compiledRegion.loopStart, compiledRegion.loopEnd);
+                compiledRegion.sampleOffset = guarded.offset;
+                compiledRegion.format = guarded.format;
+                compiledRegion.bGuarded = true;
+            }
+            else
+            {
+                compiledRegion.sampleOffset = region.offset;
+                compiledRegion.format = ESampleFormat::Int16;
+            }
+
+            data.regionTable.push_back(compiledRegion);
+        }
+
+        compiled.numRegions = static_cast<uint32_t>(data.regionTable.size()) - compiled.firstRegion;
+        data.presetTable.push_back(compiled);
     }
+
+    data.useOwnedTables();
 }
 
-Preset* PresetsHandler::buildSoundfontPreset(const tsf_preset& preset, const std::string& name, const std::string& friendlyName)
+// Samples are read from the mapping as int16 when playing
+static std::unique_ptr<SoundfontData> loadMappedSoundfont(const std::string& path)
 {
-    Preset* newPreset = nullptr;
+    auto mappedFile = std::make_unique<juce::MemoryMappedFile>(juce::File(path), juce::MemoryMappedFile::readOnly);
+    if (!mappedFile->getData() || mappedFile->getSize() > UINT32_MAX)
+        return nullptr;
+
+    size_t smplOffset = 0;
+    unsigned int smplCount = 0;
+    auto* font = loadPresetTables(mappedFile->getData(), mappedFile->getSize(), smplOffset, smplCount);
+    if (!font)
+        return nullptr;
+
+    // The mapping starts on a page boundary, the chunk offset tells the alignment of the samples
+    if (smplOffset % alignof(int16_t) != 0)
+    {
+        tsf_close(font);
+        return nullptr;
+    }
+
+    auto data = std::make_unique<SoundfontData>();
+    compileSoundfont(*font, nullptr, smplCount, *data);
+    tsf_close(font);
 
-    bool bIsEveryKeySplit = (std::string(name).find("Type 128") != std::string::npos);
-    auto bankId = preset.bank;
-    auto presetId = preset.preset;
+    data->samples16 = reinterpret_cast<const int16_t*>(static_cast<const char*>(mappedFile->getData()) + smplOffset);
+    data->numSamples16 = smplCount;
+    data->mappedFile = std::move(mappedFile);
 
-    if (isSynth(preset) && !bIsEveryKeySplit && preset.regionNum > 0)
+    return data;
+}
+
+static std::unique_ptr<SoundfontData> loadSoundfontInMemory(const std::string& path)
+{
+    juce::MemoryBlock fileData;
+    if (!juce::File(path).loadFileAsData(fileData) || fileData.getSize() > UINT32_MAX)
+        return nullptr;
+
+    size_t smplOffset = 0;
+    unsigned int smplCount = 0;
+    auto* font = loadPresetTables(fileData.getData(), fileData.getSize(), smplOffset, smplCount);
+    if (!font)
+        return nullptr;
+
+    // Read in place from the file data, unless the sample chunk is misaligned
+    const char* smpl = static_cast<const char*>(fileData.getData()) + smplOffset;
+    const int16_t* fontSamples = reinterpret_cast<const int16_t*>(smpl);
+    std::vector<int16_t> alignedSamples;
+    if (smplOffset % alignof(int16_t) != 0)
     {
-        auto firstAdsr = getSoundfontADSR(preset.regions[0]);
-        auto synthName = std::string(preset.regions[0].sampleName);
+        alignedSamples.resize(smplCount);
+        memcpy(alignedSamples.data(), smpl, smplCount * sizeof(int16_t));
+        fontSamples = alignedSamples.data();
+    }
+
+    auto data = std::make_unique<SoundfontData>();
+    compileSoundfont(*font, fontSamples, smplCount, *data);
+    tsf_close(font);
+
+    return data;
+}
+
+static std::unique_ptr<SoundfontData> loadSoundfont(const std::string& path, bool bMapped)
+{
+    GSVST_TRACE_SCOPE("loadSoundfont");
+
+    // Compiled once, then loaded from the cache file as long as the soundfont doesn't change
+    SoundfontIdentity identity;
+    const bool bCacheable = CompiledSoundfont::getIdentity(path, identity);
+    const auto cachePath = CompiledSoundfont::getCachePath(path);
+
+    if (bCacheable)
+    {
+        if (auto data = CompiledSoundfont::load(cachePath, identity, bMapped))
+            return data;
+    }
+
+    auto data = loadSoundfontInMemory(path);
+    if (data && bCacheable && CompiledSoundfont::write(cachePath, identity, *data) && bMapped)
+    {
+        if (auto mapped = CompiledSoundfont::load(cachePath, identity, true))
+            return mapped;
+    }
+
+    if (bMapped)
+    {
+        // The cache can't be written: the SF2 file is mapped instead
+        if (auto mapped = loadMappedSoundfont(path))
+            return mapped;
+    }
+
+    return data;
+}
+
+PresetSet::~PresetSet()
+{
+    for (auto* preset : m_presets)
+    {
+        delete preset;
+    }
+}
 
-        if (m_bAutoReplaceGSSynthsEnabled && isGSSynth(bankId, synthName))
+void PresetSet::sort()
+{
+    std::sort(m_presets.begin(), m_presets.end(),
+        [](const auto* l, const auto* r)
         {
-            if (auto* synthPreset = buildCustomSynthPreset(presetId, synthName, firstAdsr))
-                newPreset = synthPreset;
+            if (l->bankid != r->bankid)
+                return l->bankid < r->bankid;
+            return l->programid < r->programid;
         }
-        else if (m_bAutoReplaceGBSynthsEnabled && isGBSynth(synthName))
+    );
+
+    m_presetIndex.clear();
+    m_presetIndex.reserve(m_presets.size());
+    for (const auto* preset : m_presets)
+        m_presetIndex.emplace(getPresetKey(preset->bankid, preset->programid), preset);
+}
+
+const Preset* PresetSet::findPreset(int bankId, int programId) const
+{
+    auto found = m_presetIndex.find(getPresetKey(bankId, programId));
+    return (found != m_presetIndex.end() ? found->second : nullptr);
+}
+
+void PresetSet::setProgramInfo(const std::list<ProgramInfo>& programInfo)
+{
+    m_programInfoIndex.clear();
+    m_programInfoIndex.reserve(programInfo.size());
+
+    // The first one wins, as when searching the list
+    for (const auto& info : programInfo)
+        m_programInfoIndex.emplace(getPresetKey(info.bankid, info.programid), &info);
+}
+
+const ProgramInfo* PresetSet::findProgramInfo(int bankId, int programId) const
+{
+    auto found = m_programInfoIndex.find(getPresetKey(bankId, programId));
+    return (found != m_programInfoIndex.end() ? found->second : nullptr);
+}
+
+PresetsHandler::PresetsHandler()
+{
+    m_formatManager.reset(new juce::AudioFormatManager());
+    m_formatManager->registerBasicFormats();
+}
+
+PresetsHandler::~PresetsHandler()
+{
+    stopLoading();
+}
+
+void PresetsHandler::stopLoading()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_loaderMutex);
+        m_bLoaderRunning = false;
+        m_pendingSettings.reset();
+    }
+    m_loaderWakeUp.notify_all();
+
+    if (m_loader.joinable())
+        m_loader.join();
+}
+
+const std::list<ProgramInfo>& PresetsHandler::getProgramInfo() const
+{
+    return getProgramInfo(m_settings.selectedGame);
+}
+
+const std::list<ProgramInfo>& PresetsHandler::getProgramInfo(const std::string& gameName) const
+{
+    if (gameName == "SF2")
+    {
+        return m_emptyList;
+    }
+    else
+    {
+        auto& programList = getGamesProgramList();
+        if (programList.find(gameName) != programList.end())
+            return programList.at(gameName);
+    }
+
+    return m_emptyList;
+}
+
+void PresetsHandler::setSoundfont(const std::string& path)
+{
+    m_settings.soundFontPath = path;
+
+    requestPresetSet(true);
+}
+
+void PresetsHandler::setMappedSoundfont(bool bMapped)
+{
+    if (m_settings.bMappedSoundfont != bMapped)
+    {
+        m_settings.bMappedSoundfont = bMapped;
+
+        requestPresetSet();
+    }
+}
+
+void PresetsHandler::setAutoReplaceGSSynths(bool bEnable)
+{
+    if (m_settings.bAutoReplaceGSSynths != bEnable)
+    {
+        m_settings.bAutoReplaceGSSynths = bEnable;
+
+        requestPresetSet();
+    }
+}
+
+void PresetsHandler::setAutoReplaceGBSynths(bool bEnable)
+{
+    if (m_settings.bAutoReplaceGBSynths != bEnable)
+    {
+        m_settings.bAutoReplaceGBSynths = bEnable;
+
+        requestPresetSet();
+    }
+}
+
+void PresetsHandler::setHideUnknownInstruments(bool bHide)
+{
+    if (m_settings.bHideUnknownInstruments != bHide)
+    {
+        m_settings.bHideUnknownInstruments = bHide;
+
+        requestPresetSet();
+    }
+}
+
+void PresetsHandler::setSelectedGame(const std::string& gameName)
+{
+    if (m_settings.selectedGame != gameName)
+    {
+        m_settings.selectedGame = gameName;
+
+        requestPresetSet();
+    }
+}
+
+void PresetsHandler::requestPresetSet(bool bReloadSoundfont)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_loaderMutex);
+        m_pendingSettings = m_settings;
+        m_bReloadPending |= bReloadSoundfont;
+
+        // Started on the first request, stopLoading() has joined it otherwise
+        if (!m_bLoaderRunning)
         {
-            auto dutyCycle = WaveDuty::D12;
-            if (synthName.find("square 12.5%") != std::string::npos)
-                dutyCycle = WaveDuty::D12;
-            else if (synthName.find("square 25%") != std::string::npos)
-                dutyCycle = WaveDuty::D25;
-            else if (synthName.find("square 50%") != std::string::npos)
-                dutyCycle = WaveDuty::D50;
-            else if (synthName.find("square 75%") != std::string::npos) // Requires a modified version of GBA Mus Ripper
-                dutyCycle = WaveDuty::D75;
-
-            newPreset = new SquareSynthPreset(bankId, presetId, std::move(synthName), std::move(firstAdsr), dutyCycle);
+            m_bLoaderRunning = true;
+            m_loader = std::thread([this] { loaderLoop(); });
         }
     }
+    m_loaderWakeUp.notify_all();
+}
 
-    if (!newPreset)
+void PresetsHandler::loaderLoop()
+{
+    std::unique_lock<std::mutex> lock(m_loaderMutex);
+    while (m_bLoaderRunning)
     {
-        std::vector<SoundfontSampleInfo> samples;
+        if (m_pendingSettings)
+        {
+            const auto settings = std::move(*m_pendingSettings);
+            const bool bReload = m_bReloadPending;
+            m_pendingSettings.reset();
+            m_bReloadPending = false;
+
+            lock.unlock();
+            publishPresetSet(buildPresetSet(settings, bReload ? nullptr : getLoadedSoundfont(settings)));
+            lock.lock();
+            continue;
+        }
 
-        for (int j = 0; j < preset.regionNum; j++)
+        // Woken up regularly to free the sets the audio thread is done with
+        m_loaderWakeUp.wait_for(lock, std::chrono::milliseconds(200), [this]
         {
-            auto& region = preset.regions[j];
+            return !m_bLoaderRunning || m_pendingSettings.has_value();
+        });
 
-            if (region.hivel == 0)
-                continue;
+        lock.unlock();
+        collectRetiredPresetSets();
+        lock.lock();
+    }
+}
+
+std::unique_ptr<PresetSet> PresetsHandler::buildPresetSet(const PresetSettings& settings, std::shared_ptr<const SoundfontData> soundfont) const
+{
+    GSVST_TRACE_SCOPE("PresetsHandler::buildPresetSet");
+
+    auto set = std::make_unique<PresetSet>();
+    set->m_settings = settings;
+    set->setProgramInfo(getProgramInfo(settings.selectedGame));
+
+    if (soundfont)
+    {
+        set->m_soundfont = std::move(soundfont);
+    }
+    else if (juce::File(settings.soundFontPath).exists())
+    {
+        set->m_soundfont = SoundfontCache::acquire(settings.soundFontPath, settings.bMappedSoundfont, loadSoundfont);
+    }
+    else
+    {
+        addSynthsPresets(*set);
+    }
 
-            bool bLoopEnabled = (region.loop_mode == 1);
-            auto loopStart = (bLoopEnabled ? region.loop_start - region.offset : 0);
-            auto loopEnd = (bLoopEnabled ? (region.loop_end - region.offset) + 1 : region.end - region.offset);
-            auto offset = region.offset;
+    if (set->m_soundfont)
+        addSoundFontPresets(*set, settings);
 
-            bool fixed = (region.pitch_keytrack == 0);
+    set->sort();
+    return set;
+}
 
-            int8_t rhythmPan = 0;
+std::shared_ptr<const SoundfontData> PresetsHandler::getLoadedSoundfont(const PresetSettings& settings) const
+{
+    std::lock_guard<CheckedMutex> lock(m_setsMutex);
 
-            if (bIsEveryKeySplit && region.pan)
-            {
-                rhythmPan = static_cast<int8_t>(std::round((region.pan * 256)));
-            }
+    if (m_currentSet
+        && m_currentSet->m_settings.soundFontPath == settings.soundFontPath
+        && m_currentSet->m_settings.bMappedSoundfont == settings.bMappedSoundfont)
+        return m_currentSet->m_soundfont;
 
-            auto sampleInfo = SoundfontSampleInfo(fixed, region.sample_rate, bLoopEnabled, loopStart, loopEnd);
-            sampleInfo.setMidCFreq(region.tune, region.pitch_keycenter, region.sample_rate);
-            sampleInfo.adsr = getSoundfontADSR(region);
-            sampleInfo.offset = offset;
-            sampleInfo.keyRange = { region.lokey, region.hikey };
-            sampleInfo.rhythmPan = rhythmPan;
-            sampleInfo.notePitch = static_cast<uint8_t>(region.pitch_keycenter);
+    return nullptr;
+}
 
-            samples.push_back(sampleInfo);
-        }
+void PresetsHandler::publishPresetSet(std::unique_ptr<PresetSet> set)
+{
+    {
+        std::lock_guard<CheckedMutex> lock(m_setsMutex);
+
+        if (m_currentSet)
+            m_retiredSets.push_back(std::move(m_currentSet));
 
-        const auto& label = !friendlyName.empty() ? friendlyName : name;
-        newPreset = new SoundfontPreset(bankId, presetId, std::string(label), *this, std::move(samples));
+        m_currentSet = std::move(set);
+        m_publishedSet.store(m_currentSet.get(), std::memory_order_release);
     }
 
-    return newPreset;
+    m_bPresetSetChanged = true;
+    collectRetiredPresetSets();
 }
 
-void PresetsHandler::cleanupSoundfont()
+void PresetsHandler::collectRetiredPresetSets()
 {
-    if (soundFont)
+    std::vector<std::unique_ptr<PresetSet>> freed;
+
     {
-        tsf_close(const_cast<tsf*>(soundFont));
-        //deletion handled by tsf
-        soundFont = nullptr;
+        std::lock_guard<CheckedMutex> lock(m_setsMutex);
+
+        // The acknowledged set is always one that was published, so the audio thread is done with all the older ones
+        if (m_acknowledgedSet.load(std::memory_order_acquire) == m_currentSet.get())
+            freed.swap(m_retiredSets);
     }
+
+    // Freed outside of the lock: the soundfont data can be large
+}
+
+void PresetsHandler::addSoundFontPresets(PresetSet& set, const PresetSettings& settings) const
+{
+    GSVST_TRACE_SCOPE("PresetsHandler::addSoundFontPresets");
+
+    std::set<std::pair<int, int>> presetIds;
+    for (auto* preset : set.m_presets)
+        presetIds.emplace(preset->bankid, preset->programid);
+
+    const auto& soundfont = *set.m_soundfont;
+
+    for (uint32_t i = 0; i < soundfont.numPresets; i++)
+    {
+        const auto& preset = soundfont.presets[i];
+
+        if (!presetIds.emplace(preset.bankId, preset.programId).second)
+            continue; // Don't add presets if there's already a Sample or Synth version of it
+
+        const auto* foundFriendlyName = set.findProgramInfo(preset.bankId, preset.programId);
+        if (settings.bHideUnknownInstruments && !foundFriendlyName)
+            continue;
+
+        {
+            std::string friendlyName = (foundFriendlyName ? foundFriendlyName->name : "");
+            auto* newPreset = buildSoundfontPreset(soundfont, settings, preset, friendlyName);
+            assert(newPreset);
+            if (newPreset)
+            {
+                set.m_presets.push_back(newPreset);
+            }
+        }
+    }
+}
+
+Preset* PresetsHandler::buildSoundfontPreset(const SoundfontData& soundfont, const PresetSettings& settings,
+    const CompiledPreset& preset, const std::string& friendlyName) const
+{
+    Preset* newPreset = nullptr;
+
+    if (preset.synth == ECompiledSynth::GS && settings.bAutoReplaceGSSynths)
+    {
+        newPreset = buildCustomSynthPreset(static_cast<unsigned short>(preset.programId), soundfont.getName(preset.synthNameOffset), preset.synthADSR);
+    }
+    else if (preset.synth == ECompiledSynth::GB && settings.bAutoReplaceGBSynths)
+    {
+        newPreset = new SquareSynthPreset(preset.bankId, preset.programId, std::string(soundfont.getName(preset.synthNameOffset)),
+            ADSR(preset.synthADSR), static_cast<WaveDuty>(preset.dutyCycle));
+    }
+
+    if (!newPreset)
+    {
+        std::vector<SoundfontSampleInfo> samples;
+        samples.reserve(preset.numRegions);
+
+        for (uint32_t j = 0; j < preset.numRegions; j++)
+        {
+            const auto& region = soundfont.regions[preset.firstRegion + j];
+
+            auto sampleInfo = SoundfontSampleInfo(region.bFixed, region.sampleRate, region.bLoopEnabled, region.loopStart, region.loopEnd);
+            sampleInfo.midCfreq = region.midCfreq;
+            sampleInfo.adsr = region.adsr;
+            sampleInfo.offset = region.sampleOffset;
+            sampleInfo.format = region.format;
+            sampleInfo.bGuarded = region.bGuarded;
+            sampleInfo.keyRange = { region.loKey, region.hiKey };
+            sampleInfo.velocityRange = { region.loVelocity, region.hiVelocity };
+            sampleInfo.rhythmPan = region.rhythmPan;
+            sampleInfo.notePitch = region.notePitch;
+
+            samples.push_back(sampleInfo);
+        }
+
+        const auto& label = !friendlyName.empty() ? friendlyName : std::string(soundfont.getName(preset.nameOffset));
+        newPreset = new SoundfontPreset(preset.bankId, preset.programId, std::string(label), soundfont, std::move(samples));
+    }
+
+    return newPreset;
 }
 
 }
@@ -1,14 +1,19 @@
 #pragma once
 
 #include "Presets.h"
+#include "SoundfontCache.h"
 
 #include "Processor/Instrument.h"
+#include "Processor/RealtimeCheck.h"
 #include <string>
 #include <map>
-
-struct tsf;
-struct tsf_preset;
-struct tsf_region;
+#include <tuple>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
 namespace juce
 {
@@ -29,66 +34,153 @@ struct ProgramInfo
     bool bDisplay = true;
 };
 
+// What a preset set is built from
+struct PresetSettings
+{
+    std::string soundFontPath;
+    bool bAutoReplaceGSSynths = true;
+    bool bAutoReplaceGBSynths = true;
+    bool bHideUnknownInstruments = false;
+    bool bMappedSoundfont = false;
+    std::string selectedGame;
+};
+
+// Presets built from the settings on the loader thread. Never modified once published
+struct PresetSet
+{
+    PresetSet() = default;
+    PresetSet(const PresetSet&) = delete;
+    PresetSet& operator=(const PresetSet&) = delete;
+    ~PresetSet();
+
+    // Sorts the presets by bank and program, and indexes them for findPreset
+    void sort();
+    const Preset* findPreset(int bankId, int programId) const;
+
+    // Indexes the program info of the selected game, which outlives the set
+    void setProgramInfo(const std::list<ProgramInfo>& programInfo);
+    const ProgramInfo* findProgramInfo(int bankId, int programId) const;
+
+    static uint64_t getPresetKey(int bankId, int programId) { return (uint64_t(uint32_t(bankId)) << 32) | uint32_t(programId); }
+
+    std::vector<Preset*> m_presets;
+    std::unordered_map<uint64_t, const Preset*> m_presetIndex;
+    std::unordered_map<uint64_t, const ProgramInfo*> m_programInfoIndex;
+
+    // What the set was built from
+    PresetSettings m_settings;
+
+    // Samples of the soundfont presets, shared with the other instances using the same file (see SoundfontCache)
+    std::shared_ptr<const SoundfontData> m_soundfont;
+};
+
+/*
+ * Settings changes rebuild the presets on a loader thread, which publishes the new set with an atomic pointer.
+ * The audio thread switches to it between two blocks and acknowledges it once nothing plays from the previous
+ * set anymore, which is only freed then.
+ */
 struct PresetsHandler
 {
     PresetsHandler();
     virtual ~PresetsHandler();
 
-    void clear();
-    void sort();
+    // Waits for the loader to finish. To be called before destruction, as builds use the derived class
+    void stopLoading();
 
     const std::list<ProgramInfo>& getProgramInfo() const;
 
     typedef std::map<std::string, std::list<ProgramInfo>> ProgramList;
     virtual const ProgramList& getGamesProgramList() const { return m_emptyGameList; }
 
-    virtual void addSynthsPresets() {}
-    virtual Preset* buildCustomSynthPreset(unsigned short, const std::string&, const ADSR&) { return nullptr; }
-
+    // Reloads the soundfont if the file changed, even if the path didn't. The other settings keep it loaded
     void setSoundfont(const std::string& path);
-    void cleanupSoundfont();
+    const std::string& getSoundFontPath() const { return m_settings.soundFontPath; }
 
-    float* getSoundfontBuffer(unsigned int offset) const;
-
-    const std::string& getSoundFontPath() const { return soundFontPath; }
+    void setMappedSoundfont(bool bMapped);
+    bool getMappedSoundfont() const { return m_settings.bMappedSoundfont; }
 
     void setAutoReplaceGSSynths(bool bEnable);
-    bool getAutoReplaceGSSynths() const { return m_bAutoReplaceGSSynthsEnabled; }
+    bool getAutoReplaceGSSynths() const { return m_settings.bAutoReplaceGSSynths; }
     void setAutoReplaceGBSynths(bool bEnable);
-    bool getAutoReplaceGBSynths() const { return m_bAutoReplaceGBSynthsEnabled; }
+    bool getAutoReplaceGBSynths() const { return m_settings.bAutoReplaceGBSynths; }
     void setHideUnknownInstruments(bool bHide);
-    bool getHideUnknownInstruments() const { return m_bHideUnknownInstruments; }
+    bool getHideUnknownInstruments() const { return m_settings.bHideUnknownInstruments; }
 
     void setSelectedGame(const std::string& gameName);
-    const std::string& getSelectedGame() const { return m_selectedGame; }
+    const std::string& getSelectedGame() const { return m_settings.selectedGame; }
 
-    void clearPresetsOfType(EPresetType type);
+    // Latest published set, which can't be replaced while this is held. Not for the audio thread
+    class LockedPresetSet
+    {
+    public:
+        LockedPresetSet(const PresetsHandler& handler)
+            : m_lock(handler.m_setsMutex)
+            , m_set(*handler.m_currentSet)
+        {}
 
-    const ProgramInfo* findProgramInfo(const std::list<ProgramInfo>& list, int bankid, int programid) const;
+        const PresetSet& operator*() const { return m_set; }
+        const PresetSet* operator->() const { return &m_set; }
 
-    std::vector<Preset*> m_presets;
+    private:
+        std::lock_guard<CheckedMutex> m_lock;
+        const PresetSet& m_set;
+    };
 
-    std::string soundFontPath;
-    const tsf* soundFont = nullptr;
+    // Audio thread
+    const PresetSet* getPublishedPresetSet() const { return m_publishedSet.load(std::memory_order_acquire); }
+    void acknowledgePresetSet(const PresetSet* set) { m_acknowledgedSet.store(set, std::memory_order_release); }
 
-    bool m_bAutoReplaceGSSynthsEnabled = true;
-    bool m_bAutoReplaceGBSynthsEnabled = true;
-    bool m_bHideUnknownInstruments = false;
-    std::string m_selectedGame;
+    // True once after each new set
+    bool presetSetChanged() { return m_bPresetSetChanged.exchange(false); }
 
 protected:
-    void addSoundFontPresets();
-    Preset* buildSoundfontPreset(const tsf_preset& preset, const std::string& name, const std::string& friendlyName);
+    // Builds a set from the current settings on the loader thread
+    void requestPresetSet(bool bReloadSoundfont = false);
 
-    bool isGSSynth(int bankId, const std::string& presetName);
-    bool isGBSynth(const std::string& presetName);
-    bool isSynth(const tsf_preset& preset);
-    ADSR getSoundfontADSR(const tsf_region& region);
+    // Without soundfont, the one at the settings' path is acquired
+    std::unique_ptr<PresetSet> buildPresetSet(const PresetSettings& settings, std::shared_ptr<const SoundfontData> soundfont) const;
+    void publishPresetSet(std::unique_ptr<PresetSet> set);
+
+    virtual void addSynthsPresets(PresetSet&) const {}
+    virtual Preset* buildCustomSynthPreset(unsigned short, const std::string&, const ADSR&) const { return nullptr; }
 
     const ProgramList m_emptyGameList;
     const std::list<ProgramInfo> m_emptyList;
 
+private:
+    void addSoundFontPresets(PresetSet& set, const PresetSettings& settings) const;
+    Preset* buildSoundfontPreset(const SoundfontData& soundfont, const PresetSettings& settings,
+        const CompiledPreset& preset, const std::string& friendlyName) const;
+
+    const std::list<ProgramInfo>& getProgramInfo(const std::string& gameName) const;
+
+    // Soundfont of the current set, if it was loaded from the same file and in the same mode
+    std::shared_ptr<const SoundfontData> getLoadedSoundfont(const PresetSettings& settings) const;
+    // Frees the replaced sets once the audio thread has acknowledged the current one
+    void collectRetiredPresetSets();
+    void loaderLoop();
+
+    // Message thread
+    PresetSettings m_settings;
+
     std::unique_ptr<juce::AudioFormatManager> m_formatManager;
+
+    // Owned sets: the current one, and the replaced ones the audio thread may still use
+    mutable CheckedMutex m_setsMutex;
+    std::unique_ptr<PresetSet> m_currentSet;
+    std::vector<std::unique_ptr<PresetSet>> m_retiredSets;
+
+    std::atomic<const PresetSet*> m_publishedSet { nullptr };
+    std::atomic<const PresetSet*> m_acknowledgedSet { nullptr };
+    std::atomic<bool> m_bPresetSetChanged { false };
+
+    // Only the latest request is built
+    std::thread m_loader;
+    std::mutex m_loaderMutex;
+    std::condition_variable m_loaderWakeUp;
+    std::optional<PresetSettings> m_pendingSettings;
+    bool m_bReloadPending = false;
+    bool m_bLoaderRunning = false;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,85 @@
+#include "SoundfontCache.h"
+
+#include "Processor/RealtimeCheck.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+SoundfontData::SoundfontData() = default;
+SoundfontData::~SoundfontData() = default;
+
+const void* SoundfontData::getSamples(ESampleFormat format, unsigned int offset) const
+{
+    if (format == ESampleFormat::Int8)
+        return samples8 + offset;
+
+    return samples16 + offset;
+}
+
+void SoundfontData::useOwnedTables()
+{
+    presets = presetTable.data();
+    numPresets = static_cast<uint32_t>(presetTable.size());
+    regions = regionTable.data();
+    numRegions = static_cast<uint32_t>(regionTable.size());
+    names = nameTable.data();
+    namesSize = nameTable.size();
+
+    samples16 = guardedSamples16.data();
+    numSamples16 = guardedSamples16.size();
+    samples8 = guardedSamples8.data();
+    numSamples8 = guardedSamples8.size();
+}
+
+typedef std::tuple<std::string, int64_t, int64_t, bool> SoundfontKey;
+
+struct SoundfontRegistry
+{
+    CheckedMutex mutex;
+    std::map<SoundfontKey, std::weak_ptr<const SoundfontData>> soundfonts;
+};
+
+static SoundfontRegistry& getRegistry()
+{
+    static SoundfontRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<const SoundfontData> SoundfontCache::acquire(const std::string& path, bool bMapped, soundfont_loader loader)
+{
+    const auto file = juce::File(path).getLinkedTarget();
+    const SoundfontKey key { file.getFullPathName().toStdString(), file.getLastModificationTime().toMilliseconds(), file.getSize(), bMapped };
+
+    auto& registry = getRegistry();
+
+    // Held while loading, so instances opening the same file at once share a single load
+    std::lock_guard<CheckedMutex> lock(registry.mutex);
+
+    for (auto it = registry.soundfonts.begin(); it != registry.soundfonts.end();)
+    {
+        if (it->second.expired())
+            it = registry.soundfonts.erase(it);
+        else
+            ++it;
+    }
+
+    auto found = registry.soundfonts.find(key);
+    if (found != registry.soundfonts.end())
+    {
+        if (auto soundfont = found->second.lock())
+            return soundfont;
+    }
+
+    std::shared_ptr<const SoundfontData> soundfont = loader(path, bMapped);
+    if (soundfont)
+        registry.soundfonts[key] = soundfont;
+
+    return soundfont;
+}
+
+}
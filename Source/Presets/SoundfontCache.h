@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CompiledSoundfont.h"
+#include "Processor/Types.h"
+
+namespace juce
+{
+    class MemoryBlock;
+    class MemoryMappedFile;
+}
+
+namespace GSVST {
+
+// Compiled soundfont file. Immutable once loaded, so it can be shared by all the plugin instances
+struct SoundfontData
+{
+    SoundfontData();
+    SoundfontData(const SoundfontData&) = delete;
+    SoundfontData& operator=(const SoundfontData&) = delete;
+    ~SoundfontData();
+
+    // Sample memory of a SoundfontSampleInfo built from this soundfont
+    const void* getSamples(ESampleFormat format, unsigned int offset) const;
+
+    // Points the tables and samples below to the owned vectors
+    void useOwnedTables();
+
+    const char* getName(uint32_t nameOffset) const { return names + nameOffset; }
+
+    // Preset, region and name tables, in the owned vectors or in the cache file
+    const CompiledPreset* presets = nullptr;
+    uint32_t numPresets = 0;
+    const CompiledRegion* regions = nullptr;
+    uint32_t numRegions = 0;
+    const char* names = nullptr;
+    size_t namesSize = 0;
+
+    // Samples of every region, with guard samples after each of them (see DirectSource), except when
+    // mapped from the SF2 file. Samples holding 8 bits data are stored as int8, the others as int16
+    const int16_t* samples16 = nullptr;
+    size_t numSamples16 = 0;
+    const int8_t* samples8 = nullptr;
+    size_t numSamples8 = 0;
+
+    // Compiled when loading the SF2
+    std::vector<CompiledPreset> presetTable;
+    std::vector<CompiledRegion> regionTable;
+    std::vector<char> nameTable;
+    std::vector<int16_t> guardedSamples16;
+    std::vector<int8_t> guardedSamples8;
+
+    // Memory-mapped mode: the cache file, or the SF2 file if it can't be cached
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    // Cache file read in memory
+    std::unique_ptr<juce::MemoryBlock> fileData;
+};
+
+/*
+ * Process-wide registry of the loaded soundfonts, keyed by canonical path, modification time, size
+ * and loading mode. A soundfont stays loaded as long as an instance holds it, and is reloaded if the file changes.
+ */
+class SoundfontCache
+{
+public:
+    typedef std::unique_ptr<SoundfontData> (*soundfont_loader)(const std::string& path, bool bMapped);
+
+    // Returns the soundfont at path, loaded with loader if no instance holds it yet. nullptr if loading fails
+    static std::shared_ptr<const SoundfontData> acquire(const std::string& path, bool bMapped, soundfont_loader loader);
+};
+
+}
@@ -0,0 +1,66 @@
+#include "AudioBus.h"
+#include "DSPKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+size_t AudioBus::getPaddedSize(size_t numSamples)
+{
+    return (numSamples + AUDIO_BUS_ALIGNMENT - 1) / AUDIO_BUS_ALIGNMENT * AUDIO_BUS_ALIGNMENT;
+}
+
+void AudioBus::resize(size_t numSamples)
+{
+    m_numSamples = numSamples;
+    m_stride = getPaddedSize(numSamples);
+
+    // Extra room to move the start to an aligned address
+    m_storage.assign(m_stride * 2 + AUDIO_BUS_ALIGNMENT, 0.0f);
+
+    const auto address = reinterpret_cast<uintptr_t>(m_storage.data());
+    const uintptr_t alignment = AUDIO_BUS_ALIGNMENT * sizeof(float);
+    const auto misalignment = (alignment - address % alignment) % alignment;
+    m_left = m_storage.data() + misalignment / sizeof(float);
+}
+
+void AudioBus::clear()
+{
+    std::fill(m_storage.begin(), m_storage.end(), 0.0f);
+}
+
+void AudioBus::addTo(juce::AudioBuffer<float>& buffer, size_t numSamples) const
+{
+    const auto numHostSamples = static_cast<int>(numSamples);
+    juce::FloatVectorOperations::add(buffer.getWritePointer(0), getLeft(), numHostSamples);
+    if (buffer.getNumChannels() > 1)
+        juce::FloatVectorOperations::add(buffer.getWritePointer(1), getRight(), numHostSamples);
+}
+
+void AudioBus::addTo(juce::AudioBuffer<float>& buffer, size_t numSamples, BusLevels& out_levels) const
+{
+    out_levels = BusLevels();
+    if (numSamples == 0)
+        return;
+
+    const auto& kernels = getDSPKernels();
+    float sumSquares[2] = { 0.0f, 0.0f };
+
+    kernels.mixMeasure(buffer.getWritePointer(0), getLeft(), numSamples, out_levels.peak[0], sumSquares[0]);
+    if (buffer.getNumChannels() > 1)
+        kernels.mixMeasure(buffer.getWritePointer(1), getRight(), numSamples, out_levels.peak[1], sumSquares[1]);
+    else
+    {
+        out_levels.peak[1] = out_levels.peak[0];
+        sumSquares[1] = sumSquares[0];
+    }
+
+    for (int side = 0; side < 2; side++)
+        out_levels.rms[side] = std::sqrt(sumSquares[side] / static_cast<float>(numSamples));
+}
+
+}
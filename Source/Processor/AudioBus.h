@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Types.h"
+
+namespace juce
+{
+    template <typename Type> class AudioBuffer;
+}
+
+namespace GSVST {
+
+// Peak and RMS of each side of a bus, left then right
+struct BusLevels
+{
+    float peak[2] = { 0.0f, 0.0f };
+    float rms[2] = { 0.0f, 0.0f };
+};
+
+// Buses are aligned and padded to this many floats (AVX register width)
+#define AUDIO_BUS_ALIGNMENT 8
+
+/*
+ * Planar stereo buffer: left and right samples in two separate float arrays.
+ * Both arrays start on an AUDIO_BUS_ALIGNMENT boundary and are padded to a multiple of it,
+ * so the mixing loops can run whole SIMD vectors.
+ */
+class AudioBus
+{
+public:
+    static size_t getPaddedSize(size_t numSamples);
+
+    void resize(size_t numSamples);
+    void clear();
+
+    size_t size() const { return m_numSamples; }
+    size_t getStride() const { return m_stride; }
+
+    float* getLeft() { return m_left; }
+    float* getRight() { return m_left + m_stride; }
+    const float* getLeft() const { return m_left; }
+    const float* getRight() const { return m_left + m_stride; }
+
+    StereoBuffer getBuffer(size_t offset = 0) { return { getLeft() + offset, getRight() + offset }; }
+
+    // Adds the first numSamples to the host buffer (left side only for a mono host)
+    void addTo(juce::AudioBuffer<float>& buffer, size_t numSamples) const;
+    // Same, measuring the samples on the way. A mono host gets the left side, which is then measured for both
+    void addTo(juce::AudioBuffer<float>& buffer, size_t numSamples, BusLevels& out_levels) const;
+
+private:
+    std::vector<float> m_storage;
+    float* m_left = nullptr;
+    size_t m_numSamples = 0;
+    size_t m_stride = 0;
+};
+
+}
@@ -5,6 +5,8 @@
 #include <algorithm>
 
 #include "CGBPatterns.h"
+#include "VoicePool.h"
+#include "DSPKernels.h"
 
 namespace GSVST {
 
@@ -235,7 +237,7 @@ void CGBChannel::applyVol()
  * public SquareChannel
  */
 
-SquareChannel::SquareChannel(WaveDuty wd, const Note& in_note, uint8_t sweep)
+SquareChannel::SquareChannel(WaveDuty wd, const Note& in_note, uint8_t sweep, VoicePool& pool)
     : CGBChannel(in_note)
       , sweep(sweep)
       , sweepEnabled(isSweepEnabled(sweep))
@@ -250,7 +252,7 @@ SquareChannel::SquareChannel(WaveDuty wd, const Note& in_note, uint8_t sweep)
     };
 
     this->pat = patterns[static_cast<int>(wd)];
-    this->rs = std::make_unique<BlepResampler>();
+    this->rs = pool.acquireBlepResampler();
 }
 
 void SquareChannel::updatePitch()
@@ -291,7 +293,7 @@ void SquareChannel::updateArgs(const MixingArgs& args)
     }
 }
 
-void SquareChannel::process(sample* buffer, size_t numSamples, const MixingArgs& args)
+void SquareChannel::process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
 {
     if (!cargs.bInitialized)
     {
@@ -300,23 +302,22 @@ void SquareChannel::process(sample* buffer, size_t numSamples, const MixingArgs&
         cargs.bInitialized = true;
     }
 
-    sample* outBuffer = new sample[numSamples];
+    assert(args.scratchBuffer && args.scratchSize > 0);
 
-    rs->Process(outBuffer, numSamples, cargs.interStep, sampleFetchCallback, this);
+    const auto& kernels = getDSPKernels();
 
     size_t i = 0;
-    do {
-        processStart(args, i, numSamples);
 
-        buffer->left  += outBuffer[i].left * cargs.lVol;
-        buffer->right += outBuffer[i].right * cargs.rVol;
-        buffer++;
-        i++;
-        cargs.lVol += cargs.lVolStep;
-        cargs.rVol += cargs.rVolStep;
+    while (numSamples > 0)
+    {
+        size_t samplesToProcess = std::min(numSamples, args.scratchSize);
+        numSamples -= samplesToProcess;
 
-        processEnd(args, i);
-    } while (--numSamples > 0);
+        StereoBuffer outBuffer = args.scratchBuffer;
+        rs->Process(outBuffer, samplesToProcess, cargs.interStep, sampleFetchCallback, this);
+
+        mixOutput(buffer, outBuffer, samplesToProcess, i, args, kernels);
+    }
 
     if (sweepEnabled) {
         assert(sweepStartCount >= 0);
@@ -332,24 +333,20 @@ void SquareChannel::process(sample* buffer, size_t numSamples, const MixingArgs&
                 sweepStartCount = 0;
         }
     }
-
-    delete[] outBuffer;
 }
 
-bool SquareChannel::sampleFetchCallback(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata)
+bool SquareChannel::sampleFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata)
 {
     if (fetchBuffer.size() >= samplesRequired)
         return true;
     SquareChannel *_this = static_cast<SquareChannel *>(cbdata);
     size_t samplesToFetch = samplesRequired - fetchBuffer.size();
-    size_t i = fetchBuffer.size();
-    fetchBuffer.resize(samplesRequired);
 
     do {
-        fetchBuffer[i].left = fetchBuffer[i].right = _this->pat[_this->pos];
+        const float value = _this->pat[_this->pos];
+        fetchBuffer.push(value, value);
         _this->pos++;
         _this->pos %= 8;
-        i++;
     } while (--samplesToFetch > 0);
     return true;
 }
@@ -8,6 +8,7 @@
 
 #include "Types.h"
 #include "Resampler.h"
+#include "ObjectPool.h"
 
 #define INVALID_TRACK_IDX 0xFF
 
@@ -35,7 +36,7 @@ protected:
     static float timer2freq(float timer);
     static float freq2timer(float freq);
 
-    std::unique_ptr<Resampler> rs;
+    PooledPtr<Resampler> rs;
     enum class Pan { LEFT, CENTER, RIGHT };
     uint32_t pos = 0;
     const bool useStairstep;
@@ -50,20 +51,20 @@ protected:
     Pan panPrev = Pan::CENTER;
 };
 
-class SquareChannel : public CGBChannel
+class SquareChannel final : public CGBChannel
 {
 public:
-    SquareChannel(WaveDuty wd, const Note& in_note, uint8_t sweep);
+    SquareChannel(WaveDuty wd, const Note& in_note, uint8_t sweep, VoicePool& pool);
 
     EDSPType getType() const final { return EDSPType::Square; }
     int getMidCFreq() const override { return 3520; }
 
     void updatePitch() override;
 
-    void process(sample* buffer, size_t numSamples, const MixingArgs& args) override;
+    void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) override;
     void updateArgs(const MixingArgs& args) override;
 private:
-    static bool sampleFetchCallback(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata);
+    static bool sampleFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata);
 
     static bool isSweepEnabled(uint8_t sweep);
     static bool isSweepAscending(uint8_t sweep);
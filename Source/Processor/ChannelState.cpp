@@ -1,12 +1,14 @@
 #include "ChannelState.h"
 
 #include "ReverbEffect.h"
-#include "GS/GSReverb.h"
+#include "SharedReverb.h"
 #include "Instrument.h"
+#include "VoicePool.h"
 
 #include "Presets/PresetsHandler.h"
 #include "Presets/Presets.h"
 #include "RPNHandler.h"
+#include "Trace.h"
 
 
 namespace GSVST {
@@ -14,21 +16,25 @@ namespace GSVST {
 template<typename F>
 void ForAllPlayingInstruments(ChannelState* chan, F func)
 {
-    for (auto* soundChannel : chan->getPlayingInstruments())
+    for (auto& voice : chan->getPlayingInstruments())
     {
+        auto* soundChannel = voice.instr;
         if (!soundChannel->isDead() && !soundChannel->isStopping())
             func(soundChannel);
     }
 }
 
-ChannelState::ChannelState()
+ChannelState::ChannelState(VoicePool& in_voicePool)
+    : m_voicePool(in_voicePool)
 {
+    m_playingInstruments.reserve(MAX_VOICES_PER_CHANNEL);
+    m_newInstruments.reserve(MAX_VOICES_PER_CHANNEL);
     m_rpnHanlder.reset(new RPNHandler());
 }
 
 ChannelState::~ChannelState()
 {
-    outputBuffers.clear();
+    cleanup();
 }
 
 void ChannelState::init(double in_sampleRate, int in_samplesPerBlock, int in_samplesPerBlockComputation)
@@ -47,6 +53,20 @@ void ChannelState::init(double in_sampleRate, int in_samplesPerBlock, int in_sam
     }
 }
 
+void ChannelState::setScratchBuffer(StereoBuffer in_buffer, size_t in_size)
+{
+    m_scratchBuffer = in_buffer;
+    m_scratchSize = in_size;
+}
+
+MixingArgs ChannelState::getChannelArgs(const MixingArgs& args) const
+{
+    MixingArgs channelArgs = args;
+    channelArgs.scratchBuffer = m_scratchBuffer;
+    channelArgs.scratchSize = m_scratchSize;
+    return channelArgs;
+}
+
 bool ChannelState::isActive() const
 {
     return !m_playingInstruments.empty();
@@ -54,21 +74,26 @@ bool ChannelState::isActive() const
 
 void ChannelState::cleanup()
 {
-    for (auto* instr : m_playingInstruments)
-        delete instr;
+    for (auto& voice : m_playingInstruments)
+        m_voicePool.destroyVoice(voice.instr);
 
     m_playingInstruments.clear();
+    m_newInstruments.clear();
 }
 
 void ChannelState::process(size_t numSamples, const MixingArgs& margs)
 {
+    GSVST_TRACE_SCOPE("ChannelState::process");
+
     if (isActive())
     {
-        zeroBuffers(outputBuffers);
+        outputBuffers.clear();
+
+        const auto channelArgs = getChannelArgs(margs);
 
-        for (auto* instr : m_playingInstruments)
+        for (auto& voice : m_playingInstruments)
         {
-            instr->processCommon(outputBuffers.data(), numSamples, margs);
+            voice.instr->processCommon(outputBuffers.getBuffer(), numSamples, channelArgs);
         }
     }
 
@@ -79,19 +104,47 @@ void ChannelState::process(size_t numSamples, const MixingArgs& margs)
     pendingVolChanges.clear();
 }
 
-void ChannelState::processReverb(size_t numSamples, size_t samplesPerBufferForComputation, juce::AudioBuffer<float>& buffer)
+void ChannelState::addNewInstrument(Instrument* instr, size_t offset)
+{
+    m_newInstruments.push_back({ instr, offset });
+}
+
+void ChannelState::processNewInstruments(size_t numSamples, const MixingArgs& margs)
+{
+    for (const auto& newVoice : m_newInstruments)
+    {
+        newVoice.instr->processCommon(outputBuffers.getBuffer(newVoice.offset), numSamples - newVoice.offset, getChannelArgs(margs));
+    }
+
+    m_newInstruments.clear();
+}
+
+void ChannelState::processReverb(size_t numSamples, size_t samplesPerBufferForComputation, bool bSharedReverb)
+{
+    GSVST_TRACE_SCOPE("ChannelState::processReverb");
+
+    if (isActive() && revdsp && !bSharedReverb)
+        revdsp->ProcessData(outputBuffers.getBuffer(), numSamples, samplesPerBufferForComputation);
+}
+
+void ChannelState::mixTo(size_t numSamples, juce::AudioBuffer<float>& buffer, SharedReverb* sharedReverb)
 {
+    BusLevels levels;
+
     if (isActive())
     {
-        if (revdsp)
-            revdsp->ProcessData(outputBuffers.data(), numSamples, samplesPerBufferForComputation);
+        if (revdsp && sharedReverb)
+            sharedReverb->addSend(reverbType, outputBuffers, revdsp->GetIntensity(), numSamples);
 
-        for (auto iSample = 0; iSample < numSamples; iSample++)
-        {
-            auto& sample = outputBuffers[iSample];
-            buffer.addSample(0, iSample, sample.left);
-            buffer.addSample(1, iSample, sample.right);
-        }
+        outputBuffers.addTo(buffer, numSamples, levels);
+    }
+
+    for (int side = 0; side < 2; side++)
+    {
+        m_rmsLevels[side].store(levels.rms[side], std::memory_order_relaxed);
+
+        auto peak = m_peakLevels[side].load(std::memory_order_relaxed);
+        while (levels.peak[side] > peak && !m_peakLevels[side].compare_exchange_weak(peak, levels.peak[side], std::memory_order_relaxed)) {}
     }
 }
 
@@ -99,43 +152,74 @@ void ChannelState::killAllPlayingInstruments()
 {
     if (isActive())
     {
-        for (auto* soundChannel : m_playingInstruments)
-            soundChannel->kill();
+        for (auto& voice : m_playingInstruments)
+            voice.instr->kill();
     }
 }
 
 void ChannelState::cleanupDeadInstruments()
 {
-    auto it = m_playingInstruments.begin();
-    while (it != m_playingInstruments.end())
+    size_t i = 0;
+    while (i < m_playingInstruments.size())
     {
-        auto* instr = (*it);
+        auto* instr = m_playingInstruments[i].instr;
         if (instr->isDead())
         {
-            delete instr;
-            it = m_playingInstruments.erase(it);
+            m_voicePool.destroyVoice(instr);
+
+            // Swap and pop: order is tracked by the voice serial
+            m_playingInstruments[i] = m_playingInstruments.back();
+            m_playingInstruments.pop_back();
         }
         else
-            it++;
+            i++;
     }
 }
 
-void ChannelState::allocateIfNecessary(int numSamples)
+void ChannelState::stealOldestVoice()
 {
-    if (!isActive())
+    size_t oldest = 0;
+    for (size_t i = 1; i < m_playingInstruments.size(); i++)
+    {
+        if (m_playingInstruments[i].serial < m_playingInstruments[oldest].serial)
+            oldest = i;
+    }
+
+    stealVoice(m_playingInstruments[oldest].instr);
+}
+
+void ChannelState::stealVoice(Instrument* instr)
+{
+    // Started in this block, it isn't rendered yet
+    for (auto it = m_newInstruments.begin(); it != m_newInstruments.end(); ++it)
     {
-        zeroBuffers(outputBuffers);
+        if (it->instr == instr)
+        {
+            m_newInstruments.erase(it);
+            break;
+        }
     }
 
+    for (size_t i = 0; i < m_playingInstruments.size(); i++)
+    {
+        if (m_playingInstruments[i].instr == instr)
+        {
+            m_voicePool.destroyVoice(instr);
+            m_playingInstruments[i] = m_playingInstruments.back();
+            m_playingInstruments.pop_back();
+            m_numStolenVoices++;
+            break;
+        }
+    }
 }
 
-void ChannelState::zeroBuffers(std::vector<sample>& io_buffers)
+void ChannelState::allocateIfNecessary(int numSamples)
 {
-    for (auto& sample : io_buffers)
+    if (!isActive())
     {
-        sample.left = 0.0f;
-        sample.right = 0.0f;
+        outputBuffers.clear();
     }
+
 }
 
 void ChannelState::setBPM(int in_bpm)
@@ -156,41 +240,20 @@ void ChannelState::setReverbType(EReverbType type)
     if (reverbType != type)
     {
         reverbType = type;
-        allocateReverb();
+
+        // Starts from a clean buffer, as a newly created reverb
+        revdsp = m_reverbs[static_cast<size_t>(reverbType)].get();
+        if (revdsp)
+            revdsp->Reset();
     }
 }
 
 void ChannelState::allocateReverb()
 {
-    const uint8_t reverbIntensity = 79;
-    const auto revBufSize = 0x630;
-    const auto maxFixedModeRate = 31536;
-
-    revdsp.reset();
-
-    switch (reverbType)
-    {
-    case EReverbType::None:
-        break;
-    case EReverbType::Default:
-        revdsp = std::make_unique<ReverbEffect>(
-            reverbIntensity, m_samplesPerBlockComputation, uint8_t(revBufSize / (maxFixedModeRate / AGB_FPS)));
-        break;
-    case EReverbType::GS1:
-        revdsp = std::make_unique<ReverbGS1>(
-            reverbIntensity, m_samplesPerBlockComputation, uint8_t(revBufSize / (maxFixedModeRate / AGB_FPS)));
-        break;
-    case EReverbType::GS2:
-        revdsp = std::make_unique<ReverbGS2>(
-            reverbIntensity, m_samplesPerBlockComputation, uint8_t(revBufSize / (maxFixedModeRate / AGB_FPS)),
-            0.4140625f, -0.0625f);
-        break;
-    case EReverbType::MGAT:
-        revdsp = std::make_unique<ReverbGS2>(
-            reverbIntensity, m_samplesPerBlockComputation, uint8_t(revBufSize / (maxFixedModeRate / AGB_FPS)),
-            0.25f, -0.046875f);
-        break;
-    }
+    for (size_t i = 0; i < m_reverbs.size(); i++)
+        m_reverbs[i] = createReverbEffect(static_cast<EReverbType>(i), m_samplesPerBlockComputation);
+
+    revdsp = m_reverbs[static_cast<size_t>(reverbType)].get();
 }
 
 void ChannelState::setReverbLevel(int val)
@@ -219,7 +282,8 @@ void ChannelState::setVolume(int val)
 void ChannelState::addPendingVolChange(int timestamp, int volume)
 {
     auto linearizedVolume = getLinearizedValue(volume);
-    pendingVolChanges.emplace_back(timestamp, linearizedVolume);
+    if (!pendingVolChanges.emplace_back(timestamp, linearizedVolume))
+        pendingVolChanges.back() = VolChange(timestamp, linearizedVolume);
 
     ForAllPlayingInstruments(this, [&](auto* soundChannel)
     {
@@ -229,17 +293,28 @@ void ChannelState::addPendingVolChange(int timestamp, int volume)
 
 void ChannelState::addPendingNoteOff(int timestamp, int note)
 {
-    for (auto* soundChannel : m_playingInstruments)
+    // Oldest matching voice gets the note off
+    Instrument* target = nullptr;
+    uint32_t targetSerial = 0;
+
+    for (auto& voice : m_playingInstruments)
     {
-        if (!soundChannel->isDead() && !soundChannel->isStopping())
+        if (voice.midiNote != note)
+            continue;
+
+        auto* soundChannel = voice.instr;
+        if (!soundChannel->isDead() && !soundChannel->isStopping() && !soundChannel->hasPendingNoteOff())
         {
-            if (soundChannel->getMidiNote() == note && !soundChannel->hasPendingNoteOff())
+            if (!target || voice.serial < targetSerial)
             {
-                soundChannel->addPendingNoteOff(timestamp);
-                break;
+                target = soundChannel;
+                targetSerial = voice.serial;
             }
         }
     }
+
+    if (target)
+        target->addPendingNoteOff(timestamp);
 }
 
 int ChannelState::getPan() const
@@ -260,29 +335,46 @@ void ChannelState::setPan(int val)
     });
 }
 
-void ChannelState::setPreset(int bankId, int programId, const PresetsHandler& presets)
+void ChannelState::setPreset(int bankId, int programId, const PresetSet& presets)
 {
-    for (auto* preset : presets.m_presets)
+    if (auto* preset = presets.findPreset(bankId, programId))
     {
-        if (preset->bankid == bankId && preset->programid == programId)
-        {
-            m_preset = preset;
-            m_envelope = ADSR(preset->getADSR());
-            m_type = m_preset->getDSPType();
-            m_preset->getPWMData(m_pwmData);
-            break;
-        }
+        setCurrentPreset(preset);
+        m_envelope = ADSR(preset->getADSR());
+        m_type = m_preset->getDSPType();
+        m_preset->getPWMData(m_pwmData);
     }
 }
 
 void ChannelState::resetPreset()
 {
-    m_preset = nullptr;
+    setCurrentPreset(nullptr);
+}
+
+void ChannelState::remapPreset(const PresetSet& presets)
+{
+    if (!m_preset)
+        return;
+
+    auto* preset = presets.findPreset(m_preset->bankid, m_preset->programid);
+    if (!preset)
+        resetPreset();
+    else if (preset->getDSPType() == m_type)
+        setCurrentPreset(preset);
+    else
+        setPreset(preset->bankid, preset->programid, presets);
+}
+
+void ChannelState::setCurrentPreset(const Preset* preset)
+{
+    m_preset = preset;
+    m_publishedPreset = preset ? (uint32_t(preset->bankid & 0xFFFF) << 16) | uint32_t(preset->programid + 1) : 0;
 }
 
 std::pair<int, int> ChannelState::getCurrentPreset() const
 {
-    return m_preset ? std::make_pair(m_preset->bankid, m_preset->programid) : std::make_pair(0, -1);
+    const uint32_t published = m_publishedPreset.load(std::memory_order_relaxed);
+    return std::make_pair(int(published >> 16), int(published & 0xFFFF) - 1);
 }
 
 void ChannelState::updateADSR(const ADSR& in_adsr)
@@ -308,8 +400,40 @@ void ChannelState::updatePWMData(const PWMData& in_data)
     });
 }
 
+bool ChannelState::applyCommand(const ChannelCommand& command, const PresetSet& presets)
+{
+    const auto value = static_cast<uint8_t>(command.value);
+    auto adsr = m_envelope;
+    auto pwmData = m_pwmData;
+
+    switch (command.type)
+    {
+    case EChannelCommand::SetPreset:
+        setPreset(command.bankId, command.programId, presets);
+        return true;
+    case EChannelCommand::SetReverbType:
+        setReverbType(static_cast<EReverbType>(command.value));
+        return true;
+    case EChannelCommand::SetVolume:      setVolume(command.value); break;
+    case EChannelCommand::SetPan:         setPan(command.value); break;
+    case EChannelCommand::SetReverbLevel: setReverbLevel(command.value); break;
+    case EChannelCommand::SetAttack:   adsr.att = value; updateADSR(adsr); break;
+    case EChannelCommand::SetDecay:    adsr.dec = value; updateADSR(adsr); break;
+    case EChannelCommand::SetSustain:  adsr.sus = value; updateADSR(adsr); break;
+    case EChannelCommand::SetRelease:  adsr.rel = value; updateADSR(adsr); break;
+    case EChannelCommand::SetInitDuty: pwmData.initDuty = value; updatePWMData(pwmData); break;
+    case EChannelCommand::SetDutyBase: pwmData.dutyBase = value; updatePWMData(pwmData); break;
+    case EChannelCommand::SetDutyStep: pwmData.dutyStep = value; updatePWMData(pwmData); break;
+    case EChannelCommand::SetDepth:    pwmData.depth = value; updatePWMData(pwmData); break;
+    }
+
+    return false;
+}
+
 Instrument* ChannelState::handleNoteOn(uint8_t noteNumber, int8_t velocity, int noteOffset, int bpm)
 {
+    GSVST_TRACE_SCOPE("ChannelState::handleNoteOn");
+
     if (!m_preset)
         return nullptr;
 
@@ -317,6 +441,7 @@ Instrument* ChannelState::handleNoteOn(uint8_t noteNumber, int8_t velocity, int
     note.midiKeyTrackData = noteNumber;
     note.midiKeyPitch = noteNumber;
     note.velocity = getLinearizedValue(velocity);
+    note.midiVelocity = static_cast<uint8_t>(velocity);
 
     bool bIsDrumMap = m_preset->isDrumMap();
     if (bIsDrumMap)
@@ -324,7 +449,10 @@ Instrument* ChannelState::handleNoteOn(uint8_t noteNumber, int8_t velocity, int
         note.midiKeyPitch = noteNumber;
     }
 
-    Instrument* newInstance = m_preset->createPlayingInstance(note);
+    if (m_playingInstruments.size() >= MAX_VOICES_PER_CHANNEL)
+        stealOldestVoice();
+
+    Instrument* newInstance = m_preset->createPlayingInstance(note, m_voicePool);
 
     if (newInstance)
     {
@@ -377,7 +505,11 @@ Instrument* ChannelState::handleNoteOn(uint8_t noteNumber, int8_t velocity, int
 
         newInstance->updatePWMData(m_pwmData);
 
-        m_playingInstruments.push_back(newInstance);
+        PlayingVoice voice;
+        voice.instr = newInstance;
+        voice.serial = m_voicePool.getNextSerial();
+        voice.midiNote = newInstance->getMidiNote();
+        m_playingInstruments.push_back(voice);
     }
 
     return newInstance;
@@ -385,16 +517,18 @@ Instrument* ChannelState::handleNoteOn(uint8_t noteNumber, int8_t velocity, int
 
 void ChannelState::allNotesOff()
 {
-    for (auto* soundChannel : m_playingInstruments)
+    for (auto& voice : m_playingInstruments)
     {
-        soundChannel->release();
+        voice.instr->release();
     }
 
     m_rpnHanlder->resetAllRPNs(); // just to be safe
 }
 
-bool ChannelState::handleMidiMsg(const juce::MidiMessage& msg, const PresetsHandler& presets, bool bIgnorePrgChg, bool bIsPlaying)
+bool ChannelState::handleMidiMsg(const juce::MidiMessage& msg, const PresetSet& presets, bool bIgnorePrgChg, bool bIsPlaying)
 {
+    GSVST_TRACE_SCOPE("ChannelState::handleMidiMsg");
+
     bool bRefreshRequired = false;
 
     if (msg.isControllerOfType(0)) // Bank change
@@ -518,20 +652,16 @@ bool ChannelState::handleMidiMsg(const juce::MidiMessage& msg, const PresetsHand
     return bRefreshRequired;
 }
 
-float ChannelState::getAverageLevel() const
+BusLevels ChannelState::readLevels()
 {
-    if (outputBuffers.size() > 0)
+    BusLevels levels;
+    for (int side = 0; side < 2; side++)
     {
-        auto result = std::accumulate(outputBuffers.begin(), outputBuffers.end(), 0.0f,
-            [](float total, sample elem)
-            {
-                return total + elem.left * elem.left;
-            });
-
-        return std::sqrt(result / static_cast<float>(outputBuffers.size()));
+        levels.peak[side] = m_peakLevels[side].exchange(0.0f, std::memory_order_relaxed);
+        levels.rms[side] = m_rmsLevels[side].load(std::memory_order_relaxed);
     }
 
-    return 0.0f;
+    return levels;
 }
 
 int16_t ChannelState::getDetune() const
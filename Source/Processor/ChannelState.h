@@ -1,30 +1,87 @@
 #pragma once
 
 #include "Types.h"
+#include "AudioBus.h"
+#include "FixedVector.h"
 
 #include <JuceHeader.h>
 
+#include <array>
+#include <atomic>
+
 namespace GSVST {
 
 class ReverbEffect;
+class SharedReverb;
 class Instrument;
+class VoicePool;
 
 class Preset;
-struct PresetsHandler;
+struct PresetSet;
 struct RPNHandler;
 enum class EDSPType : uint8_t;
 
+enum class EChannelCommand : uint8_t
+{
+    SetPreset,
+    SetVolume,
+    SetPan,
+    SetReverbLevel,
+    SetReverbType,
+    SetAttack,
+    SetDecay,
+    SetSustain,
+    SetRelease,
+    SetInitDuty,
+    SetDutyBase,
+    SetDutyStep,
+    SetDepth
+};
+
+// Change made in the editor, applied by the audio thread between two blocks (see Processor::pushChannelCommand)
+struct ChannelCommand
+{
+    EChannelCommand type = EChannelCommand::SetVolume;
+    int midiChannel = 0; // -1 for all the channels
+    int value = 0;
+    int bankId = 0; // SetPreset only, with programId
+    int programId = 0;
+};
+
+// Seconds spent on a channel in the current block, measured by the thread rendering it
+struct ChannelTimes
+{
+    double render = 0.0;
+    double reverb = 0.0;
+};
+
+// Entry of the channel's voice table. The serial keeps the note-on order, which swap-and-pop removal doesn't preserve
+struct PlayingVoice
+{
+    Instrument* instr = nullptr;
+    uint32_t serial = 0;
+    uint8_t midiNote = 0;
+};
+
 struct ChannelState
 {
 public:
-    ChannelState();
+    ChannelState(VoicePool& in_voicePool);
     ~ChannelState();
 
     void init(double in_sampleRate, int in_samplesPerBlock, int in_samplesPerBlockComputation);
+    void setScratchBuffer(StereoBuffer in_buffer, size_t in_size);
     void cleanup();
 
+    // Only touches the channel and its voices: the channels can be processed in parallel, up to mixTo
     void process(size_t numSamples, const MixingArgs& args);
-    void processReverb(size_t numSamples, size_t samplesPerBufferForComputation, juce::AudioBuffer<float>& buffer);
+    void addNewInstrument(Instrument* instr, size_t offset);
+    // Renders the voices added since the last call from their note-on offset, in note-on order
+    void processNewInstruments(size_t numSamples, const MixingArgs& args);
+    void processReverb(size_t numSamples, size_t samplesPerBufferForComputation, bool bSharedReverb);
+
+    // Adds the output to buffer. With a shared reverb, it's also sent to it instead of the channel's own reverb
+    void mixTo(size_t numSamples, juce::AudioBuffer<float>& buffer, SharedReverb* sharedReverb);
 
     void killAllPlayingInstruments();
     void cleanupDeadInstruments();
@@ -52,8 +109,11 @@ public:
     void setReverbLevel(int val);
     int getReverbLevel() const { return reverbLevel; }
 
-    void setPreset(int bankId, int programId, const PresetsHandler& presets);
+    void setPreset(int bankId, int programId, const PresetSet& presets);
     void resetPreset();
+    // Same program in a rebuilt preset set, the channel settings are kept if the instrument type didn't change
+    void remapPreset(const PresetSet& presets);
+    // Bank and program of the channel, (0, -1) if none. Any thread: the preset itself belongs to the audio thread
     std::pair<int, int> getCurrentPreset() const;
 
     void updateADSR(const ADSR& in_adsr);
@@ -62,13 +122,17 @@ public:
     void updatePWMData(const PWMData& in_data);
     const PWMData& getPWMData() const { return m_pwmData; }
 
+    // Audio thread. True if the editor has to be refreshed
+    bool applyCommand(const ChannelCommand& command, const PresetSet& presets);
+
     Instrument* handleNoteOn(uint8_t noteNumber, int8_t velocity, int noteOffset, int bpm);
-    bool handleMidiMsg(const juce::MidiMessage& msg, const PresetsHandler& presets, bool bIgnorePrgChg, bool bIsPlaying);
+    bool handleMidiMsg(const juce::MidiMessage& msg, const PresetSet& presets, bool bIgnorePrgChg, bool bIsPlaying);
     void allNotesOff();
 
-    std::vector<sample>& getOutBuffer() { return outputBuffers; }
+    const AudioBus& getOutBuffer() const { return outputBuffers; }
 
-    float getAverageLevel() const;
+    // Levels of the last mixed block, the peaks being the highest since the last call. Message thread
+    BusLevels readLevels();
 
     int16_t getDetune() const;
     int16_t getPitchBendRange() const;
@@ -76,12 +140,22 @@ public:
     ELfoType getLfoType() const;
     void resetAllRPNs();
 
-    const std::list<Instrument*>& getPlayingInstruments() const { return m_playingInstruments; }
+    const std::vector<PlayingVoice>& getPlayingInstruments() const { return m_playingInstruments; }
+    bool hasPreset() const { return m_preset != nullptr; }
+    // Kills the voice right away, to make room for a new one
+    void stealVoice(Instrument* instr);
+    // Since the channel was created
+    uint64_t getNumStolenVoices() const { return m_numStolenVoices; }
+
+    ChannelTimes& getTimes() { return m_times; }
 
 private:
-    static void zeroBuffers(std::vector<sample>& io_buffers);
+    MixingArgs getChannelArgs(const MixingArgs& args) const;
 
     void allocateReverb();
+    // To keep the voice table within its reserved capacity
+    void stealOldestVoice();
+    void setCurrentPreset(const Preset* preset);
 
     double m_sampleRate = 0.0;
     int m_samplesPerBlock = 0;
@@ -92,12 +166,14 @@ private:
     int16_t pitchWheel = 0;
     uint8_t modWheel = 0;
 
-    std::vector<VolChange> pendingVolChanges;
+    FixedVector<VolChange, MAX_PENDING_VOL_CHANGES> pendingVolChanges;
 
     int m_detectedBPM = -1;
 
     int m_currentBankId = 0;
     const Preset* m_preset = nullptr;
+    // Bank in the high half, program + 1 in the low one, for the editor. Published by setCurrentPreset
+    std::atomic<uint32_t> m_publishedPreset = 0;
 
     ADSR m_envelope;
     PWMData m_pwmData;
@@ -106,12 +182,32 @@ private:
     int reverbLevel = 0;
 
     EDSPType m_type;
-    std::list<Instrument*> m_playingInstruments;
-    std::vector<sample> outputBuffers;
+    VoicePool& m_voicePool;
+    std::vector<PlayingVoice> m_playingInstruments;
+    uint64_t m_numStolenVoices = 0;
+
+    struct NewVoice
+    {
+        Instrument* instr = nullptr;
+        size_t offset = 0;
+    };
+    std::vector<NewVoice> m_newInstruments;
+    AudioBus outputBuffers;
+
+    StereoBuffer m_scratchBuffer;
+    size_t m_scratchSize = 0;
 
-    std::unique_ptr<ReverbEffect> revdsp;
+    // One reverb per type, allocated with the channel buffers so that switching type doesn't allocate
+    std::array<std::unique_ptr<ReverbEffect>, NUM_REVERB_TYPES> m_reverbs;
+    ReverbEffect* revdsp = nullptr;
 
     std::unique_ptr<RPNHandler> m_rpnHanlder;
+
+    ChannelTimes m_times;
+
+    // Published by mixTo
+    std::atomic<float> m_peakLevels[2] = { 0.0f, 0.0f };
+    std::atomic<float> m_rmsLevels[2] = { 0.0f, 0.0f };
 };
 
 }
\ No newline at end of file
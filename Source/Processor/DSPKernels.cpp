@@ -0,0 +1,634 @@
+#include "DSPKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <JuceHeader.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+    #define GSVST_X86 1
+    #include <immintrin.h>
+#else
+    #define GSVST_X86 0
+#endif
+
+#if GSVST_X86 && (defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define GSVST_SSE2 1
+#else
+    #define GSVST_SSE2 0
+#endif
+
+// AVX2 functions are built whatever the compiler flags, and only called if the CPU supports them
+#if GSVST_SSE2
+    #define GSVST_AVX2 1
+    #if defined(__GNUC__) || defined(__clang__)
+        #define GSVST_TARGET_AVX2 __attribute__((target("avx2")))
+    #else
+        #define GSVST_TARGET_AVX2
+    #endif
+#else
+    #define GSVST_AVX2 0
+#endif
+
+namespace GSVST {
+
+static_assert(sizeof(sample) == 2 * sizeof(float), "SIMD kernels read fetch windows as interleaved floats");
+
+//-----------------------------------------------------------------------------
+// Scalar (reference)
+
+static void mixRampScalar(StereoBuffer buffer, StereoBuffer src, size_t numSamples, float& lVol, float& rVol, float lVolStep, float rVolStep)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        buffer.left[i] += src.left[i] * lVol;
+        buffer.right[i] += src.right[i] * rVol;
+        lVol += lVolStep;
+        rVol += rVolStep;
+    }
+}
+
+static void interpolateScalar(StereoBuffer out, const sample* window, const uint32_t* positions, const float* fracs, size_t numSamples)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const sample& a = window[positions[i]];
+        const sample& b = window[positions[i] + 1];
+        out.left[i] = a.left + fracs[i] * (b.left - a.left);
+        out.right[i] = a.right + fracs[i] * (b.right - a.right);
+    }
+}
+
+static void interpolateMonoScalar(float* out, const float* data, const uint32_t* positions, const float* fracs, size_t numSamples)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const float a = data[positions[i]];
+        const float b = data[positions[i] + 1];
+        out[i] = a + fracs[i] * (b - a);
+    }
+}
+
+static void blendedDot32Scalar(const float* kernelA, const float* kernelB, float frac, const sample* src, float& outLeft, float& outRight)
+{
+    float leftSampleSum = 0.0f;
+    float rightSampleSum = 0.0f;
+    for (int k = 0; k < 32; k++)
+    {
+        float kernel = kernelA[k] + frac * (kernelB[k] - kernelA[k]);
+        leftSampleSum += kernel * src[k].left;
+        rightSampleSum += kernel * src[k].right;
+    }
+    outLeft = leftSampleSum;
+    outRight = rightSampleSum;
+}
+
+// Int8 samples are the high byte of an int16 one
+static int toInt16Scale(int8_t value) { return int(value) * 256; }
+
+static void interpolateMonoInt16Scalar(float* out, const int16_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const float a = float(data[positions[i]]) / divisor;
+        const float b = float(data[positions[i] + 1]) / divisor;
+        out[i] = a + fracs[i] * (b - a);
+    }
+}
+
+static void interpolateMonoInt8Scalar(float* out, const int8_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        const float a = float(toInt16Scale(data[positions[i]])) / divisor;
+        const float b = float(toInt16Scale(data[positions[i] + 1])) / divisor;
+        out[i] = a + fracs[i] * (b - a);
+    }
+}
+
+static void convertInt16Scalar(float* out, const int16_t* in, size_t numSamples, float divisor)
+{
+    for (size_t i = 0; i < numSamples; i++)
+        out[i] = float(in[i]) / divisor;
+}
+
+static void convertInt8Scalar(float* out, const int8_t* in, size_t numSamples, float divisor)
+{
+    for (size_t i = 0; i < numSamples; i++)
+        out[i] = float(toInt16Scale(in[i])) / divisor;
+}
+
+static void mixMeasureScalar(float* dst, const float* src, size_t numSamples, float& peak, float& sumSquares)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        dst[i] += src[i];
+        peak = std::max(peak, std::abs(src[i]));
+        sumSquares += src[i] * src[i];
+    }
+}
+
+static const DSPKernels scalarKernels = {
+    ESIMDMode::Scalar,
+    mixRampScalar,
+    interpolateScalar,
+    interpolateMonoScalar,
+    blendedDot32Scalar,
+    interpolateMonoInt16Scalar,
+    interpolateMonoInt8Scalar,
+    convertInt16Scalar,
+    convertInt8Scalar,
+    mixMeasureScalar
+};
+
+//-----------------------------------------------------------------------------
+// SSE2
+
+#if GSVST_SSE2
+
+static void mixRampSSE2(StereoBuffer buffer, StereoBuffer src, size_t numSamples, float& lVol, float& rVol, float lVolStep, float rVolStep)
+{
+    // 4 samples per vector
+    __m128 lVolVec = _mm_setr_ps(lVol, lVol + lVolStep, lVol + lVolStep * 2.0f, lVol + lVolStep * 3.0f);
+    __m128 rVolVec = _mm_setr_ps(rVol, rVol + rVolStep, rVol + rVolStep * 2.0f, rVol + rVolStep * 3.0f);
+    const __m128 lStep = _mm_set1_ps(lVolStep * 4.0f);
+    const __m128 rStep = _mm_set1_ps(rVolStep * 4.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        _mm_storeu_ps(buffer.left + i, _mm_add_ps(_mm_loadu_ps(buffer.left + i), _mm_mul_ps(_mm_loadu_ps(src.left + i), lVolVec)));
+        _mm_storeu_ps(buffer.right + i, _mm_add_ps(_mm_loadu_ps(buffer.right + i), _mm_mul_ps(_mm_loadu_ps(src.right + i), rVolVec)));
+        lVolVec = _mm_add_ps(lVolVec, lStep);
+        rVolVec = _mm_add_ps(rVolVec, rStep);
+    }
+
+    lVol = _mm_cvtss_f32(lVolVec);
+    rVol = _mm_cvtss_f32(rVolVec);
+
+    mixRampScalar(buffer + i, src + i, numSamples - i, lVol, rVol, lVolStep, rVolStep);
+}
+
+static void interpolateSSE2(StereoBuffer out, const sample* window, const uint32_t* positions, const float* fracs, size_t numSamples)
+{
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        // a.left a.right b.left b.right of each output sample
+        const __m128 v0 = _mm_loadu_ps(&window[positions[i]].left);
+        const __m128 v1 = _mm_loadu_ps(&window[positions[i + 1]].left);
+        const __m128 v2 = _mm_loadu_ps(&window[positions[i + 2]].left);
+        const __m128 v3 = _mm_loadu_ps(&window[positions[i + 3]].left);
+        const __m128 a01 = _mm_movelh_ps(v0, v1);
+        const __m128 b01 = _mm_movehl_ps(v1, v0);
+        const __m128 a23 = _mm_movelh_ps(v2, v3);
+        const __m128 b23 = _mm_movehl_ps(v3, v2);
+
+        // Deinterleave to left and right vectors
+        const __m128 aLeft = _mm_shuffle_ps(a01, a23, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 aRight = _mm_shuffle_ps(a01, a23, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 bLeft = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 bRight = _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(3, 1, 3, 1));
+
+        const __m128 f = _mm_loadu_ps(fracs + i);
+        _mm_storeu_ps(out.left + i, _mm_add_ps(aLeft, _mm_mul_ps(f, _mm_sub_ps(bLeft, aLeft))));
+        _mm_storeu_ps(out.right + i, _mm_add_ps(aRight, _mm_mul_ps(f, _mm_sub_ps(bRight, aRight))));
+    }
+
+    interpolateScalar(out + i, window, positions + i, fracs + i, numSamples - i);
+}
+
+static void interpolateMonoSSE2(float* out, const float* data, const uint32_t* positions, const float* fracs, size_t numSamples)
+{
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const uint32_t* p = positions + i;
+        const __m128 a = _mm_setr_ps(data[p[0]], data[p[1]], data[p[2]], data[p[3]]);
+        const __m128 b = _mm_setr_ps(data[p[0] + 1], data[p[1] + 1], data[p[2] + 1], data[p[3] + 1]);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(fracs + i), _mm_sub_ps(b, a))));
+    }
+
+    interpolateMonoScalar(out + i, data, positions + i, fracs + i, numSamples - i);
+}
+
+static void blendedDot32SSE2(const float* kernelA, const float* kernelB, float frac, const sample* src, float& outLeft, float& outRight)
+{
+    const float* in = &src->left;
+    const __m128 f = _mm_set1_ps(frac);
+    __m128 acc = _mm_setzero_ps();
+
+    for (int k = 0; k < 32; k += 4)
+    {
+        const __m128 ka = _mm_loadu_ps(kernelA + k);
+        const __m128 kb = _mm_loadu_ps(kernelB + k);
+        const __m128 kernel = _mm_add_ps(ka, _mm_mul_ps(f, _mm_sub_ps(kb, ka)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_unpacklo_ps(kernel, kernel), _mm_loadu_ps(in + k * 2)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_unpackhi_ps(kernel, kernel), _mm_loadu_ps(in + k * 2 + 4)));
+    }
+
+    const __m128 sum = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    outLeft = _mm_cvtss_f32(sum);
+    outRight = _mm_cvtss_f32(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+// Integer samples are divided rather than multiplied by the inverse, to round like the scalar versions
+static void interpolateMonoInt16SSE2(float* out, const int16_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    const __m128 div = _mm_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const uint32_t* p = positions + i;
+        const __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(data[p[0]], data[p[1]], data[p[2]], data[p[3]])), div);
+        const __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(data[p[0] + 1], data[p[1] + 1], data[p[2] + 1], data[p[3] + 1])), div);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(fracs + i), _mm_sub_ps(b, a))));
+    }
+
+    interpolateMonoInt16Scalar(out + i, data, positions + i, fracs + i, numSamples - i, divisor);
+}
+
+static void interpolateMonoInt8SSE2(float* out, const int8_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    const __m128 div = _mm_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const uint32_t* p = positions + i;
+        const __m128i a = _mm_setr_epi32(data[p[0]], data[p[1]], data[p[2]], data[p[3]]);
+        const __m128i b = _mm_setr_epi32(data[p[0] + 1], data[p[1] + 1], data[p[2] + 1], data[p[3] + 1]);
+        const __m128 fa = _mm_div_ps(_mm_cvtepi32_ps(_mm_slli_epi32(a, 8)), div);
+        const __m128 fb = _mm_div_ps(_mm_cvtepi32_ps(_mm_slli_epi32(b, 8)), div);
+        _mm_storeu_ps(out + i, _mm_add_ps(fa, _mm_mul_ps(_mm_loadu_ps(fracs + i), _mm_sub_ps(fb, fa))));
+    }
+
+    interpolateMonoInt8Scalar(out + i, data, positions + i, fracs + i, numSamples - i, divisor);
+}
+
+// 8 int16 to float
+static void storeInt16SSE2(float* out, __m128i v, __m128 div)
+{
+    // Sign extension: each int16 goes to the high half of an int32, then is shifted back
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(out, _mm_div_ps(_mm_cvtepi32_ps(lo), div));
+    _mm_storeu_ps(out + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), div));
+}
+
+static void convertInt16SSE2(float* out, const int16_t* in, size_t numSamples, float divisor)
+{
+    const __m128 div = _mm_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        storeInt16SSE2(out + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), div);
+
+    convertInt16Scalar(out + i, in + i, numSamples - i, divisor);
+}
+
+static void convertInt8SSE2(float* out, const int8_t* in, size_t numSamples, float divisor)
+{
+    const __m128 div = _mm_set1_ps(divisor);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        // Each int8 becomes the high byte of an int16
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        storeInt16SSE2(out + i, _mm_unpacklo_epi8(zero, v), div);
+        storeInt16SSE2(out + i + 8, _mm_unpackhi_epi8(zero, v), div);
+    }
+
+    convertInt8Scalar(out + i, in + i, numSamples - i, divisor);
+}
+
+static void mixMeasureSSE2(float* dst, const float* src, size_t numSamples, float& peak, float& sumSquares)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peakVec = _mm_set1_ps(peak);
+    __m128 sumVec = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const __m128 v = _mm_loadu_ps(src + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+        peakVec = _mm_max_ps(peakVec, _mm_and_ps(v, absMask));
+        sumVec = _mm_add_ps(sumVec, _mm_mul_ps(v, v));
+    }
+
+    alignas(16) float peaks[4];
+    alignas(16) float sums[4];
+    _mm_store_ps(peaks, peakVec);
+    _mm_store_ps(sums, sumVec);
+    peak = std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+    sumSquares += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+
+    mixMeasureScalar(dst + i, src + i, numSamples - i, peak, sumSquares);
+}
+
+static const DSPKernels sse2Kernels = {
+    ESIMDMode::SSE2,
+    mixRampSSE2,
+    interpolateSSE2,
+    interpolateMonoSSE2,
+    blendedDot32SSE2,
+    interpolateMonoInt16SSE2,
+    interpolateMonoInt8SSE2,
+    convertInt16SSE2,
+    convertInt8SSE2,
+    mixMeasureSSE2
+};
+
+#endif
+
+//-----------------------------------------------------------------------------
+// AVX2
+
+#if GSVST_AVX2
+
+GSVST_TARGET_AVX2
+static void mixRampAVX2(StereoBuffer buffer, StereoBuffer src, size_t numSamples, float& lVol, float& rVol, float lVolStep, float rVolStep)
+{
+    // 8 samples per vector
+    const __m256 ramp = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 lVolVec = _mm256_add_ps(_mm256_set1_ps(lVol), _mm256_mul_ps(ramp, _mm256_set1_ps(lVolStep)));
+    __m256 rVolVec = _mm256_add_ps(_mm256_set1_ps(rVol), _mm256_mul_ps(ramp, _mm256_set1_ps(rVolStep)));
+    const __m256 lStep = _mm256_set1_ps(lVolStep * 8.0f);
+    const __m256 rStep = _mm256_set1_ps(rVolStep * 8.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        _mm256_storeu_ps(buffer.left + i, _mm256_add_ps(_mm256_loadu_ps(buffer.left + i), _mm256_mul_ps(_mm256_loadu_ps(src.left + i), lVolVec)));
+        _mm256_storeu_ps(buffer.right + i, _mm256_add_ps(_mm256_loadu_ps(buffer.right + i), _mm256_mul_ps(_mm256_loadu_ps(src.right + i), rVolVec)));
+        lVolVec = _mm256_add_ps(lVolVec, lStep);
+        rVolVec = _mm256_add_ps(rVolVec, rStep);
+    }
+
+    lVol = _mm_cvtss_f32(_mm256_castps256_ps128(lVolVec));
+    rVol = _mm_cvtss_f32(_mm256_castps256_ps128(rVolVec));
+
+    mixRampSSE2(buffer + i, src + i, numSamples - i, lVol, rVol, lVolStep, rVolStep);
+}
+
+GSVST_TARGET_AVX2
+static void interpolateMonoAVX2(float* out, const float* data, const uint32_t* positions, const float* fracs, size_t numSamples)
+{
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + i));
+        const __m256 a = _mm256_i32gather_ps(data, p, 4);
+        const __m256 b = _mm256_i32gather_ps(data + 1, p, 4);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(fracs + i), _mm256_sub_ps(b, a))));
+    }
+
+    interpolateMonoSSE2(out + i, data, positions + i, fracs + i, numSamples - i);
+}
+
+GSVST_TARGET_AVX2
+static void blendedDot32AVX2(const float* kernelA, const float* kernelB, float frac, const sample* src, float& outLeft, float& outRight)
+{
+    const float* in = &src->left;
+    const __m256 f = _mm256_set1_ps(frac);
+    const __m256i firstHalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i secondHalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int k = 0; k < 32; k += 8)
+    {
+        const __m256 ka = _mm256_loadu_ps(kernelA + k);
+        const __m256 kb = _mm256_loadu_ps(kernelB + k);
+        const __m256 kernel = _mm256_add_ps(ka, _mm256_mul_ps(f, _mm256_sub_ps(kb, ka)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_permutevar8x32_ps(kernel, firstHalf), _mm256_loadu_ps(in + k * 2)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_permutevar8x32_ps(kernel, secondHalf), _mm256_loadu_ps(in + k * 2 + 8)));
+    }
+
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    outLeft = _mm_cvtss_f32(sum);
+    outRight = _mm_cvtss_f32(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+// One 32 bits gather reads both data[pos] and data[pos + 1]
+GSVST_TARGET_AVX2
+static void interpolateMonoInt16AVX2(float* out, const int16_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    const __m256 div = _mm256_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + i));
+        const __m256i pair = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data), p, 2);
+        const __m256 a = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16)), div);
+        const __m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(pair, 16)), div);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(fracs + i), _mm256_sub_ps(b, a))));
+    }
+
+    interpolateMonoInt16SSE2(out + i, data, positions + i, fracs + i, numSamples - i, divisor);
+}
+
+// The gather reads 4 bytes from data[pos], which the guard samples cover
+GSVST_TARGET_AVX2
+static void interpolateMonoInt8AVX2(float* out, const int8_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor)
+{
+    const __m256 div = _mm256_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + i));
+        const __m256i bytes = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data), p, 1);
+        // Sign extended to the int16 scale
+        const __m256i a = _mm256_srai_epi32(_mm256_slli_epi32(bytes, 24), 16);
+        const __m256i b = _mm256_slli_epi32(_mm256_srai_epi32(_mm256_slli_epi32(bytes, 16), 24), 8);
+        const __m256 fa = _mm256_div_ps(_mm256_cvtepi32_ps(a), div);
+        const __m256 fb = _mm256_div_ps(_mm256_cvtepi32_ps(b), div);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(fa, _mm256_mul_ps(_mm256_loadu_ps(fracs + i), _mm256_sub_ps(fb, fa))));
+    }
+
+    interpolateMonoInt8SSE2(out + i, data, positions + i, fracs + i, numSamples - i, divisor);
+}
+
+GSVST_TARGET_AVX2
+static void convertInt16AVX2(float* out, const int16_t* in, size_t numSamples, float divisor)
+{
+    const __m256 div = _mm256_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), div));
+    }
+
+    convertInt16SSE2(out + i, in + i, numSamples - i, divisor);
+}
+
+GSVST_TARGET_AVX2
+static void convertInt8AVX2(float* out, const int8_t* in, size_t numSamples, float divisor)
+{
+    const __m256 div = _mm256_set1_ps(divisor);
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256i v = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_slli_epi32(v, 8)), div));
+    }
+
+    convertInt8Scalar(out + i, in + i, numSamples - i, divisor);
+}
+
+GSVST_TARGET_AVX2
+static void mixMeasureAVX2(float* dst, const float* src, size_t numSamples, float& peak, float& sumSquares)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peakVec = _mm256_set1_ps(peak);
+    __m256 sumVec = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(src + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), v));
+        peakVec = _mm256_max_ps(peakVec, _mm256_and_ps(v, absMask));
+        sumVec = _mm256_add_ps(sumVec, _mm256_mul_ps(v, v));
+    }
+
+    alignas(32) float peaks[8];
+    alignas(32) float sums[8];
+    _mm256_store_ps(peaks, peakVec);
+    _mm256_store_ps(sums, sumVec);
+    for (int k = 0; k < 8; k++)
+    {
+        peak = std::max(peak, peaks[k]);
+        sumSquares += sums[k];
+    }
+
+    mixMeasureSSE2(dst + i, src + i, numSamples - i, peak, sumSquares);
+}
+
+// Stereo interpolation gathers two interleaved samples per output, the SSE2 version is used as is
+static const DSPKernels avx2Kernels = {
+    ESIMDMode::AVX2,
+    mixRampAVX2,
+    interpolateSSE2,
+    interpolateMonoAVX2,
+    blendedDot32AVX2,
+    interpolateMonoInt16AVX2,
+    interpolateMonoInt8AVX2,
+    convertInt16AVX2,
+    convertInt8AVX2,
+    mixMeasureAVX2
+};
+
+#endif
+
+//-----------------------------------------------------------------------------
+// Dispatch
+
+bool isSIMDModeSupported(ESIMDMode mode)
+{
+    switch (mode)
+    {
+    case ESIMDMode::Auto:
+    case ESIMDMode::Scalar:
+        return true;
+    case ESIMDMode::SSE2:
+        return GSVST_SSE2 && juce::SystemStats::hasSSE2();
+    case ESIMDMode::AVX2:
+        return GSVST_AVX2 && juce::SystemStats::hasAVX2();
+    }
+
+    return false;
+}
+
+static const DSPKernels* selectKernels(ESIMDMode mode)
+{
+    if (mode == ESIMDMode::Auto)
+    {
+        if (isSIMDModeSupported(ESIMDMode::AVX2))
+            mode = ESIMDMode::AVX2;
+        else if (isSIMDModeSupported(ESIMDMode::SSE2))
+            mode = ESIMDMode::SSE2;
+        else
+            mode = ESIMDMode::Scalar;
+    }
+    else if (!isSIMDModeSupported(mode))
+    {
+        return selectKernels(ESIMDMode::Auto);
+    }
+
+    switch (mode)
+    {
+#if GSVST_AVX2
+    case ESIMDMode::AVX2:
+        return &avx2Kernels;
+#endif
+#if GSVST_SSE2
+    case ESIMDMode::SSE2:
+        return &sse2Kernels;
+#endif
+    default:
+        return &scalarKernels;
+    }
+}
+
+static ESIMDMode getModeFromEnvironment()
+{
+    auto value = juce::SystemStats::getEnvironmentVariable("GSVST_SIMD", "auto").toLowerCase();
+
+    if (value == "scalar")
+        return ESIMDMode::Scalar;
+    if (value == "sse2")
+        return ESIMDMode::SSE2;
+    if (value == "avx2")
+        return ESIMDMode::AVX2;
+
+    return ESIMDMode::Auto;
+}
+
+// Constant initialized: the audio thread only loads the pointer, without a static guard
+static std::atomic<ESIMDMode> s_requestedMode { ESIMDMode::Auto };
+static std::atomic<const DSPKernels*> s_kernels { &scalarKernels };
+static std::atomic<bool> s_bInitialized { false };
+
+void initDSPKernels()
+{
+    // The environment is read once, later calls keep the mode set by setSIMDMode
+    if (s_bInitialized.exchange(true))
+        return;
+
+    setSIMDMode(getModeFromEnvironment());
+}
+
+const DSPKernels& getDSPKernels()
+{
+    return *s_kernels.load(std::memory_order_relaxed);
+}
+
+void setSIMDMode(ESIMDMode mode)
+{
+    s_bInitialized = true;
+    s_requestedMode = mode;
+    s_kernels = selectKernels(mode);
+}
+
+ESIMDMode getSIMDMode()
+{
+    return s_requestedMode;
+}
+
+ESIMDMode getActiveSIMDMode()
+{
+    return getDSPKernels().mode;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace GSVST {
+
+enum class ESIMDMode : uint8_t { Auto = 0, Scalar, SSE2, AVX2 };
+
+/*
+ * Inner loops of the voices, with one implementation per instruction set.
+ * The scalar versions are the reference: the SIMD ones give the same interpolation results,
+ * but volume ramps and dot products are summed in a different order.
+ */
+struct DSPKernels
+{
+    ESIMDMode mode;
+
+    // buffer += src * vol, vol being incremented by volStep after each sample. Volumes are returned for the next sample
+    void (*mixRamp)(StereoBuffer buffer, StereoBuffer src, size_t numSamples, float& lVol, float& rVol, float lVolStep, float rVolStep);
+
+    // out = window[pos] + frac * (window[pos + 1] - window[pos]), the window being interleaved
+    void (*interpolate)(StereoBuffer out, const sample* window, const uint32_t* positions, const float* fracs, size_t numSamples);
+    // Same as interpolate for mono data
+    void (*interpolateMono)(float* out, const float* data, const uint32_t* positions, const float* fracs, size_t numSamples);
+
+    // 32 taps dot product with a kernel blended between kernelA and kernelB
+    void (*blendedDot32)(const float* kernelA, const float* kernelB, float frac, const sample* src, float& outLeft, float& outRight);
+
+    // Same as interpolateMono for integer data, converted as value / divisor (see ESampleFormat)
+    void (*interpolateMonoInt16)(float* out, const int16_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor);
+    void (*interpolateMonoInt8)(float* out, const int8_t* data, const uint32_t* positions, const float* fracs, size_t numSamples, float divisor);
+
+    // out = in / divisor, in being on the int16 scale. With a divisor of 32767, the same conversion
+    // as tinysoundfont when it loads a soundfont
+    void (*convertInt16)(float* out, const int16_t* in, size_t numSamples, float divisor);
+    void (*convertInt8)(float* out, const int8_t* in, size_t numSamples, float divisor);
+
+    // dst += src, raising peak to the highest src magnitude and adding the src squares to sumSquares
+    void (*mixMeasure)(float* dst, const float* src, size_t numSamples, float& peak, float& sumSquares);
+};
+
+// Selects the kernels from the CPU features, or the ones forced with the GSVST_SIMD environment
+// variable (scalar, sse2, avx2). Called by the Processor constructor: it allocates
+void initDSPKernels();
+
+// Scalar until initDSPKernels or setSIMDMode. Only loads an atomic, for the audio thread
+const DSPKernels& getDSPKernels();
+
+// Forces the kernels for A/B comparisons
+
+void setSIMDMode(ESIMDMode mode);
+ESIMDMode getSIMDMode();
+ESIMDMode getActiveSIMDMode();
+bool isSIMDModeSupported(ESIMDMode mode);
+
+}
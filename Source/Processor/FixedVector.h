@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+namespace GSVST {
+
+/*
+ * Vector with inline storage, for the lists the audio thread fills per voice or channel.
+ * Never allocates: push_back and emplace_back return false once Capacity is reached.
+ */
+template<typename T, size_t Capacity>
+class FixedVector
+{
+public:
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    bool push_back(const T& value)
+    {
+        if (full())
+            return false;
+
+        m_items[m_size++] = value;
+        return true;
+    }
+
+    template<typename... Args>
+    bool emplace_back(Args&&... args)
+    {
+        if (full())
+            return false;
+
+        m_items[m_size++] = T(std::forward<Args>(args)...);
+        return true;
+    }
+
+    void pop_back()
+    {
+        assert(m_size > 0);
+        m_size--;
+    }
+
+    // Keeps the order of the remaining items
+    iterator erase(iterator it)
+    {
+        std::move(it + 1, end(), it);
+        m_size--;
+        return it;
+    }
+
+    void clear() { m_size = 0; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool full() const { return m_size == Capacity; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    T& operator[](size_t i) { return m_items[i]; }
+    const T& operator[](size_t i) const { return m_items[i]; }
+    T& front() { return m_items[0]; }
+    const T& front() const { return m_items[0]; }
+    T& back() { return m_items[m_size - 1]; }
+    const T& back() const { return m_items[m_size - 1]; }
+
+    iterator begin() { return m_items; }
+    iterator end() { return m_items + m_size; }
+    const_iterator begin() const { return m_items; }
+    const_iterator end() const { return m_items + m_size; }
+
+private:
+    T m_items[Capacity] = {};
+    size_t m_size = 0;
+};
+
+}
@@ -1,7 +1,9 @@
 #include "Instrument.h"
+#include "DSPKernels.h"
 
 #include <assert.h>
 #include <algorithm>
+#include <cmath>
 
 namespace GSVST {
 
@@ -22,7 +24,7 @@ Instrument::VolumeFade Instrument::getVol() const
     return retval;
 }
 
-void Instrument::processCommon(sample* buffer, size_t numSamples, const MixingArgs& args)
+void Instrument::processCommon(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
 {
     if (isDead())
         return;
@@ -44,6 +46,31 @@ void Instrument::processCommon(sample* buffer, size_t numSamples, const MixingAr
 }
 
 
+void Instrument::mixOutput(StereoBuffer& buffer, StereoBuffer src, size_t numSamples, size_t& currentSample, const MixingArgs& args, const DSPKernels& kernels)
+{
+    while (numSamples > 0)
+    {
+        processStart(args, currentSample, numSamples);
+
+        // The volume ramp can only change in processStart, at the start of a sub-frame
+        const size_t runSize = std::min(numSamples, getSamplesUntilUpdate(args));
+        mixRun(buffer, src, runSize, currentSample, args, kernels);
+        src += runSize;
+        numSamples -= runSize;
+    }
+}
+
+void Instrument::mixRun(StereoBuffer& buffer, StereoBuffer src, size_t runSize, size_t& currentSample, const MixingArgs& args, const DSPKernels& kernels)
+{
+    assert(runSize <= getSamplesUntilUpdate(args));
+
+    kernels.mixRamp(buffer, src, runSize, cargs.lVol, cargs.rVol, cargs.lVolStep, cargs.rVolStep);
+    buffer += runSize;
+
+    processEnd(args, currentSample, runSize);
+    currentSample += runSize;
+}
+
 void Instrument::processStart(const MixingArgs& args, size_t currentSample, size_t numSamples)
 {
     if (envSampleCount == 0)
@@ -59,7 +86,8 @@ void Instrument::processStart(const MixingArgs& args, size_t currentSample, size
 
 void Instrument::addPendingVolChange(int timestamp, int volume)
 {
-    pendingVolChanges.emplace_back(timestamp, volume);
+    if (!pendingVolChanges.emplace_back(timestamp, volume))
+        pendingVolChanges.back() = VolChange(timestamp, volume);
 }
 
 bool Instrument::hasPendingNoteOff() const
@@ -69,6 +97,7 @@ bool Instrument::hasPendingNoteOff() const
 
 void Instrument::addPendingNoteOff(int timestamp)
 {
+    // When full, the earliest note off is already pending
     pendingNoteOff.emplace_back(timestamp);
 }
 
@@ -128,16 +157,26 @@ void Instrument::handlePendingNoteOff(int sampleId)
     }
 }
 
-void Instrument::processEnd(const MixingArgs& args, size_t currentSample)
+void Instrument::processEnd(const MixingArgs& args, size_t currentSample, size_t numSamples)
 {
-    updateIncrements(args);
+    assert(numSamples <= getSamplesUntilUpdate(args));
+
+    updateIncrements(args, numSamples);
 
     if (envSampleCount == 0)
     {
         updateVolFade();
     }
 
-    handlePendingNoteOff(currentSample);
+    if (!pendingNoteOff.empty() && !isStopping())
+    {
+        // Sample ids of the run are currentSample + 1 to currentSample + numSamples.
+        // Nothing can happen before the earliest note off, and nothing after the release
+        const double earliest = *std::min_element(pendingNoteOff.begin(), pendingNoteOff.end());
+        const double sampleId = std::max(static_cast<double>(currentSample + 1), std::ceil(earliest));
+        if (sampleId <= static_cast<double>(currentSample + numSamples))
+            handlePendingNoteOff(static_cast<int>(sampleId));
+    }
 }
 
 void Instrument::setVol(uint8_t in_vol)
@@ -380,9 +419,9 @@ void Instrument::updateVolFade()
 }
 
 
-void Instrument::updateIncrements(const MixingArgs& args)
+void Instrument::updateIncrements(const MixingArgs& args, size_t numSamples)
 {
-    envSampleCount++;
+    envSampleCount += static_cast<int>(numSamples);
     if (envSampleCount == args.samplesPerBufferForComputation)
     {
         envSampleCount = 0;
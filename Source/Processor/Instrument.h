@@ -2,10 +2,13 @@
 
 #include "Types.h"
 #include "Resampler.h"
+#include "FixedVector.h"
 #include <memory>
 
 namespace GSVST {
 
+struct DSPKernels;
+
 struct ProcArgs
 {
     float lVol = 0.0f;
@@ -25,6 +28,7 @@ enum class EDSPType : uint8_t
     Tri,
     Square
 };
+#define NUM_DSP_TYPES 6
 class Instrument
 {
 public:
@@ -36,17 +40,19 @@ public:
     Instrument(const Instrument&) = delete;
     Instrument& operator=(const Instrument&) = delete;
 
-    virtual void processCommon(sample* buffer, size_t numSamples, const MixingArgs& args);
+    virtual void processCommon(StereoBuffer buffer, size_t numSamples, const MixingArgs& args);
 
     virtual EDSPType getType() const = 0;
-    virtual void process(sample* buffer, size_t numSamples, const MixingArgs& args) = 0;
+    virtual void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) = 0;
     virtual void updateArgs(const MixingArgs& args);
     virtual int getMidCFreq() const = 0;
     int8_t getMidiKeyPitch() const { return note.midiKeyPitch; }
     uint8_t getMidiNote() const { return note.midiKeyTrackData; }
 
     virtual void processStart(const MixingArgs& args, size_t currentSample, size_t numSamples);
-    virtual void processEnd(const MixingArgs& args, size_t currentSample);
+    // Advances the voice by numSamples output samples after currentSample, which must not go past the next
+    // processStart update. Same result as a per sample loop, events being handled at the sample they happen
+    void processEnd(const MixingArgs& args, size_t currentSample, size_t numSamples);
 
     struct VolumeFade
     {
@@ -98,9 +104,17 @@ protected:
     void handlePendingVolumeChanges(int sampleId);
     void handlePendingNoteOff(int sampleId);
 
-    void updateIncrements(const MixingArgs& args);
+    void updateIncrements(const MixingArgs& args, size_t numSamples);
     void updateBPMStack();
 
+    // Samples left before processStart updates the volume ramp
+    size_t getSamplesUntilUpdate(const MixingArgs& args) const { return static_cast<size_t>(args.samplesPerBufferForComputation - envSampleCount); }
+    // Mixes the voice output to buffer, with processStart/processEnd called for each run between two updates.
+    // Mono voices can pass the same array for both sides of src
+    void mixOutput(StereoBuffer& buffer, StereoBuffer src, size_t numSamples, size_t& currentSample, const MixingArgs& args, const DSPKernels& kernels);
+    // Same for a run that doesn't go past the next update (processStart must have been called before)
+    void mixRun(StereoBuffer& buffer, StereoBuffer src, size_t runSize, size_t& currentSample, const MixingArgs& args, const DSPKernels& kernels);
+
     virtual void stepEnvelope();
     virtual void updateVolFade();
 
@@ -142,8 +156,8 @@ protected:
 
     bool bUseTrackADSR = true;
 
-    std::vector<VolChange> pendingVolChanges;
-    std::vector<double> pendingNoteOff;
+    FixedVector<VolChange, MAX_PENDING_VOL_CHANGES> pendingVolChanges;
+    FixedVector<double, MAX_PENDING_NOTE_OFFS> pendingNoteOff;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GSVST {
+
+class VoicePool;
+struct SampleInfo;
+class Resampler;
+
+/*
+ * Deleter used by the voices to give their sub-objects back to the VoicePool they come from
+ */
+struct VoicePoolDeleter
+{
+    VoicePool* pool = nullptr;
+
+    void operator()(SampleInfo* info) const;
+    void operator()(Resampler* resampler) const;
+};
+
+template<typename T>
+using PooledPtr = std::unique_ptr<T, VoicePoolDeleter>;
+
+/*
+ * Fixed capacity storage for objects of type T, constructed in place by acquire().
+ * acquire() and release() are O(1) and never allocate once init() has been called.
+ * When the pool is exhausted, acquire() returns nullptr (counted in getNumOverflows).
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    void init(size_t capacity)
+    {
+        assert(getNumUsed() == 0);
+
+        m_storage.reset(new Slot[capacity]);
+        m_capacity = capacity;
+
+        m_freeList.clear();
+        m_freeList.reserve(capacity);
+        for (size_t i = capacity; i > 0; i--)
+            m_freeList.push_back(static_cast<uint32_t>(i - 1));
+    }
+
+    template<typename... Args>
+    T* acquire(Args&&... args)
+    {
+        if (m_freeList.empty())
+        {
+            m_numOverflows++;
+            return nullptr;
+        }
+
+        const auto slotId = m_freeList.back();
+        m_freeList.pop_back();
+        return new (&m_storage[slotId]) T(std::forward<Args>(args)...);
+    }
+
+    // obj can point to T or to one of its bases (which then needs a virtual destructor).
+    // Returns false if obj doesn't belong to this pool.
+    template<typename Base>
+    bool release(Base* obj)
+    {
+        const auto slotId = getSlotId(obj);
+        if (slotId < 0)
+            return false;
+
+        obj->~Base();
+        m_freeList.push_back(static_cast<uint32_t>(slotId));
+        return true;
+    }
+
+    size_t getCapacity() const { return m_capacity; }
+    size_t getNumUsed() const { return m_capacity - m_freeList.size(); }
+    bool isFull() const { return m_freeList.empty(); }
+    size_t getNumOverflows() const { return m_numOverflows; }
+
+private:
+    using Slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    int64_t getSlotId(const void* obj) const
+    {
+        const auto* begin = reinterpret_cast<const char*>(m_storage.get());
+        const auto* ptr = static_cast<const char*>(obj);
+        if (!begin || ptr < begin || ptr >= begin + m_capacity * sizeof(Slot))
+            return -1;
+
+        return static_cast<int64_t>((ptr - begin) / sizeof(Slot));
+    }
+
+    std::unique_ptr<Slot[]> m_storage;
+    std::vector<uint32_t> m_freeList;
+    size_t m_capacity = 0;
+    size_t m_numOverflows = 0;
+};
+
+/*
+ * Fixed set of objects of type T built once in init() and recycled afterwards.
+ * Unlike ObjectPool, released objects are not destroyed, so they keep their internal buffers.
+ * When the pool is exhausted, acquire() returns nullptr (counted in getNumOverflows).
+ */
+template<typename T>
+class RecyclingPool
+{
+public:
+    RecyclingPool() = default;
+    RecyclingPool(const RecyclingPool&) = delete;
+    RecyclingPool& operator=(const RecyclingPool&) = delete;
+
+    void init(size_t capacity)
+    {
+        assert(getNumUsed() == 0);
+
+        m_objects.reset(new T[capacity]);
+        m_capacity = capacity;
+
+        m_freeList.clear();
+        m_freeList.reserve(capacity);
+        for (size_t i = capacity; i > 0; i--)
+            m_freeList.push_back(static_cast<uint32_t>(i - 1));
+    }
+
+    T* acquire()
+    {
+        if (m_freeList.empty())
+        {
+            m_numOverflows++;
+            return nullptr;
+        }
+
+        const auto id = m_freeList.back();
+        m_freeList.pop_back();
+        return &m_objects[id];
+    }
+
+    // Returns false if obj doesn't belong to this pool
+    template<typename Base>
+    bool release(Base* obj)
+    {
+        const auto* begin = reinterpret_cast<const char*>(m_objects.get());
+        const auto* ptr = reinterpret_cast<const char*>(obj);
+        if (!begin || ptr < begin || ptr >= begin + m_capacity * sizeof(T))
+            return false;
+
+        m_freeList.push_back(static_cast<uint32_t>((ptr - begin) / sizeof(T)));
+        return true;
+    }
+
+    size_t getCapacity() const { return m_capacity; }
+    size_t getNumUsed() const { return m_capacity - m_freeList.size(); }
+    size_t getNumOverflows() const { return m_numOverflows; }
+
+private:
+    std::unique_ptr<T[]> m_objects;
+    std::vector<uint32_t> m_freeList;
+    size_t m_capacity = 0;
+    size_t m_numOverflows = 0;
+};
+
+}
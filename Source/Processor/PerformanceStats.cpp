@@ -0,0 +1,103 @@
+#include "PerformanceStats.h"
+
+#include <algorithm>
+
+namespace GSVST {
+
+// Weight of the last block in the averages
+#define PERF_AVERAGE_FACTOR 0.05f
+
+static float average(const std::atomic<float>& previous, float value)
+{
+    const auto previousValue = previous.load(std::memory_order_relaxed);
+    return previousValue + (value - previousValue) * PERF_AVERAGE_FACTOR;
+}
+
+void PerformanceStats::publish(const BlockPerf& block)
+{
+    if (m_bResetRequested.exchange(false, std::memory_order_acquire))
+    {
+        reset();
+        m_poolOverflowsAtReset = block.numPoolOverflows;
+        m_stolenVoicesAtReset = block.numStolenVoices;
+    }
+
+    if (block.deadline <= 0.0)
+        return;
+
+    const auto invDeadline = 1.0 / block.deadline;
+    const auto load = static_cast<float>(block.blockTime * invDeadline);
+
+    m_load.store(load, std::memory_order_relaxed);
+    m_averageLoad.store(average(m_averageLoad, load), std::memory_order_relaxed);
+    m_reverbLoad.store(average(m_reverbLoad, static_cast<float>(block.reverbTime * invDeadline)), std::memory_order_relaxed);
+
+    // Only the message thread lowers it, when reading
+    auto peakLoad = m_peakLoad.load(std::memory_order_relaxed);
+    while (load > peakLoad && !m_peakLoad.compare_exchange_weak(peakLoad, load, std::memory_order_relaxed)) {}
+
+    for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
+        m_channelLoads[i].store(average(m_channelLoads[i], static_cast<float>(block.channelTimes[i] * invDeadline)), std::memory_order_relaxed);
+
+    for (int i = 0; i < NUM_DSP_TYPES; i++)
+        m_numVoices[i].store(block.numVoices[i], std::memory_order_relaxed);
+
+    // Single writer: no read-modify-write needed
+    auto increment = [](std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    };
+
+    increment(m_numBlocks, 1);
+    increment(m_numOverruns, load > 1.0f ? 1 : 0);
+    increment(m_numVoiceAllocations, block.numNewVoices);
+    m_numPoolOverflows.store(block.numPoolOverflows - m_poolOverflowsAtReset, std::memory_order_relaxed);
+    m_numStolenVoices.store(block.numStolenVoices - m_stolenVoicesAtReset, std::memory_order_relaxed);
+
+    const auto bin = std::min(static_cast<int>(load * 10.0f), PERF_HISTOGRAM_BINS - 1);
+    increment(m_histogram[bin], 1);
+}
+
+PerfSnapshot PerformanceStats::read()
+{
+    PerfSnapshot snapshot;
+    snapshot.load = m_load.load(std::memory_order_relaxed);
+    snapshot.averageLoad = m_averageLoad.load(std::memory_order_relaxed);
+    snapshot.peakLoad = m_peakLoad.exchange(0.0f, std::memory_order_relaxed);
+    snapshot.reverbLoad = m_reverbLoad.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
+        snapshot.channelLoads[i] = m_channelLoads[i].load(std::memory_order_relaxed);
+
+    for (int i = 0; i < NUM_DSP_TYPES; i++)
+        snapshot.numVoices[i] = m_numVoices[i].load(std::memory_order_relaxed);
+
+    snapshot.numBlocks = m_numBlocks.load(std::memory_order_relaxed);
+    snapshot.numOverruns = m_numOverruns.load(std::memory_order_relaxed);
+    snapshot.numVoiceAllocations = m_numVoiceAllocations.load(std::memory_order_relaxed);
+    snapshot.numPoolOverflows = m_numPoolOverflows.load(std::memory_order_relaxed);
+    snapshot.numStolenVoices = m_numStolenVoices.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < PERF_HISTOGRAM_BINS; i++)
+        snapshot.histogram[i] = m_histogram[i].load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+void PerformanceStats::reset()
+{
+    m_averageLoad.store(0.0f, std::memory_order_relaxed);
+    m_reverbLoad.store(0.0f, std::memory_order_relaxed);
+
+    for (auto& channelLoad : m_channelLoads)
+        channelLoad.store(0.0f, std::memory_order_relaxed);
+
+    m_numBlocks.store(0, std::memory_order_relaxed);
+    m_numOverruns.store(0, std::memory_order_relaxed);
+    m_numVoiceAllocations.store(0, std::memory_order_relaxed);
+
+    for (auto& count : m_histogram)
+        count.store(0, std::memory_order_relaxed);
+}
+
+}
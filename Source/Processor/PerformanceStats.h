@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Types.h"
+#include "Instrument.h"
+
+namespace GSVST {
+
+// Block time histogram: bins of 10% of the block duration, the last one also counting anything longer
+#define PERF_HISTOGRAM_BINS 20
+
+// Adds the time spent in the scope to total, in seconds
+class ScopedPerfTimer
+{
+public:
+    ScopedPerfTimer(double& in_total)
+        : m_total(in_total)
+        , m_start(std::chrono::steady_clock::now())
+    {}
+
+    ~ScopedPerfTimer()
+    {
+        m_total += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    double& m_total;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// What the audio thread measured during one block. Times are in seconds
+struct BlockPerf
+{
+    double blockTime = 0.0;
+    // Duration of the block's audio: rendering takes longer than this means a dropout
+    double deadline = 0.0;
+    double channelTimes[MAX_MIDI_CHANNELS] = {};
+    double reverbTime = 0.0;
+
+    uint32_t numVoices[NUM_DSP_TYPES] = {};
+    uint32_t numNewVoices = 0;
+    // Voices and sub-objects refused by a full VoicePool, since it was prepared. Only when no voice could be stolen
+    uint64_t numPoolOverflows = 0;
+    // Voices killed by a note-on on a channel at MAX_VOICES_PER_CHANNEL, since the channels were created
+    uint64_t numStolenVoices = 0;
+};
+
+// Stats read by the editor. Loads are relative to the block duration (1 = the whole time available)
+struct PerfSnapshot
+{
+    float load = 0.0f;
+    float averageLoad = 0.0f;
+    // Highest since the previous read
+    float peakLoad = 0.0f;
+    float reverbLoad = 0.0f;
+    float channelLoads[MAX_MIDI_CHANNELS] = {};
+
+    uint32_t numVoices[NUM_DSP_TYPES] = {};
+
+    // Since the last reset
+    uint64_t numBlocks = 0;
+    uint64_t numOverruns = 0;
+    uint64_t numVoiceAllocations = 0;
+    uint64_t numPoolOverflows = 0;
+    uint64_t numStolenVoices = 0;
+    uint64_t histogram[PERF_HISTOGRAM_BINS] = {};
+};
+
+/*
+ * Lock-free stats surface between the audio thread, which publishes every block, and the editor.
+ * Each value is atomic on its own: a snapshot can mix two consecutive blocks, which doesn't matter for display.
+ */
+class PerformanceStats
+{
+public:
+    // Audio thread
+    void publish(const BlockPerf& block);
+
+    // Message thread
+    PerfSnapshot read();
+    // Applied by the audio thread on the next block
+    void requestReset() { m_bResetRequested = true; }
+
+private:
+    void reset();
+
+    std::atomic<float> m_load { 0.0f };
+    std::atomic<float> m_averageLoad { 0.0f };
+    std::atomic<float> m_peakLoad { 0.0f };
+    std::atomic<float> m_reverbLoad { 0.0f };
+    std::atomic<float> m_channelLoads[MAX_MIDI_CHANNELS] = {};
+
+    std::atomic<uint32_t> m_numVoices[NUM_DSP_TYPES] = {};
+
+    std::atomic<uint64_t> m_numBlocks { 0 };
+    std::atomic<uint64_t> m_numOverruns { 0 };
+    std::atomic<uint64_t> m_numVoiceAllocations { 0 };
+    std::atomic<uint64_t> m_numPoolOverflows { 0 };
+    std::atomic<uint64_t> m_numStolenVoices { 0 };
+    std::atomic<uint64_t> m_histogram[PERF_HISTOGRAM_BINS] = {};
+
+    // The pool keeps its own total. Audio thread
+    uint64_t m_poolOverflowsAtReset = 0;
+    uint64_t m_stolenVoicesAtReset = 0;
+
+    std::atomic<bool> m_bResetRequested { false };
+};
+
+}
@@ -1,8 +1,10 @@
 #include "Processor.h"
 #include "GUI/MainWindow.h"
 
+#include "DSPKernels.h"
 #include "ReverbEffect.h"
 #include "Instrument.h"
+#include "Trace.h"
 
 #include "GS/GSPresets.h"
 
@@ -22,9 +24,12 @@ Processor::Processor()
 )
 #endif
 {
+    // Not left to the first block: reading the environment allocates
+    initDSPKernels();
+
     for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
     {
-        m_channels[i] = new ChannelState();
+        m_channels[i] = new ChannelState(m_voicePool);
     }
 
     m_presets.reset(new GSPresets());
@@ -32,7 +37,8 @@ Processor::Processor()
 
 Processor::~Processor()
 {
-    m_presets->cleanupSoundfont();
+    m_renderPool.stop();
+    m_presets->stopLoading();
 
     for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
     {
@@ -41,12 +47,66 @@ Processor::~Processor()
     }
 }
 
+void Processor::pushChannelCommand(const ChannelCommand& command)
+{
+    // Only full if the host stopped calling processBlock: the change is dropped, as the editor refresh would revert it anyway
+    m_channelCommands.push(command);
+}
+
+void Processor::setChannelPreset(int midiChannel, int bankId, int programId)
+{
+    ChannelCommand command;
+    command.type = EChannelCommand::SetPreset;
+    command.midiChannel = midiChannel;
+    command.bankId = bankId;
+    command.programId = programId;
+    pushChannelCommand(command);
+}
+
 void Processor::applyReverbToAllChannels(EReverbType type)
 {
-    ForEachMidiChannel([&](auto& state)
+    ChannelCommand command;
+    command.type = EChannelCommand::SetReverbType;
+    command.midiChannel = -1;
+    command.value = static_cast<int>(type);
+    pushChannelCommand(command);
+}
+
+void Processor::applyChannelCommands()
+{
+    ChannelCommand command;
+    while (m_channelCommands.pop(command))
     {
-        state.setReverbType(type);
-    });
+        if (command.midiChannel < 0)
+        {
+            ForEachMidiChannel([&](auto& state)
+            {
+                bRefreshUIRequired |= state.applyCommand(command, *m_presetSet);
+            });
+        }
+        else if (command.midiChannel < MAX_MIDI_CHANNELS)
+        {
+            bRefreshUIRequired |= GetChannelState(command.midiChannel).applyCommand(command, *m_presetSet);
+        }
+    }
+}
+
+void Processor::setMultiThreaded(bool bEnable)
+{
+    if (bEnable == m_bMultiThreaded)
+        return;
+
+    // The audio thread can be in the middle of a run: it completes without the workers
+    if (bEnable)
+    {
+        m_renderPool.start(RenderThreadPool::getDefaultNumWorkers(MAX_MIDI_CHANNELS));
+        m_bMultiThreaded = true;
+    }
+    else
+    {
+        m_bMultiThreaded = false;
+        m_renderPool.stop();
+    }
 }
 
 //==============================================================================
@@ -119,10 +179,72 @@ int Processor::getNumSamplesForComputation(double sampleRate)
 //==============================================================================
 void Processor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    ForEachMidiChannel([&](auto& state)
+    m_scratchArena.prepare(MAX_MIDI_CHANNELS, samplesPerBlock);
+
+    prepareVoicePool();
+    m_voicePool.setSampleRate(sampleRate);
+    m_sharedReverb.prepare(samplesPerBlock, getNumSamplesForComputation(sampleRate));
+
+    for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
     {
+        auto& state = *m_channels[i];
         state.init(sampleRate, samplesPerBlock, getNumSamplesForComputation(sampleRate));
+        state.setScratchBuffer(m_scratchArena.getSlice(i), m_scratchArena.getSliceSize());
+    }
+}
+
+void Processor::prepareVoicePool()
+{
+    const auto capacity = static_cast<size_t>(m_voicePoolCapacity);
+    if (m_voicePool.isPrepared(capacity))
+        return;
+
+    // Pools are rebuilt: give back the voices still playing first
+    ForEachMidiChannel([](auto& state)
+    {
+        state.cleanup();
     });
+
+    m_voicePool.prepare(capacity);
+}
+
+void Processor::setVoicePoolCapacity(int capacity)
+{
+    capacity = std::clamp(capacity, MIN_VOICE_POOL_CAPACITY, MAX_VOICE_POOL_CAPACITY);
+    if (capacity == m_voicePoolCapacity)
+        return;
+
+    m_voicePoolCapacity = capacity;
+
+    // Before the first prepareToPlay, it is done there
+    if (getSampleRate() <= 0.0)
+        return;
+
+    // Suspending waits for the block being processed, if any
+    suspendProcessing(true);
+    prepareVoicePool();
+    suspendProcessing(false);
+}
+
+void Processor::stealOldestVoice(EDSPType type)
+{
+    ChannelState* owner = nullptr;
+    const PlayingVoice* oldest = nullptr;
+
+    ForEachMidiChannel([&](auto& state)
+    {
+        for (const auto& voice : state.getPlayingInstruments())
+        {
+            if (VoicePool::isSamePool(voice.instr->getType(), type) && (!oldest || voice.serial < oldest->serial))
+            {
+                oldest = &voice;
+                owner = &state;
+            }
+        }
+    });
+
+    if (oldest)
+        owner->stealVoice(oldest->instr);
 }
 
 void Processor::releaseResources()
@@ -162,6 +284,9 @@ int getChannelId(const juce::MidiMessage& msg)
 
 void Processor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    GSVST_RT_SCOPE();
+    GSVST_TRACE_SCOPE("processBlock");
+    const auto blockStart = std::chrono::steady_clock::now();
     const auto& numSamples = buffer.getNumSamples();
 
     juce::ScopedNoDenormals noDenormals;
@@ -171,6 +296,16 @@ void Processor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
+    updatePresetSet();
+
+    // Nothing to play until the first set is published
+    if (!m_presetSet)
+    {
+        buffer.clear();
+        return;
+    }
+    applyChannelCommands();
+
     bool bIsPlaying = true;
 
     auto positionInfo = getPlayHead()->getPosition();
@@ -214,6 +349,7 @@ void Processor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&
     }
 
     pendingNotesOn.clear();
+    uint32_t numNewVoices = 0;
 
     for (const auto& msgRaw : midiMessages)
     {
@@ -237,7 +373,7 @@ void Processor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&
         }
         else
         {
-            bRefreshUIRequired |= state.handleMidiMsg(msg, *m_presets.get(), bIgnoreProgramChange, bIsPlaying);
+            bRefreshUIRequired |= state.handleMidiMsg(msg, *m_presetSet, bIgnoreProgramChange, bIsPlaying);
         }
     }
 
@@ -248,35 +384,93 @@ void Processor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&
     margs.samplesPerBufferForComputation = getNumSamplesForComputation(getSampleRate());
     margs.samplesPerBufferInv = 1.0f / static_cast<float>(margs.samplesPerBufferForComputation);
 
-    ForEachMidiChannel([&](auto& state)
+    ForEachMidiChannelParallel([&](auto& state)
     {
+        state.getTimes() = ChannelTimes();
+
+        ScopedPerfTimer timer(state.getTimes().render);
         state.process(numSamples, margs);
     });
 
+    // Voices come from the shared pool: note-ons are handled here, and rendered with the channel below
     if (!pendingNotesOn.empty())
     {
+        GSVST_TRACE_SCOPE("noteOns");
         for (auto& noteOn : pendingNotesOn)
         {
             auto& state = GetChannelState(noteOn.channel);
             state.allocateIfNecessary(numSamples);
 
+            if (state.hasPreset() && m_voicePool.isFull(state.getType()))
+                stealOldestVoice(state.getType());
+
             auto offset = (int)std::round(noteOn.timestamp);
             if (auto* newChan = state.handleNoteOn(noteOn.noteNumber, noteOn.velocity, offset, detectedBPM))
             {
-                newChan->processCommon(state.getOutBuffer().data() + offset, numSamples - offset, margs);
+                state.addNewInstrument(newChan, offset);
+                numNewVoices++;
             }
         }
     }
 
+    auto* sharedReverb = m_bSharedReverb ? &m_sharedReverb : nullptr;
+
+    ForEachMidiChannelParallel([&](auto& state)
+    {
+        {
+            GSVST_TRACE_SCOPE("processNewInstruments");
+            ScopedPerfTimer timer(state.getTimes().render);
+            state.processNewInstruments(numSamples, margs);
+        }
+
+        ScopedPerfTimer timer(state.getTimes().reverb);
+        state.processReverb(numSamples, margs.samplesPerBufferForComputation, sharedReverb != nullptr);
+    });
+
+    // Summed in channel order, as without the render threads
     ForEachMidiChannel([&](auto& state)
     {
-        state.processReverb(numSamples, margs.samplesPerBufferForComputation, buffer);
+        GSVST_TRACE_SCOPE("mixTo");
+        state.mixTo(numSamples, buffer, sharedReverb);
     });
 
+    double sharedReverbTime = 0.0;
+    if (sharedReverb)
+    {
+        ScopedPerfTimer timer(sharedReverbTime);
+        sharedReverb->process(numSamples, margs.samplesPerBufferForComputation, buffer);
+    }
+
     ForEachMidiChannel([](auto& state)
     {
         state.cleanupDeadInstruments();
     });
+
+    publishPerformanceStats(blockStart, numSamples, sharedReverbTime, numNewVoices);
+}
+
+void Processor::publishPerformanceStats(std::chrono::steady_clock::time_point blockStart, int numSamples, double sharedReverbTime, uint32_t numNewVoices)
+{
+    BlockPerf perf;
+    perf.deadline = numSamples / getSampleRate();
+    perf.reverbTime = sharedReverbTime;
+    perf.numNewVoices = numNewVoices;
+    perf.numPoolOverflows = m_voicePool.getNumOverflows();
+
+    for (int i = 0; i < MAX_MIDI_CHANNELS; i++)
+    {
+        auto& state = *m_channels[i];
+        const auto& times = state.getTimes();
+        perf.channelTimes[i] = times.render + times.reverb;
+        perf.reverbTime += times.reverb;
+        perf.numStolenVoices += state.getNumStolenVoices();
+
+        for (const auto& voice : state.getPlayingInstruments())
+            perf.numVoices[static_cast<size_t>(voice.instr->getType())]++;
+    }
+
+    perf.blockTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+    m_perfStats.publish(perf);
 }
 
 //==============================================================================
@@ -303,7 +497,7 @@ bool Processor::dataRefreshRequired()
 
 bool Processor::presetsRefreshRequired()
 {
-    if (bRefreshPresetsRequired)
+    if (m_presets->presetSetChanged() || bRefreshPresetsRequired)
     {
         bRefreshPresetsRequired = false;
         return true;
@@ -319,48 +513,66 @@ void Processor::setPresetsRefresh()
 
 void Processor::setSoundfont(const std::string& path)
 {
-    // Make sure nothing is already playing
-    killAll();
-
     m_presets->setSoundfont(path);
-    bRefreshPresetsRequired = true;
 }
 
 void Processor::setAutoReplaceGSSynths(bool bEnable)
 {
-    killAll();
-
     m_presets->setAutoReplaceGSSynths(bEnable);
 }
 
 void Processor::setAutoReplaceGBSynths(bool bEnable)
 {
-    killAll();
-
     m_presets->setAutoReplaceGBSynths(bEnable);
 }
 
 void Processor::setHideUnknownInstruments(bool bHide)
 {
-    killAll();
-
     m_presets->setHideUnknownInstruments(bHide);
 }
 
-void Processor::setSelectedGame(const std::string& gameName)
+void Processor::setMappedSoundfont(bool bMapped)
 {
-    killAll();
+    m_presets->setMappedSoundfont(bMapped);
+}
 
+bool Processor::getMappedSoundfont() const
+{
+    return m_presets->getMappedSoundfont();
+}
+
+void Processor::setSelectedGame(const std::string& gameName)
+{
     m_presets->setSelectedGame(gameName);
 }
 
-void Processor::killAll()
+void Processor::updatePresetSet()
 {
+    const auto* presetSet = m_presets->getPublishedPresetSet();
+    if (presetSet == m_presetSet)
+        return;
+
+    // Voices only read the soundfont samples: they keep playing if the new set uses the same ones
+    const bool bSameSamples = (m_presetSet && m_presetSet->m_soundfont == presetSet->m_soundfont);
+
     ForEachMidiChannel([&](auto& state)
     {
-        state.killAllPlayingInstruments();
-        state.resetPreset();
+        if (bSameSamples)
+        {
+            state.remapPreset(*presetSet);
+        }
+        else
+        {
+            state.killAllPlayingInstruments();
+            state.cleanupDeadInstruments();
+            state.resetPreset();
+        }
     });
+
+    // Nothing refers to the previous set anymore, it can be freed
+    m_presetSet = presetSet;
+    m_presets->acknowledgePresetSet(presetSet);
+    bRefreshUIRequired = true;
 }
 
 
@@ -369,12 +581,16 @@ void Processor::getStateInformation (juce::MemoryBlock& destData)
 {
     juce::XmlElement root("plugin_data");
     root.setAttribute("version", 0.2);
-    root.setAttribute("autoreplacegssynths", m_presets->m_bAutoReplaceGSSynthsEnabled);
-    root.setAttribute("autoreplacegbsynths", m_presets->m_bAutoReplaceGBSynthsEnabled);
-    root.setAttribute("hideunknowninstruments", m_presets->m_bHideUnknownInstruments);
-    root.setAttribute("gamename", m_presets->m_selectedGame);
-    root.setAttribute("soundfont", m_presets->soundFontPath);
+    root.setAttribute("autoreplacegssynths", m_presets->getAutoReplaceGSSynths());
+    root.setAttribute("autoreplacegbsynths", m_presets->getAutoReplaceGBSynths());
+    root.setAttribute("hideunknowninstruments", m_presets->getHideUnknownInstruments());
+    root.setAttribute("gamename", m_presets->getSelectedGame());
+    root.setAttribute("soundfont", m_presets->getSoundFontPath());
     root.setAttribute("theme", m_uiTheme);
+    root.setAttribute("sharedreverb", getSharedReverb());
+    root.setAttribute("multithreaded", getMultiThreaded());
+    root.setAttribute("mappedsoundfont", getMappedSoundfont());
+    root.setAttribute("voicepoolcapacity", getVoicePoolCapacity());
 
     copyXmlToBinary(root, destData);
 }
@@ -412,6 +628,18 @@ void Processor::setStateInformation (const void* data, int sizeInBytes)
         m_uiTheme = xmlState->getIntAttribute("theme");
     }
 
+    if (xmlState->hasAttribute("sharedreverb"))
+        setSharedReverb(xmlState->getBoolAttribute("sharedreverb"));
+
+    if (xmlState->hasAttribute("multithreaded"))
+        setMultiThreaded(xmlState->getBoolAttribute("multithreaded"));
+
+    if (xmlState->hasAttribute("mappedsoundfont"))
+        setMappedSoundfont(xmlState->getBoolAttribute("mappedsoundfont"));
+
+    if (xmlState->hasAttribute("voicepoolcapacity"))
+        setVoicePoolCapacity(xmlState->getIntAttribute("voicepoolcapacity"));
+
     auto path = std::string(xmlState->getStringAttribute("soundfont").getCharPointer());
     setSoundfont(path);
 
@@ -1,14 +1,25 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <atomic>
 #include "Types.h"
 #include "ChannelState.h"
+#include "FixedVector.h"
+#include "PerformanceStats.h"
+#include "RenderThreadPool.h"
+#include "ScratchArena.h"
+#include "SharedReverb.h"
+#include "SPSCQueue.h"
+#include "VoicePool.h"
 
 
 
+#define CHANNEL_COMMAND_QUEUE_SIZE 1024
+
 namespace GSVST {
 
 struct PresetsHandler;
+struct PresetSet;
 
 class Processor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
@@ -52,10 +63,27 @@ public:
 
     double getDetectedBPM() const { return detectedBPM; }
 
+    PerformanceStats& getPerformanceStats() { return m_perfStats; }
+
     ChannelState& GetChannelState(int midiChannel) { return *(m_channels[midiChannel]); }
 
+    // Editor changes, from the message thread only. Queued and applied at the start of the next block
+    void pushChannelCommand(const ChannelCommand& command);
+    void setChannelPreset(int midiChannel, int bankId, int programId);
     void applyReverbToAllChannels(EReverbType type);
 
+    // One reverb per type for all the channels instead of one per channel
+    void setSharedReverb(bool bEnable) { m_bSharedReverb = bEnable; }
+    bool getSharedReverb() const { return m_bSharedReverb; }
+
+    // Renders the midi channels on worker threads. The output is the same as without
+    void setMultiThreaded(bool bEnable);
+    bool getMultiThreaded() const { return m_bMultiThreaded; }
+
+    // Voices of each type for all the channels. Message thread: the pools are rebuilt, stopping the playing voices
+    void setVoicePoolCapacity(int capacity);
+    int getVoicePoolCapacity() const { return m_voicePoolCapacity; }
+
     bool dataRefreshRequired();
     bool presetsRefreshRequired();
     void setPresetsRefresh();
@@ -64,6 +92,9 @@ public:
     void setAutoReplaceGSSynths(bool bEnable);
     void setAutoReplaceGBSynths(bool bEnable);
     void setHideUnknownInstruments(bool bHide);
+    // Reads the soundfont samples from a memory-mapped file instead of loading them
+    void setMappedSoundfont(bool bMapped);
+    bool getMappedSoundfont() const;
     void setSelectedGame(const std::string& gameName);
 
     void setIgnoreProgramChange(bool in_ignore) { bIgnoreProgramChange = in_ignore; }
@@ -73,7 +104,13 @@ public:
 private:
     int getNumSamplesForComputation(double sampleRate);
 
-    void killAll();
+    // Switches to the latest preset set, stopping the voices playing samples of the previous one
+    void updatePresetSet();
+    void applyChannelCommands();
+    void prepareVoicePool();
+    // A pool is shared by all the channels: its oldest voice makes room for a note-on of the same type
+    void stealOldestVoice(EDSPType type);
+    void publishPerformanceStats(std::chrono::steady_clock::time_point blockStart, int numSamples, double sharedReverbTime, uint32_t numNewVoices);
 
     template<typename T>
     void ForEachMidiChannel(T func)
@@ -84,11 +121,49 @@ private:
         }
     }
 
+    // Same on the render threads if enabled, func must only touch the channel it is given
+    template<typename T>
+    void ForEachMidiChannelParallel(T func)
+    {
+        if (!m_bMultiThreaded)
+        {
+            ForEachMidiChannel(func);
+            return;
+        }
+
+        struct Context
+        {
+            Processor* processor;
+            T* func;
+        } context { this, &func };
+
+        m_renderPool.run(MAX_MIDI_CHANNELS, [](void* data, size_t channelId)
+        {
+            auto* ctx = static_cast<Context*>(data);
+            (*ctx->func)(*ctx->processor->m_channels[channelId]);
+        }, &context);
+    }
+
     int detectedBPM = 120;
     double currentTime = 0.0;
+
+    VoicePool m_voicePool;
+    int m_voicePoolCapacity = DEFAULT_VOICE_POOL_CAPACITY;
     ChannelState* m_channels[MAX_MIDI_CHANNELS];
 
+    ScratchArena m_scratchArena;
+    SharedReverb m_sharedReverb;
+    std::atomic<bool> m_bSharedReverb { false };
+
+    RenderThreadPool m_renderPool;
+    std::atomic<bool> m_bMultiThreaded { false };
+
+    PerformanceStats m_perfStats;
+
     std::unique_ptr<PresetsHandler> m_presets;
+    const PresetSet* m_presetSet = nullptr;
+
+    SPSCQueue<ChannelCommand, CHANNEL_COMMAND_QUEUE_SIZE> m_channelCommands;
     uint8_t m_uiTheme = 1;
 
     volatile bool bRefreshUIRequired = false;
@@ -98,6 +173,7 @@ private:
 
     struct PendingNoteOn
     {
+        PendingNoteOn() = default;
         PendingNoteOn(double in_time, uint8_t in_note, int in_chan, unsigned char in_vel)
             : timestamp(in_time)
             , noteNumber(in_note)
@@ -105,13 +181,13 @@ private:
             , velocity(in_vel)
         {}
 
-        double timestamp;
-        uint8_t noteNumber;
-        int channel;
-        unsigned char velocity;
+        double timestamp = 0.0;
+        uint8_t noteNumber = 0;
+        int channel = 0;
+        unsigned char velocity = 0;
     };
 
-    std::vector<PendingNoteOn> pendingNotesOn;
+    FixedVector<PendingNoteOn, MAX_PENDING_NOTE_ONS> pendingNotesOn;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Processor)
 };
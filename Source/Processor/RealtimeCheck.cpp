@@ -0,0 +1,424 @@
+#include "RealtimeCheck.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace GSVST {
+namespace RealtimeCheck {
+
+#if GSVST_RT_CHECKS
+
+// Constant initialized: the allocator can be called before the static constructors run
+struct ViolationSite
+{
+    std::atomic<const char*> name { nullptr };
+    std::atomic<uint64_t> counts[NUM_RT_VIOLATION_TYPES] = {};
+};
+
+static ViolationSite s_sites[RT_CHECK_MAX_SITES];
+static ViolationSite s_otherSites;
+static std::atomic<uint64_t> s_numViolations { 0 };
+// -1 until the environment is read
+static std::atomic<int> s_abortOnViolation { -1 };
+
+static thread_local int t_realtimeDepth = 0;
+static thread_local const char* t_site = nullptr;
+// Set while a violation is counted, so that the allocations of the abort message aren't
+static thread_local bool t_bInCheck = false;
+
+static const char* s_violationNames[NUM_RT_VIOLATION_TYPES] = { "allocation", "deallocation", "lock" };
+
+static ViolationSite& findSite(const char* name)
+{
+    for (auto& site : s_sites)
+    {
+        const char* siteName = site.name.load(std::memory_order_acquire);
+        if (siteName == nullptr)
+        {
+            if (site.name.compare_exchange_strong(siteName, name, std::memory_order_acq_rel))
+                return site;
+        }
+
+        // The same literal can have different addresses in different translation units
+        if (siteName == name || std::strcmp(siteName, name) == 0)
+            return site;
+    }
+
+    return s_otherSites;
+}
+
+static bool shouldAbort()
+{
+    int mode = s_abortOnViolation.load(std::memory_order_relaxed);
+    if (mode < 0)
+    {
+        const char* env = std::getenv("GSVST_RT_ABORT");
+        mode = (env && std::strcmp(env, "0") != 0) ? 1 : 0;
+        s_abortOnViolation.store(mode, std::memory_order_relaxed);
+    }
+
+    return mode == 1;
+}
+
+bool isEnabled()
+{
+    return true;
+}
+
+void onViolation(ERealtimeViolation type)
+{
+    if (t_realtimeDepth == 0 || t_bInCheck)
+        return;
+
+    t_bInCheck = true;
+
+    const char* siteName = t_site ? t_site : "untagged";
+    findSite(siteName).counts[static_cast<size_t>(type)].fetch_add(1, std::memory_order_relaxed);
+    s_numViolations.fetch_add(1, std::memory_order_relaxed);
+
+    if (shouldAbort())
+    {
+        std::fprintf(stderr, "Real-time violation: %s in %s\n", s_violationNames[static_cast<size_t>(type)], siteName);
+        std::abort();
+    }
+
+    t_bInCheck = false;
+}
+
+void setAbortOnViolation(bool bAbort)
+{
+    s_abortOnViolation.store(bAbort ? 1 : 0, std::memory_order_relaxed);
+}
+
+uint64_t getNumViolations()
+{
+    return s_numViolations.load(std::memory_order_relaxed);
+}
+
+static uint64_t getTotal(const ViolationSite& site)
+{
+    uint64_t total = 0;
+    for (const auto& count : site.counts)
+        total += count.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+const char* getWorstSite()
+{
+    const char* worst = nullptr;
+    uint64_t worstTotal = 0;
+
+    for (const auto& site : s_sites)
+    {
+        const char* name = site.name.load(std::memory_order_acquire);
+        if (name == nullptr)
+            break;
+
+        if (const auto total = getTotal(site); total > worstTotal)
+        {
+            worst = name;
+            worstTotal = total;
+        }
+    }
+
+    if (getTotal(s_otherSites) > worstTotal)
+        worst = "other";
+
+    return worst;
+}
+
+std::string getReport()
+{
+    std::string report;
+
+    auto addSite = [&](const char* name, const ViolationSite& site)
+    {
+        if (getTotal(site) == 0)
+            return;
+
+        report += name;
+        for (size_t i = 0; i < NUM_RT_VIOLATION_TYPES; i++)
+        {
+            report += (i == 0 ? ": " : ", ");
+            report += std::to_string(site.counts[i].load(std::memory_order_relaxed)) + " " + s_violationNames[i];
+        }
+        report += "\n";
+    };
+
+    for (const auto& site : s_sites)
+    {
+        const char* name = site.name.load(std::memory_order_acquire);
+        if (name == nullptr)
+            break;
+
+        addSite(name, site);
+    }
+
+    addSite("other", s_otherSites);
+    return report;
+}
+
+void reset()
+{
+    // The names are kept: a site being cleared could be found again by a real-time thread meanwhile
+    for (auto& site : s_sites)
+    {
+        for (auto& count : site.counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto& count : s_otherSites.counts)
+        count.store(0, std::memory_order_relaxed);
+
+    s_numViolations.store(0, std::memory_order_relaxed);
+}
+
+void enterRealtime()
+{
+    t_realtimeDepth++;
+}
+
+void exitRealtime()
+{
+    t_realtimeDepth--;
+}
+
+const char* setSite(const char* site)
+{
+    const char* previous = t_site;
+    t_site = site;
+    return previous;
+}
+
+#else
+
+bool isEnabled()
+{
+    return false;
+}
+
+void onViolation(ERealtimeViolation /*type*/)
+{
+}
+
+void setAbortOnViolation(bool /*bAbort*/)
+{
+}
+
+uint64_t getNumViolations()
+{
+    return 0;
+}
+
+const char* getWorstSite()
+{
+    return nullptr;
+}
+
+std::string getReport()
+{
+    return {};
+}
+
+void reset()
+{
+}
+
+void enterRealtime()
+{
+}
+
+void exitRealtime()
+{
+}
+
+const char* setSite(const char* site)
+{
+    return site;
+}
+
+#endif
+
+}
+}
+
+#if GSVST_RT_CHECKS
+
+using GSVST::ERealtimeViolation;
+using GSVST::RealtimeCheck::onViolation;
+
+#if defined(__GLIBC__)
+
+// glibc's allocator is replaced at the C level, which operator new and the C libraries go through.
+// Only effective when the code is linked in the executable, as in RealtimeRenderTest, not in a plugin loaded by the host
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void __libc_free(void* ptr);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) noexcept
+{
+    onViolation(ERealtimeViolation::Allocation);
+    return __libc_malloc(size);
+}
+
+void free(void* ptr) noexcept
+{
+    if (ptr)
+        onViolation(ERealtimeViolation::Deallocation);
+
+    __libc_free(ptr);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    onViolation(ERealtimeViolation::Allocation);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    onViolation(ERealtimeViolation::Allocation);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    onViolation(ERealtimeViolation::Allocation);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    onViolation(ERealtimeViolation::Allocation);
+    void* result = __libc_memalign(alignment, size);
+    if (!result)
+        return ENOMEM;
+
+    *ptr = result;
+    return 0;
+}
+
+}
+
+#else
+
+// Elsewhere only the C++ allocations are seen, which covers the standard containers
+
+static void* allocate(std::size_t size)
+{
+    onViolation(ERealtimeViolation::Allocation);
+    return std::malloc(size ? size : 1);
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    onViolation(ERealtimeViolation::Allocation);
+#if defined(_WIN32)
+    return _aligned_malloc(size ? size : 1, static_cast<std::size_t>(alignment));
+#else
+    void* ptr = nullptr;
+    const auto align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    return posix_memalign(&ptr, align, size ? size : 1) == 0 ? ptr : nullptr;
+#endif
+}
+
+static void deallocate(void* ptr)
+{
+    if (ptr)
+        onViolation(ERealtimeViolation::Deallocation);
+
+    std::free(ptr);
+}
+
+static void deallocateAligned(void* ptr)
+{
+    if (ptr)
+        onViolation(ERealtimeViolation::Deallocation);
+
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void* operator new(std::size_t size)
+{
+    if (auto* ptr = allocate(size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (auto* ptr = allocateAligned(size, alignment))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { deallocateAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { deallocateAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { deallocateAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { deallocateAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { deallocateAligned(ptr); }
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Set by the ENABLE_RT_CHECKS CMake option, for debug and CI builds. Without it the checks compile to nothing
+#ifndef GSVST_RT_CHECKS
+#define GSVST_RT_CHECKS 0
+#endif
+
+// Call sites with their own counters, the other ones being counted together
+#define RT_CHECK_MAX_SITES 64
+
+namespace GSVST {
+
+enum class ERealtimeViolation : uint8_t { Allocation = 0, Deallocation, Lock };
+#define NUM_RT_VIOLATION_TYPES 3
+
+/*
+ * Detection of the calls that can block the real-time threads: the audio thread in processBlock,
+ * and the render workers while they run its tasks.
+ * Allocations are caught by replacing the allocator (malloc and co with glibc, operator new and delete
+ * elsewhere), locks by the mutexes of the processor and presets being CheckedMutex.
+ * Violations are counted per call site, the site being the innermost GSVST_TRACE_SCOPE.
+ */
+namespace RealtimeCheck {
+
+bool isEnabled();
+
+// Counted if the calling thread is real-time. Never allocates
+void onViolation(ERealtimeViolation type);
+
+// Aborts on the first violation, so that an automated run fails with the offending stack.
+// Also set by the GSVST_RT_ABORT environment variable
+void setAbortOnViolation(bool bAbort);
+
+uint64_t getNumViolations();
+// Site with the most violations, nullptr if none
+const char* getWorstSite();
+// One line per site with its counts. Not for the real-time threads
+std::string getReport();
+void reset();
+
+// Thread state, see RealtimeScope and RealtimeTagScope
+void enterRealtime();
+void exitRealtime();
+const char* setSite(const char* site);
+
+}
+
+// The current thread is real-time until the end of the scope. Can be nested
+class RealtimeScope
+{
+public:
+    RealtimeScope() { RealtimeCheck::enterRealtime(); }
+    ~RealtimeScope() { RealtimeCheck::exitRealtime(); }
+};
+
+// Names the call site of the violations in the scope
+class RealtimeTagScope
+{
+public:
+    RealtimeTagScope(const char* in_site)
+        : m_previousSite(RealtimeCheck::setSite(in_site))
+    {}
+
+    ~RealtimeTagScope() { RealtimeCheck::setSite(m_previousSite); }
+
+private:
+    const char* m_previousSite;
+};
+
+// std::mutex reporting the locks taken by a real-time thread. Not usable with std::condition_variable
+class CheckedMutex : public std::mutex
+{
+public:
+    void lock()
+    {
+#if GSVST_RT_CHECKS
+        RealtimeCheck::onViolation(ERealtimeViolation::Lock);
+#endif
+        std::mutex::lock();
+    }
+};
+
+}
+
+#if GSVST_RT_CHECKS
+#define GSVST_RT_CONCAT_IMPL(a, b) a##b
+#define GSVST_RT_CONCAT(a, b) GSVST_RT_CONCAT_IMPL(a, b)
+#define GSVST_RT_SCOPE() GSVST::RealtimeScope GSVST_RT_CONCAT(realtimeScope_, __LINE__)
+#define GSVST_RT_TAG(site) GSVST::RealtimeTagScope GSVST_RT_CONCAT(realtimeTag_, __LINE__)(site)
+#else
+#define GSVST_RT_SCOPE()
+#define GSVST_RT_TAG(site)
+#endif
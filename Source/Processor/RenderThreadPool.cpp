@@ -0,0 +1,143 @@
+#include "RenderThreadPool.h"
+#include "RealtimeCheck.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+namespace GSVST {
+
+// m_nextTask layout: generation (32 bits) | number of tasks (16 bits) | next task id (16 bits)
+static uint64_t packTasks(uint32_t generation, size_t numTasks, size_t nextTask)
+{
+    return (uint64_t(generation) << 32) | (uint64_t(numTasks) << 16) | uint64_t(nextTask);
+}
+
+static uint32_t getGeneration(uint64_t tasks) { return uint32_t(tasks >> 32); }
+static size_t getNumTasks(uint64_t tasks) { return size_t((tasks >> 16) & RENDER_POOL_MAX_TASKS); }
+static size_t getTaskId(uint64_t tasks) { return size_t(tasks & RENDER_POOL_MAX_TASKS); }
+
+RenderThreadPool::~RenderThreadPool()
+{
+    stop();
+}
+
+void RenderThreadPool::start(size_t numWorkers)
+{
+    stop();
+
+    m_bRunning = true;
+    m_workers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; i++)
+    {
+        auto& worker = m_workers.emplace_back(std::make_unique<Worker>(*this));
+
+        // Without the rights for it (e.g. Linux without rtkit), the best the OS gives
+        if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions().withPriority(RENDER_WORKER_PRIORITY)))
+            worker->startThread(juce::Thread::Priority::highest);
+    }
+}
+
+void RenderThreadPool::stop()
+{
+    if (m_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_bRunning = false;
+    }
+    m_wakeUp.notify_all();
+
+    // A worker finishes the task it has taken before leaving, a run in progress completes without it
+    for (auto& worker : m_workers)
+        worker->stopThread(-1);
+
+    m_workers.clear();
+}
+
+size_t RenderThreadPool::getDefaultNumWorkers(size_t maxTasks)
+{
+    const size_t numCores = std::max(std::thread::hardware_concurrency(), 2u);
+    return std::max<size_t>(std::min(numCores, maxTasks) - 1, 1);
+}
+
+void RenderThreadPool::run(size_t numTasks, task_func func, void* context)
+{
+    assert(numTasks <= RENDER_POOL_MAX_TASKS);
+    if (numTasks == 0)
+        return;
+
+    // All the tasks of the previous run are done: nobody reads these until the new generation is published
+    m_func = func;
+    m_context = context;
+    m_numDone.store(0, std::memory_order_relaxed);
+
+    const uint32_t generation = getGeneration(m_nextTask.load(std::memory_order_relaxed)) + 1;
+    m_nextTask.store(packTasks(generation, numTasks, 0), std::memory_order_release);
+
+    // Without the mutex: a worker missing the notification just sleeps through this run
+    if (m_numSleeping.load() > 0)
+        m_wakeUp.notify_all();
+
+    runTasks(generation);
+
+    while (m_numDone.load(std::memory_order_acquire) < numTasks)
+        std::this_thread::yield();
+}
+
+void RenderThreadPool::runTasks(uint32_t generation)
+{
+    GSVST_RT_SCOPE();
+
+    uint64_t tasks = m_nextTask.load(std::memory_order_acquire);
+    while (getGeneration(tasks) == generation && getTaskId(tasks) < getNumTasks(tasks))
+    {
+        if (!m_nextTask.compare_exchange_weak(tasks, tasks + 1, std::memory_order_acq_rel))
+            continue;
+
+        m_func(m_context, getTaskId(tasks));
+        m_numDone.fetch_add(1, std::memory_order_release);
+
+        tasks = m_nextTask.load(std::memory_order_acquire);
+    }
+}
+
+void RenderThreadPool::workerLoop()
+{
+    // Same float behaviour as the audio thread
+    juce::ScopedNoDenormals noDenormals;
+
+    uint32_t lastGeneration = getGeneration(m_nextTask.load(std::memory_order_acquire));
+    auto lastRun = std::chrono::steady_clock::now();
+
+    while (m_bRunning)
+    {
+        const auto generation = getGeneration(m_nextTask.load(std::memory_order_acquire));
+        if (generation != lastGeneration)
+        {
+            lastGeneration = generation;
+            runTasks(generation);
+            lastRun = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() - lastRun < std::chrono::microseconds(RENDER_WORKER_SPIN_US))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_numSleeping++;
+        // The timeout covers a notification sent between the check and the wait
+        m_wakeUp.wait_for(lock, std::chrono::milliseconds(10), [&]
+        {
+            return !m_bRunning || getGeneration(m_nextTask.load(std::memory_order_acquire)) != lastGeneration;
+        });
+        m_numSleeping--;
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+#define RENDER_POOL_MAX_TASKS 0xFFFF
+// How long an idle worker spins for the next run before going to sleep
+#define RENDER_WORKER_SPIN_US 2000
+// Real-time priority of the workers (0-10), just under the audio thread they work for
+#define RENDER_WORKER_PRIORITY 9
+
+/*
+ * Persistent worker threads for the audio thread to render independent tasks (the midi channels) in parallel.
+ * Tasks are handed out through one shared counter that every thread takes the next id from: there's no
+ * per-thread queue nor work stealing.
+ * run() never locks nor allocates: the caller takes tasks like the workers do, so it finishes on its own
+ * if the workers are late, asleep or stopped. It still has to wait for the tasks already taken, which is
+ * why the workers are real-time threads: a preempted worker would stall the audio callback behind it.
+ * Idle workers spin for a while, then sleep until the next run.
+ */
+class RenderThreadPool
+{
+public:
+    typedef void (*task_func)(void* context, size_t taskId);
+
+    RenderThreadPool() = default;
+    RenderThreadPool(const RenderThreadPool&) = delete;
+    RenderThreadPool& operator=(const RenderThreadPool&) = delete;
+    ~RenderThreadPool();
+
+    // Not to be called from the audio thread
+    void start(size_t numWorkers);
+    void stop();
+    size_t getNumWorkers() const { return m_workers.size(); }
+
+    // Calls func for every task id in [0, numTasks), returns once all of them are done.
+    // numTasks must not exceed RENDER_POOL_MAX_TASKS
+    void run(size_t numTasks, task_func func, void* context);
+
+    // One worker per core, the audio thread being the last one
+    static size_t getDefaultNumWorkers(size_t maxTasks);
+
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(RenderThreadPool& in_pool)
+            : juce::Thread("GSVST render worker")
+            , m_pool(in_pool)
+        {}
+
+        void run() override { m_pool.workerLoop(); }
+
+    private:
+        RenderThreadPool& m_pool;
+    };
+
+    void workerLoop();
+    // Runs tasks of the given generation until there's none left
+    void runTasks(uint32_t generation);
+
+    // Generation of the current run, its number of tasks and the next task id, taken with a CAS
+    std::atomic<uint64_t> m_nextTask { 0 };
+    std::atomic<size_t> m_numDone { 0 };
+
+    // Only written by run() before a new generation is published, when no task can be taken
+    task_func m_func = nullptr;
+    void* m_context = nullptr;
+
+    std::atomic<bool> m_bRunning { false };
+    std::atomic<int> m_numSleeping { 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+};
+
+}
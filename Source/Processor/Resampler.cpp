@@ -1,4 +1,9 @@
 #include "Resampler.h"
+#include "DSPKernels.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace GSVST {
 
@@ -11,11 +16,47 @@ namespace GSVST {
 
 #define INTEGRAL_RESOLUTION 256
 
+// Polyphase kernel bank
+#define KERNEL_SIZE (SINC_WINDOW_SIZE * 2)
+#define KERNEL_PHASES 128
+#define KERNEL_RATIOS_PER_OCTAVE 6
+// Pattern frequency range of the CGB channels (8 steps per period): lowest MIDI note, and highest GB timer value
+#define KERNEL_MIN_FREQ 64.0
+#define KERNEL_MAX_FREQ 131072.0
+
+static_assert(KERNEL_SIZE == 32, "DSPKernels::blendedDot32 expects 32 taps");
+
+// Interpolation positions are computed in chunks of this size before running the kernel
+#define INTERPOLATION_CHUNK 64
+
 
 Resampler::~Resampler()
 {
 }
 
+size_t Resampler::getMaxBlocks(float phaseInc, size_t extraSamples) const
+{
+    // Same estimate as samplesRequired in Process, with the extra rounding sample
+    const float available = static_cast<float>(FetchWindow::capacity() - extraSamples - 1) - phase;
+    const auto maxBlocks = static_cast<size_t>(std::max(available / phaseInc, 1.0f));
+    assert(phase + phaseInc * static_cast<float>(maxBlocks) + extraSamples + 1 <= FetchWindow::capacity());
+    return maxBlocks;
+}
+
+bool Resampler::fetch(size_t samplesRequired, res_data_fetch_cb cbPtr, void* cbdata)
+{
+    if (!endOfStream)
+    {
+        endOfStream = !cbPtr(fetchBuffer, samplesRequired, cbdata);
+        return !endOfStream;
+    }
+
+    while (fetchBuffer.size() < samplesRequired)
+        fetchBuffer.push(0.0f, 0.0f);
+
+    return false;
+}
+
 LinearResampler::LinearResampler()
 {
     Reset();
@@ -29,43 +70,146 @@ void LinearResampler::Reset()
 {
     fetchBuffer.clear();
     phase = 0.0f;
+    endOfStream = false;
 }
 
-bool LinearResampler::Process(sample *outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
+bool LinearResampler::Process(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
 {
+    GSVST_TRACE_SCOPE("LinearResampler::Process");
+
     if (numBlocks == 0)
         return true;
 
+    // The fetch window has a fixed size, so high pitches are computed in several passes
+    bool result = true;
+    while (numBlocks > 0)
+    {
+        const size_t blocks = std::min(numBlocks, getMaxBlocks(phaseInc, 1));
+        result = ProcessWindow(outData, blocks, phaseInc, cbPtr, cbdata) && result;
+        outData += blocks;
+        numBlocks -= blocks;
+    }
+
+    return result;
+}
+
+bool LinearResampler::ProcessWindow(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
+{
     size_t samplesRequired = static_cast<size_t>(
             phase + phaseInc * static_cast<float>(numBlocks));
     // be sure and fetch one more sample in case of odd rounding errors
     samplesRequired += 1;
     // fetch one more for linear interpolation
     samplesRequired += 1;
-    bool result = cbPtr(fetchBuffer, samplesRequired, cbdata);
+    bool result = fetch(samplesRequired, cbPtr, cbdata);
 
-    auto getSample = [&](float& a, float& b)
-    {
-        return (a + phase * (b - a));
-    };
+    const sample* window = fetchBuffer.data();
+    const auto& kernels = getDSPKernels();
+
+    uint32_t positions[INTERPOLATION_CHUNK];
+    float fracs[INTERPOLATION_CHUNK];
 
     int i = 0;
     do {
-        float sampleLeft = getSample(fetchBuffer[i].left, fetchBuffer[i + 1].left);
-        float sampleRight = getSample(fetchBuffer[i].right, fetchBuffer[i + 1].right);
+        const size_t chunkSize = std::min(numBlocks, size_t(INTERPOLATION_CHUNK));
+        for (size_t k = 0; k < chunkSize; k++)
+        {
+            positions[k] = static_cast<uint32_t>(i);
+            fracs[k] = phase;
+
+            phase += phaseInc;
+            int istep = static_cast<int>(phase);
+            phase -= static_cast<float>(istep);
+            i += istep;
+        }
+
+        kernels.interpolate(outData, window, positions, fracs, chunkSize);
+        outData += chunkSize;
+        numBlocks -= chunkSize;
+    } while (numBlocks > 0);
+
+    // first i elements of the fetch window are no longer needed
+    fetchBuffer.consume(i);
+
+    return result;
+}
+
+// Read positions of up to chunkSize output samples of a DirectSource, stops early at the end of a one-shot source
+template <bool bLoop>
+static size_t computeDirectPositions(uint32_t* positions, float* fracs, size_t chunkSize, float& phase, float phaseInc,
+    uint32_t& pos, uint32_t endPos, uint32_t loopLength)
+{
+    size_t k = 0;
+    while (k < chunkSize && pos < endPos)
+    {
+        // data[endPos] is a guard sample
+        positions[k] = pos;
+        fracs[k] = phase;
+        k++;
 
         phase += phaseInc;
         int istep = static_cast<int>(phase);
         phase -= static_cast<float>(istep);
-        i += istep;
+        pos += istep;
 
-        outData->left = sampleLeft;
-        outData->right = sampleRight;
-        outData++;
-    } while (--numBlocks > 0);
+        if (bLoop)
+        {
+            while (pos >= endPos)
+                pos -= loopLength;
+        }
+    }
+
+    return k;
+}
+
+bool LinearResampler::ProcessDirect(float* outData, size_t numBlocks, float phaseInc, const DirectSource& source, uint32_t& pos)
+{
+    GSVST_TRACE_SCOPE("LinearResampler::ProcessDirect");
+
+    if (numBlocks == 0)
+        return true;
+
+    // same end of stream detection as the fetch callback
+    size_t samplesRequired = static_cast<size_t>(
+            phase + phaseInc * static_cast<float>(numBlocks));
+    samplesRequired += 2;
+    bool result = source.loopEnabled || pos + samplesRequired < source.endPos;
+
+    const uint32_t loopLength = source.endPos - source.loopPos;
+    const auto& kernels = getDSPKernels();
 
-    // remove first i elements from the fetch buffer since they are no longer needed
-    fetchBuffer.erase(fetchBuffer.begin(), fetchBuffer.begin() + i);
+    uint32_t positions[INTERPOLATION_CHUNK];
+    float fracs[INTERPOLATION_CHUNK];
+
+    do {
+        const size_t chunkSize = std::min(numBlocks, size_t(INTERPOLATION_CHUNK));
+
+        const size_t k = source.loopEnabled
+            ? computeDirectPositions<true>(positions, fracs, chunkSize, phase, phaseInc, pos, source.endPos, loopLength)
+            : computeDirectPositions<false>(positions, fracs, chunkSize, phase, phaseInc, pos, source.endPos, loopLength);
+
+        switch (source.format)
+        {
+        case ESampleFormat::Float:
+            kernels.interpolateMono(outData, static_cast<const float*>(source.data), positions, fracs, k);
+            break;
+        case ESampleFormat::Int16:
+            kernels.interpolateMonoInt16(outData, static_cast<const int16_t*>(source.data), positions, fracs, k, source.divisor);
+            break;
+        case ESampleFormat::Int8:
+            kernels.interpolateMonoInt8(outData, static_cast<const int8_t*>(source.data), positions, fracs, k, source.divisor);
+            break;
+        }
+        outData += k;
+        numBlocks -= k;
+
+        if (k < chunkSize)
+        {
+            // only without loop: the rest of the stream is silence
+            std::fill(outData, outData + numBlocks, 0.0f);
+            break;
+        }
+    } while (numBlocks > 0);
 
     return result;
 }
@@ -84,25 +228,74 @@ BlepResampler::~BlepResampler()
 void BlepResampler::Reset()
 {
     fetchBuffer.clear();
-    fetchBuffer.resize(SINC_WINDOW_SIZE, { 0.0f, 0.0f });
+    for (int i = 0; i < SINC_WINDOW_SIZE; i++)
+        fetchBuffer.push(0.0f, 0.0f);
     phase = 0.0f;
+    endOfStream = false;
 }
 
-bool BlepResampler::Process(sample* outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
+bool BlepResampler::Process(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
 {
+    GSVST_TRACE_SCOPE("BlepResampler::Process");
+
     if (numBlocks == 0)
         return true;
 
+    // The fetch window has a fixed size, so high pitches are computed in several passes
+    bool result = true;
+    while (numBlocks > 0)
+    {
+        const size_t blocks = std::min(numBlocks, getMaxBlocks(phaseInc, SINC_WINDOW_SIZE * 2));
+        result = ProcessWindow(outData, blocks, phaseInc, cbPtr, cbdata) && result;
+        outData += blocks;
+        numBlocks -= blocks;
+    }
+
+    return result;
+}
+
+bool BlepResampler::ProcessWindow(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata)
+{
     size_t samplesRequired = static_cast<size_t>(
             phase + phaseInc * static_cast<float>(numBlocks));
     // be sure and fetch one more sample in case of odd rounding errors
     samplesRequired += 1;
     // fetch a few more for complete windowed sinc interpolation
     samplesRequired += SINC_WINDOW_SIZE * 2;
-    bool result = cbPtr(fetchBuffer, samplesRequired, cbdata);
+    bool result = fetch(samplesRequired, cbPtr, cbdata);
 
     float sincStep = SINC_FILT_THRESH / phaseInc;
 
+    const sample* window = fetchBuffer.data();
+
+    if (kernelBank && kernelBank->isBuilt())
+    {
+        const float* kernels = kernelBank->getKernels(sincStep);
+        const auto& dsp = getDSPKernels();
+
+        int i = 0;
+        do {
+            // Blend of the two closest phase buckets, edges of low notes are too sharp for the nearest one
+            float kernelPhase = phase * KERNEL_PHASES;
+            int phaseId = static_cast<int>(kernelPhase);
+            float frac = kernelPhase - static_cast<float>(phaseId);
+            const float* kernelA = kernels + phaseId * KERNEL_SIZE;
+            const float* kernelB = kernelA + KERNEL_SIZE;
+
+            dsp.blendedDot32(kernelA, kernelB, frac, window + i, *outData.left, *outData.right);
+
+            phase += phaseInc;
+            int istep = static_cast<int>(phase);
+            phase -= static_cast<float>(istep);
+            i += istep;
+
+            outData += 1;
+        } while (--numBlocks > 0);
+
+        fetchBuffer.consume(i);
+        return result;
+    }
+
     int i = 0;
     do {
         float leftSampleSum = 0.0f;
@@ -114,8 +307,8 @@ bool BlepResampler::Process(sample* outData, size_t numBlocks, float phaseInc, r
             float sl = fast_Si(SiIndexLeft);
             float sr = fast_Si(SiIndexRight);
             float kernel = sr - sl;
-            leftSampleSum += kernel * fetchBuffer[i + wi + SINC_WINDOW_SIZE - 1].left;
-            rightSampleSum += kernel * fetchBuffer[i + wi + SINC_WINDOW_SIZE - 1].right;
+            leftSampleSum += kernel * window[i + wi + SINC_WINDOW_SIZE - 1].left;
+            rightSampleSum += kernel * window[i + wi + SINC_WINDOW_SIZE - 1].right;
             kernelSum += kernel;
         }
         phase += phaseInc;
@@ -123,14 +316,14 @@ bool BlepResampler::Process(sample* outData, size_t numBlocks, float phaseInc, r
         phase -= static_cast<float>(istep);
         i += istep;
 
-        outData->left = leftSampleSum / kernelSum;
-        outData->right = rightSampleSum / kernelSum;
-        outData++;
+        *outData.left = leftSampleSum / kernelSum;
+        *outData.right = rightSampleSum / kernelSum;
+        outData += 1;
         //*outData++ = sampleSum;
         //_print_debug("kernel sum: %f\n", kernelSum);
     } while (--numBlocks > 0);
-    // remove first i elements from the fetch buffer since they are no longer needed
-    fetchBuffer.erase(fetchBuffer.begin(), fetchBuffer.begin() + i);
+    // first i elements of the fetch window are no longer needed
+    fetchBuffer.consume(i);
 
     return result;
 }
@@ -177,4 +370,52 @@ float BlepResampler::fast_Si(float t)
     return copysignf(retval, signed_t);
 }
 
+void BlepKernelBank::build(double sampleRate)
+{
+    m_sampleRate = sampleRate;
+
+    // sincStep = SINC_FILT_THRESH / phaseInc, with phaseInc = freq / sampleRate
+    const double minLog2Step = std::floor(std::log2(SINC_FILT_THRESH * sampleRate / KERNEL_MAX_FREQ));
+    const double maxLog2Step = std::ceil(std::log2(SINC_FILT_THRESH * sampleRate / KERNEL_MIN_FREQ));
+    const int numRatios = static_cast<int>(maxLog2Step - minLog2Step) * KERNEL_RATIOS_PER_OCTAVE + 1;
+    m_minLog2Step = static_cast<float>(minLog2Step);
+
+    m_kernels.assign(static_cast<size_t>(numRatios) * (KERNEL_PHASES + 1) * KERNEL_SIZE, 0.0f);
+
+    float* kernel = m_kernels.data();
+    for (int r = 0; r < numRatios; r++)
+    {
+        const float sincStep = static_cast<float>(std::exp2(minLog2Step + double(r) / KERNEL_RATIOS_PER_OCTAVE));
+
+        for (int p = 0; p <= KERNEL_PHASES; p++)
+        {
+            const float phase = float(p) / KERNEL_PHASES;
+
+            // Same kernel as BlepResampler without bank, normalized here instead of per sample
+            float kernelSum = 0.0f;
+            for (int k = 0; k < KERNEL_SIZE; k++)
+            {
+                const int wi = k - SINC_WINDOW_SIZE + 1;
+                float sl = BlepResampler::fast_Si((float(wi) - phase - 0.5f) * sincStep);
+                float sr = BlepResampler::fast_Si((float(wi) - phase + 0.5f) * sincStep);
+                kernel[k] = sr - sl;
+                kernelSum += kernel[k];
+            }
+
+            for (int k = 0; k < KERNEL_SIZE; k++)
+                kernel[k] /= kernelSum;
+
+            kernel += KERNEL_SIZE;
+        }
+    }
+}
+
+const float* BlepKernelBank::getKernels(float sincStep) const
+{
+    const int numRatios = static_cast<int>(m_kernels.size() / ((KERNEL_PHASES + 1) * KERNEL_SIZE));
+    const float pos = (std::log2(sincStep) - m_minLog2Step) * KERNEL_RATIOS_PER_OCTAVE;
+    const int r = std::clamp(static_cast<int>(std::lround(pos)), 0, numRatios - 1);
+    return &m_kernels[static_cast<size_t>(r) * (KERNEL_PHASES + 1) * KERNEL_SIZE];
+}
+
 }
@@ -1,49 +1,151 @@
 #pragma once
 
+#include <cassert>
 #include <vector>
 
 #include "Types.h"
 
 namespace GSVST {
 
+// Must be a power of two
+#define FETCH_WINDOW_SIZE 512
+
+/*
+ * Fixed capacity ring of source samples waiting to be resampled.
+ * Every sample is stored twice, FETCH_WINDOW_SIZE apart, so the unconsumed part
+ * can always be read as one contiguous array from data().
+ */
+class FetchWindow
+{
+public:
+    FetchWindow() : m_storage(FETCH_WINDOW_SIZE * 2) {}
+
+    static constexpr size_t capacity() { return FETCH_WINDOW_SIZE; }
+    size_t size() const { return m_writePos - m_readPos; }
+
+    const sample* data() const { return &m_storage[m_readPos & (FETCH_WINDOW_SIZE - 1)]; }
+
+    void push(float left, float right)
+    {
+        assert(size() < capacity());
+
+        const auto id = m_writePos & (FETCH_WINDOW_SIZE - 1);
+        m_storage[id] = { left, right };
+        m_storage[id + FETCH_WINDOW_SIZE] = { left, right };
+        m_writePos++;
+    }
+
+    void consume(size_t numSamples)
+    {
+        assert(numSamples <= size());
+        m_readPos += numSamples;
+    }
+
+    void clear() { m_readPos = m_writePos = 0; }
+
+private:
+    std::vector<sample> m_storage;
+    size_t m_readPos = 0;
+    size_t m_writePos = 0;
+};
+
+// Samples readable past the end of a DirectSource
+#define SAMPLE_GUARD_SIZE 4
+
+/*
+ * Mono sample memory read in place by the resampler, without going through the fetch window.
+ * data must be followed by SAMPLE_GUARD_SIZE guard samples holding what comes after endPos
+ * (the loop start, or silence), so the interpolation never has to check for the loop point.
+ */
+struct DirectSource
+{
+    const void* data = nullptr;
+    ESampleFormat format = ESampleFormat::Float;
+    // Integer samples are read as value / divisor
+    float divisor = 1.0f;
+    uint32_t loopPos = 0;
+    uint32_t endPos = 0;
+    bool loopEnabled = false;
+};
+
 /* 
  * res_data_fetch_cb fetches samplesRequired samples to fetchBuffer
  * so that the buffer can provide exactly samplesRequired samples
  *
  * returns false in case of 'end of stream'
  */
-typedef bool (*res_data_fetch_cb)(std::vector<sample>& fetchBuffer, size_t samplesRequired, void *cbdata);
-typedef std::vector<sample> StereoBuffer;
+typedef bool (*res_data_fetch_cb)(FetchWindow& fetchBuffer, size_t samplesRequired, void *cbdata);
 
 
 class Resampler {
 public:
     // return value false by Process signals the "end of stream"
-    virtual bool Process(sample* outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata) = 0;
+    virtual bool Process(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata) = 0;
     virtual void Reset() = 0;
     virtual ~Resampler();
 
 protected:
-    StereoBuffer fetchBuffer;
+    // Number of output samples that can be computed without overflowing the fetch window
+    size_t getMaxBlocks(float phaseInc, size_t extraSamples) const;
+    // Calls the fetch callback, or pads with silence once the stream has ended
+    bool fetch(size_t samplesRequired, res_data_fetch_cb cbPtr, void* cbdata);
+
+    FetchWindow fetchBuffer;
     float phase;
+    bool endOfStream = false;
 };
 
 class LinearResampler : public Resampler {
 public:
     LinearResampler();
     ~LinearResampler() override;
-    bool Process(sample* outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata) override;
+    bool Process(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void *cbdata) override;
     void Reset() override;
+
+    // Same output as Process with a fetch callback reading source, pos being the read position in source.
+    // Only one side is written: the source is mono
+    bool ProcessDirect(float* outData, size_t numBlocks, float phaseInc, const DirectSource& source, uint32_t& pos);
+
+private:
+    bool ProcessWindow(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void* cbdata);
+};
+
+/*
+ * Precomputed BlepResampler kernels, normalized, for each (phase, cutoff ratio) bucket.
+ * The range of ratios covers the CGB frequencies at the given host sample rate.
+ */
+class BlepKernelBank
+{
+public:
+    void build(double sampleRate);
+    bool isBuilt() const { return !m_kernels.empty(); }
+    double getSampleRate() const { return m_sampleRate; }
+
+    // Kernels of all the phase buckets (KERNEL_PHASES + 1, phase 0 to 1) for the ratio bucket closest to sincStep
+    const float* getKernels(float sincStep) const;
+
+private:
+    std::vector<float> m_kernels;
+    double m_sampleRate = 0.0;
+    float m_minLog2Step = 0.0f;
 };
 
 class BlepResampler : public Resampler {
 public:
     BlepResampler();
     ~BlepResampler() override;
-    bool Process(sample* outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void* cbdata) override;
+    bool Process(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void* cbdata) override;
     void Reset() override;
+
+    void SetKernelBank(const BlepKernelBank* kernels) { kernelBank = kernels; }
+
 private:
+    friend class BlepKernelBank;
+
+    bool ProcessWindow(StereoBuffer outData, size_t numBlocks, float phaseInc, res_data_fetch_cb cbPtr, void* cbdata);
     static float fast_Si(float t);
+
+    const BlepKernelBank* kernelBank = nullptr;
 };
 
 
@@ -3,6 +3,7 @@
 #include <string>
 
 #include "ReverbEffect.h"
+#include "Trace.h"
 
 namespace GSVST {
 
@@ -10,6 +11,7 @@ ReverbEffect::ReverbEffect(uint8_t intensity, size_t samplesPerBufferForComputat
     : reverbBuffer(samplesPerBufferForComputation * INTERFRAMES * numAgbBuffers, sample{ 0.0f, 0.0f })
 {
     this->intensity = intensity / 128.0f;
+    this->initialIntensity = this->intensity;
     this->numAgbBuffers = numAgbBuffers;
 
     size_t bufferLen = samplesPerBufferForComputation * INTERFRAMES;
@@ -21,8 +23,23 @@ ReverbEffect::~ReverbEffect()
 {
 }
 
-void ReverbEffect::ProcessData(sample *buffer, size_t numSamples, size_t samplesPerBufferForComputation)
+void ReverbEffect::Reset()
 {
+    std::fill(reverbBuffer.begin(), reverbBuffer.end(), sample{ 0.0f, 0.0f });
+    intensity = initialIntensity;
+
+    bufferPos = 0;
+    bufferPos2 = reverbBuffer.size() / numAgbBuffers;
+    left = 0;
+    count = 0;
+    reset = false;
+    reset2 = false;
+}
+
+void ReverbEffect::ProcessData(StereoBuffer buffer, size_t numSamples, size_t samplesPerBufferForComputation)
+{
+    GSVST_TRACE_SCOPE("ReverbEffect::ProcessData");
+
     bool bRecalculate = !(left > 0);
 
     while (numSamples > 0)
@@ -44,7 +61,7 @@ size_t ReverbEffect::getBlocksPerBuffer() const
     return reverbBuffer.size();
 }
 
-size_t ReverbEffect::processInternal(sample *buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
+size_t ReverbEffect::processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate)
 {
     auto requestedNumSamples = numSamples;
 
@@ -88,9 +105,9 @@ size_t ReverbEffect::processInternal(sample *buffer, const size_t numSamples, co
     do {
         float rev = (rbuf[bufferPos].left + rbuf[bufferPos].right + 
                 rbuf[bufferPos2].left + rbuf[bufferPos2].right) * intensity * (1.0f / 4.0f);
-        rbuf[bufferPos].left  = buffer->left  += rev;
-        rbuf[bufferPos].right = buffer->right += rev;
-        buffer++;
+        rbuf[bufferPos].left  = *buffer.left  += rev;
+        rbuf[bufferPos].right = *buffer.right += rev;
+        buffer += 1;
         bufferPos++;
         bufferPos2++;
     } while (--c > 0);
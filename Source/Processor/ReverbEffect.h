@@ -14,15 +14,22 @@ class ReverbEffect
 public:
     ReverbEffect(uint8_t intensity, size_t samplesPerBufferForComputation, uint8_t numAgbBuffers);
     virtual ~ReverbEffect();
-    void ProcessData(sample *buffer, size_t numSamples, size_t samplesPerBufferForComputation);
+    void ProcessData(StereoBuffer buffer, size_t numSamples, size_t samplesPerBufferForComputation);
 
     void SetDebugFile(std::fstream* in_file) { debug_file = in_file; }
 
+    // Back to the state after construction, without reallocating
+    virtual void Reset();
+
     void SetIntensity(int val) { intensity = val / 128.0f; }
+    float GetIntensity() const { return intensity; }
+    // False for effects whose feedback doesn't depend on the intensity
+    virtual bool UsesIntensity() const { return true; }
 protected:
-    virtual size_t processInternal(sample *buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate);
+    virtual size_t processInternal(StereoBuffer buffer, const size_t numSamples, const size_t numSamplesForCount, bool bRecalculate);
     size_t getBlocksPerBuffer() const;
     float intensity;
+    float initialIntensity;
     uint8_t numAgbBuffers;
 
     std::vector<sample> reverbBuffer;
@@ -0,0 +1,16 @@
+#include "SampleBuffer.h"
+
+namespace GSVST {
+
+ESampleFormat getCompactSampleFormat(const int16_t* data, size_t numSamples)
+{
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        if ((data[i] & 0xFF) != 0)
+            return ESampleFormat::Int16;
+    }
+
+    return ESampleFormat::Int8;
+}
+
+}
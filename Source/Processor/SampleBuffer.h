@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace GSVST {
+
+// Sample memory of a voice, in the format it is stored in
+struct SampleChannels
+{
+    const void* left = nullptr;
+    // Same as left for mono samples
+    const void* right = nullptr;
+    ESampleFormat format = ESampleFormat::Float;
+    // Integer samples are read as value / divisor
+    float divisor = 1.0f;
+
+    bool isStereo() const { return left != right; }
+};
+
+// Int8 if all the samples fit in their high byte, Int16 otherwise
+ESampleFormat getCompactSampleFormat(const int16_t* data, size_t numSamples);
+
+}
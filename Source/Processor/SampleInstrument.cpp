@@ -1,6 +1,12 @@
 #include "SampleInstrument.h"
+#include "VoicePool.h"
+#include "DSPKernels.h"
+#include "Trace.h"
 
 #include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <iterator>
 
 namespace GSVST {
 
@@ -12,8 +18,8 @@ void SampleInfo::setMidCFreq(int pitch_correction, int original_pitch, int sampl
     midCfreq = static_cast<int>(std::floor(sample_rate / pow(2, delta_note / 12)));
 }
 
-SoundfontSampleInstrument::SoundfontSampleInstrument(SoundfontSampleInfo* in_info, const Note& in_note)
-    : SampleInstrument(std::move(in_info), in_note)
+SoundfontSampleInstrument::SoundfontSampleInstrument(SoundfontSampleInfo* in_info, const Note& in_note, VoicePool& pool)
+    : SampleInstrument(in_info, in_note, pool)
     , m_fixed(in_info->fixed)
     , m_fixedModeRate(in_info->fixedSampleRate)
 {
@@ -30,12 +36,13 @@ void SoundfontSampleInstrument::updateArgs(const MixingArgs& args)
 }
 
 
-SampleInstrument::SampleInstrument(SampleInfo* in_info, const Note& in_note)
+SampleInstrument::SampleInstrument(SampleInfo* in_info, const Note& in_note, VoicePool& pool)
     : Instrument(in_note)
-    , m_inNumChannels(in_info->numChannels)
-    , m_info(std::move(in_info))
+    , m_channels(in_info->getChannelData())
+    , m_resampler(pool.acquireLinearResampler())
+    , m_info(in_info, VoicePoolDeleter{ &pool })
+    , m_bDirectRead(in_info->getDirectSource(m_directSource))
 {
-    m_resampler = std::make_unique<LinearResampler>();
 }
 
 void SampleInstrument::updateArgs(const MixingArgs& args)
@@ -45,8 +52,10 @@ void SampleInstrument::updateArgs(const MixingArgs& args)
     cargs.interStep = freq * args.sampleRateInv;
 }
 
-void SampleInstrument::process(sample* buffer, size_t numSamples, const MixingArgs& args)
+void SampleInstrument::process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args)
 {
+    GSVST_TRACE_SCOPE("SampleInstrument::process");
+
     if (!cargs.bInitialized)
     {
         // First init (cargs.interStep must be calculated before first call to processStart)
@@ -56,39 +65,84 @@ void SampleInstrument::process(sample* buffer, size_t numSamples, const MixingAr
 
     if (numSamples == 0)
         return;
-    sample* outBuffer = new sample[numSamples];
 
-    bool running = m_resampler->Process(outBuffer, numSamples, cargs.interStep, sampleFetchCallback, this);
+    assert(args.scratchBuffer && args.scratchSize > 0);
+
+    const auto& kernels = getDSPKernels();
 
+    bool running = true;
     size_t i = 0;
-    do {
-        processStart(args, i, args.samplesPerBufferForComputation);
 
-        buffer->left += outBuffer[i].left * cargs.lVol;
-        buffer->right += outBuffer[i].right * cargs.rVol;
-        i++;
-        buffer++;
-        cargs.lVol += cargs.lVolStep;
-        cargs.rVol += cargs.rVolStep;
+    // Resampler output goes to the preallocated scratch buffer, in slices if the host block is bigger than expected
+    while (numSamples > 0 && running)
+    {
+        size_t samplesToProcess = std::min(numSamples, args.scratchSize);
+        numSamples -= samplesToProcess;
 
-        processEnd(args, i);
+        StereoBuffer outBuffer = args.scratchBuffer;
+        if (m_bDirectRead)
+        {
+            running = m_resampler->ProcessDirect(outBuffer.left, samplesToProcess, cargs.interStep, m_directSource, pos);
+            outBuffer.right = outBuffer.left; // mono source
+        }
+        else
+            running = m_resampler->Process(outBuffer, samplesToProcess, cargs.interStep, sampleFetchCallback, this);
 
-    } while (--numSamples > 0);
+        mixOutput(buffer, outBuffer, samplesToProcess, i, args, kernels);
+    }
 
     if (!running)
         kill();
+}
+
+template <bool bStereo>
+void SampleInstrument::fetchSamples(FetchWindow& fetchBuffer, size_t numSamples)
+{
+    const float* left = static_cast<const float*>(m_channels.left) + pos;
+    const float* right = bStereo ? static_cast<const float*>(m_channels.right) + pos : left;
+
+    for (size_t k = 0; k < numSamples; k++)
+        fetchBuffer.push(left[k], right[k]);
+
+    pos += static_cast<uint32_t>(numSamples);
+}
+
+static void convertSamples(float* out, const void* data, uint32_t pos, size_t numSamples, const SampleChannels& channels, const DSPKernels& kernels)
+{
+    if (channels.format == ESampleFormat::Int8)
+        kernels.convertInt8(out, static_cast<const int8_t*>(data) + pos, numSamples, channels.divisor);
+    else
+        kernels.convertInt16(out, static_cast<const int16_t*>(data) + pos, numSamples, channels.divisor);
+}
+
+void SampleInstrument::fetchConvertedSamples(FetchWindow& fetchBuffer, size_t numSamples)
+{
+    const auto& kernels = getDSPKernels();
+    const bool bStereo = m_channels.isStereo();
+    float left[64];
+    float right[64];
+
+    while (numSamples > 0)
+    {
+        const size_t count = std::min(numSamples, std::size(left));
+        convertSamples(left, m_channels.left, pos, count, m_channels, kernels);
+        if (bStereo)
+            convertSamples(right, m_channels.right, pos, count, m_channels, kernels);
 
-    delete[] outBuffer;
+        for (size_t k = 0; k < count; k++)
+            fetchBuffer.push(left[k], bStereo ? right[k] : left[k]);
+
+        pos += static_cast<uint32_t>(count);
+        numSamples -= count;
+    }
 }
 
-bool SampleInstrument::sampleFetchCallback(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata)
+bool SampleInstrument::sampleFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata)
 {
     if (fetchBuffer.size() >= samplesRequired)
         return true;
     SampleInstrument* _this = static_cast<SampleInstrument*>(cbdata);
     size_t samplesToFetch = samplesRequired - fetchBuffer.size();
-    size_t i = fetchBuffer.size();
-    fetchBuffer.resize(samplesRequired);
 
     auto* sampleInfo = static_cast<SampleInfo*>(_this->m_info.get());
 
@@ -97,12 +151,12 @@ bool SampleInstrument::sampleFetchCallback(std::vector<sample>& fetchBuffer, siz
         size_t thisFetch = std::min(samplesTilLoop, samplesToFetch);
 
         samplesToFetch -= thisFetch;
-        do {
-            sampleInfo->fillSample(_this->pos, fetchBuffer[i].left, fetchBuffer[i].right);
-
-            _this->pos++;
-            i++;
-        } while (--thisFetch > 0);
+        if (_this->m_channels.format != ESampleFormat::Float)
+            _this->fetchConvertedSamples(fetchBuffer, thisFetch);
+        else if (_this->m_channels.isStereo())
+            _this->fetchSamples<true>(fetchBuffer, thisFetch);
+        else
+            _this->fetchSamples<false>(fetchBuffer, thisFetch);
 
         if (_this->pos >= sampleInfo->endPos)
         {
@@ -110,7 +164,8 @@ bool SampleInstrument::sampleFetchCallback(std::vector<sample>& fetchBuffer, siz
                 _this->pos = sampleInfo->loopPos;
             }
             else {
-                std::fill(fetchBuffer.begin() + i, fetchBuffer.end(), sample());
+                while (fetchBuffer.size() < samplesRequired)
+                    fetchBuffer.push(0.0f, 0.0f);
                 return false;
             }
         }
@@ -4,6 +4,8 @@
 #include <vector>
 
 #include "Instrument.h"
+#include "ObjectPool.h"
+#include "SampleBuffer.h"
 
 namespace GSVST {
 
@@ -28,27 +30,23 @@ struct SampleInfo
     }
 
     SampleInfo(const SampleInfo& other) = default;
+    virtual ~SampleInfo() = default;
 
     void setMidCFreq(int pitch_correction, int original_pitch, int sample_rate);
 
-    virtual void fillSample(uint32_t pos, float& out_left, float& out_right) const
-    {
-        out_left = sampleBuffer[0][pos];
-        if (numChannels == 2)
-            out_right = sampleBuffer[1][pos];
-        else
-            out_right = out_left;
-    }
+    virtual SampleChannels getChannelData() const { return channels; }
+
+    // Returns false if the samples can't be read in place by the resampler
+    virtual bool getDirectSource(DirectSource&) const { return false; }
 
     virtual EDSPType getType() const { return EDSPType::PCM; }
 
     int rootNote = 0;
     int midCfreq = DEFAULT_MIDC_FREQ;
-    const float* const* sampleBuffer = nullptr;
+    SampleChannels channels;
     uint32_t loopPos = 0;
     uint32_t endPos = 0;
     bool loopEnabled = false;
-    uint8_t numChannels = 1;
 
     ADSR adsr;
     uint8_t notePitch = 0;
@@ -56,6 +54,9 @@ struct SampleInfo
 };
 
 
+// Scale of the soundfont samples, as converted by tinysoundfont
+#define SOUNDFONT_SAMPLE_DIVISOR 32767.0f
+
 struct SoundfontSampleInfo : public SampleInfo
 {
     SoundfontSampleInfo(bool in_fixed, uint32_t in_fixedSampleRate, bool in_loopEnabled, uint32_t in_loopPos, uint32_t in_endPos)
@@ -68,53 +69,82 @@ struct SoundfontSampleInfo : public SampleInfo
     SoundfontSampleInfo(const SoundfontSampleInfo& other)
         : SampleInfo(other)
         , keyRange(other.keyRange)
+        , velocityRange(other.velocityRange)
         , fixed(other.fixed)
         , fixedSampleRate(other.fixedSampleRate)
         , offset(other.offset)
+        , format(other.format)
+        , bGuarded(other.bGuarded)
     {
     }
 
-    void fillSample(uint32_t pos, float& out_left, float& out_right) const override
+    SampleChannels getChannelData() const override
     {
-        out_left = out_right = soundFontSamplePtr[pos];
+        return { soundFontSamplePtr, soundFontSamplePtr, format, SOUNDFONT_SAMPLE_DIVISOR };
+    }
+
+    bool getDirectSource(DirectSource& out_source) const override
+    {
+        if (!soundFontSamplePtr || !bGuarded || (loopEnabled && endPos <= loopPos))
+            return false;
+
+        out_source.data = soundFontSamplePtr;
+        out_source.format = format;
+        out_source.divisor = SOUNDFONT_SAMPLE_DIVISOR;
+        out_source.loopPos = loopPos;
+        out_source.endPos = endPos;
+        out_source.loopEnabled = loopEnabled;
+        return true;
     }
 
     EDSPType getType() const override { return fixed ? EDSPType::PCMFixed : EDSPType::PCM; }
 
-    float* soundFontSamplePtr = nullptr;
+    const void* soundFontSamplePtr = nullptr;
 
     std::pair<uint16_t, uint16_t> keyRange;
+    std::pair<uint16_t, uint16_t> velocityRange { 0, 127 };
 
     bool fixed = false;
     uint32_t fixedSampleRate = 0;
     unsigned int offset = 0;
+    ESampleFormat format = ESampleFormat::Int16;
+    // Followed by guard samples (see PresetsHandler::addGuardedSample), except when mapped from the SF2 file
+    bool bGuarded = false;
 };
 
 class SampleInstrument : public Instrument
 {
 public:
-    SampleInstrument(SampleInfo* sInfo, const Note& note);
+    SampleInstrument(SampleInfo* sInfo, const Note& note, VoicePool& pool);
 
     EDSPType getType() const final { return m_info->getType(); }
-    void process(sample* buffer, size_t numSamples, const MixingArgs& args) final;
-    static bool sampleFetchCallback(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata);
+    void process(StereoBuffer buffer, size_t numSamples, const MixingArgs& args) final;
+    static bool sampleFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata);
 
     void updateArgs(const MixingArgs& args) override;
     int getMidCFreq() const override { return m_info->midCfreq; }
 
 private:
-    const uint8_t m_inNumChannels;
+    template <bool bStereo>
+    void fetchSamples(FetchWindow& fetchBuffer, size_t numSamples);
+    void fetchConvertedSamples(FetchWindow& fetchBuffer, size_t numSamples);
 
     uint32_t pos = 0;
 
-    std::unique_ptr<Resampler> m_resampler;
-    std::unique_ptr<SampleInfo> m_info;
+    // Resolved once from m_info, for the fetch callback
+    SampleChannels m_channels;
+
+    PooledPtr<LinearResampler> m_resampler;
+    PooledPtr<SampleInfo> m_info;
+
+    DirectSource m_directSource;
+    const bool m_bDirectRead;
 };
 
-class SoundfontSampleInstrument : public SampleInstrument
+class SoundfontSampleInstrument final : public SampleInstrument
 {
 public:
-    SoundfontSampleInstrument(SoundfontSampleInfo* sInfo, const Note& note);
+    SoundfontSampleInstrument(SoundfontSampleInfo* sInfo, const Note& note, VoicePool& pool);
 
     void updateArgs(const MixingArgs& args) override;
 
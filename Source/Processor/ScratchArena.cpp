@@ -0,0 +1,22 @@
+#include "ScratchArena.h"
+
+#include <cassert>
+
+namespace GSVST {
+
+void ScratchArena::prepare(size_t numSlices, size_t samplesPerSlice)
+{
+    m_numSlices = numSlices;
+    m_sliceSize = samplesPerSlice;
+    m_sliceStride = AudioBus::getPaddedSize(samplesPerSlice);
+
+    m_buffer.resize(numSlices * m_sliceStride);
+}
+
+StereoBuffer ScratchArena::getSlice(size_t sliceId)
+{
+    assert(sliceId < m_numSlices);
+    return m_buffer.getBuffer(sliceId * m_sliceStride);
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include "AudioBus.h"
+
+namespace GSVST {
+
+/*
+ * Preallocated temporary storage used by the voices render path (resampler output etc.)
+ * Sized once in Processor::prepareToPlay so that rendering never has to allocate.
+ * Every midi channel gets its own slice, aligned like the AudioBus it is cut from.
+ */
+class ScratchArena
+{
+public:
+    void prepare(size_t numSlices, size_t samplesPerSlice);
+
+    StereoBuffer getSlice(size_t sliceId);
+    size_t getSliceSize() const { return m_sliceSize; }
+
+private:
+    AudioBus m_buffer;
+    size_t m_numSlices = 0;
+    size_t m_sliceSize = 0;
+    size_t m_sliceStride = 0;
+};
+
+}
@@ -0,0 +1,108 @@
+#include "SharedReverb.h"
+
+#include "ReverbEffect.h"
+#include "Trace.h"
+#include "GS/GSReverb.h"
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+static_assert(static_cast<int>(EReverbType::MGAT) + 1 == NUM_REVERB_TYPES, "One shared bus per reverb type");
+
+std::unique_ptr<ReverbEffect> createReverbEffect(EReverbType type, size_t samplesPerBufferForComputation)
+{
+    const uint8_t reverbIntensity = 79;
+    const auto revBufSize = 0x630;
+    const auto maxFixedModeRate = 31536;
+    const auto numAgbBuffers = uint8_t(revBufSize / (maxFixedModeRate / AGB_FPS));
+
+    switch (type)
+    {
+    case EReverbType::None:
+        break;
+    case EReverbType::Default:
+        return std::make_unique<ReverbEffect>(reverbIntensity, samplesPerBufferForComputation, numAgbBuffers);
+    case EReverbType::GS1:
+        return std::make_unique<ReverbGS1>(reverbIntensity, samplesPerBufferForComputation, numAgbBuffers);
+    case EReverbType::GS2:
+        return std::make_unique<ReverbGS2>(reverbIntensity, samplesPerBufferForComputation, numAgbBuffers,
+            0.4140625f, -0.0625f);
+    case EReverbType::MGAT:
+        return std::make_unique<ReverbGS2>(reverbIntensity, samplesPerBufferForComputation, numAgbBuffers,
+            0.25f, -0.046875f);
+    }
+
+    return nullptr;
+}
+
+SharedReverb::SharedReverb()
+{
+}
+
+SharedReverb::~SharedReverb()
+{
+}
+
+void SharedReverb::prepare(int samplesPerBlock, int samplesPerBlockComputation)
+{
+    if (samplesPerBlock == m_samplesPerBlock && samplesPerBlockComputation == m_samplesPerBlockComputation)
+        return;
+
+    m_samplesPerBlock = samplesPerBlock;
+    m_samplesPerBlockComputation = samplesPerBlockComputation;
+
+    for (size_t i = 0; i < m_buses.size(); i++)
+    {
+        auto& bus = m_buses[i];
+        bus.effect = createReverbEffect(static_cast<EReverbType>(i), samplesPerBlockComputation);
+        bus.send.resize(samplesPerBlock);
+        bus.wet.resize(samplesPerBlock);
+        bus.bUsed = false;
+    }
+}
+
+void SharedReverb::addSend(EReverbType type, const AudioBus& source, float channelIntensity, size_t numSamples)
+{
+    auto& bus = m_buses[static_cast<size_t>(type)];
+    if (!bus.effect)
+        return;
+
+    // GS reverbs ignore the intensity: every channel sends at full level
+    float gain = 1.0f;
+    if (bus.effect->UsesIntensity())
+        gain = bus.effect->GetIntensity() > 0.0f ? channelIntensity / bus.effect->GetIntensity() : 0.0f;
+
+    const auto num = static_cast<int>(numSamples);
+    juce::FloatVectorOperations::addWithMultiply(bus.send.getLeft(), source.getLeft(), gain, num);
+    juce::FloatVectorOperations::addWithMultiply(bus.send.getRight(), source.getRight(), gain, num);
+    bus.bUsed = true;
+}
+
+void SharedReverb::process(size_t numSamples, size_t samplesPerBufferForComputation, juce::AudioBuffer<float>& buffer)
+{
+    GSVST_TRACE_SCOPE("SharedReverb::process");
+
+    const auto num = static_cast<int>(numSamples);
+
+    for (auto& bus : m_buses)
+    {
+        if (!bus.bUsed)
+            continue;
+
+        juce::FloatVectorOperations::copy(bus.wet.getLeft(), bus.send.getLeft(), num);
+        juce::FloatVectorOperations::copy(bus.wet.getRight(), bus.send.getRight(), num);
+
+        bus.effect->ProcessData(bus.wet.getBuffer(), numSamples, samplesPerBufferForComputation);
+
+        // The effects output dry + reverb, the dry part is already in the host buffer
+        juce::FloatVectorOperations::subtract(bus.wet.getLeft(), bus.send.getLeft(), num);
+        juce::FloatVectorOperations::subtract(bus.wet.getRight(), bus.send.getRight(), num);
+        bus.wet.addTo(buffer, numSamples);
+
+        bus.send.clear();
+        bus.bUsed = false;
+    }
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "Types.h"
+#include "AudioBus.h"
+
+namespace GSVST {
+
+class ReverbEffect;
+
+std::unique_ptr<ReverbEffect> createReverbEffect(EReverbType type, size_t samplesPerBufferForComputation);
+
+/*
+ * One reverb per type for the whole mix, as the m4a engine does on hardware.
+ * The channels send their output to the bus of their reverb type, and only the reverb
+ * part of each processed bus is added to the host buffer (the channels add their dry output).
+ */
+class SharedReverb
+{
+public:
+    SharedReverb();
+    ~SharedReverb();
+
+    void prepare(int samplesPerBlock, int samplesPerBlockComputation);
+
+    // Sends numSamples of source, scaled by the channel reverb intensity relative to the shared one
+    void addSend(EReverbType type, const AudioBus& source, float channelIntensity, size_t numSamples);
+
+    // Processes the buses that received something since the last call
+    void process(size_t numSamples, size_t samplesPerBufferForComputation, juce::AudioBuffer<float>& buffer);
+
+private:
+    struct SendBus
+    {
+        std::unique_ptr<ReverbEffect> effect;
+        AudioBus send;
+        AudioBus wet;
+        bool bUsed = false;
+    };
+
+    std::array<SendBus, NUM_REVERB_TYPES> m_buses;
+
+    int m_samplesPerBlock = 0;
+    int m_samplesPerBlockComputation = 0;
+};
+
+}
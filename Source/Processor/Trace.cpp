@@ -0,0 +1,128 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+namespace GSVST {
+namespace Trace {
+
+#if GSVST_TRACING
+
+struct TraceEvent
+{
+    // Index of the write + 1 once the event is complete, so that the export skips the slots being written
+    std::atomic<uint64_t> sequence { 0 };
+    // Atomic so that an export reading a slot being overwritten isn't a data race, the sequence telling it to skip it
+    std::atomic<const char*> name { nullptr };
+    std::atomic<uint32_t> threadId { 0 };
+    std::atomic<int64_t> start { 0 };
+    std::atomic<int64_t> duration { 0 };
+};
+
+static TraceEvent s_events[TRACE_BUFFER_SIZE];
+static std::atomic<uint64_t> s_writeIndex { 0 };
+static std::atomic<uint32_t> s_nextThreadId { 1 };
+
+static uint32_t getThreadId()
+{
+    static thread_local uint32_t threadId = s_nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return threadId;
+}
+
+bool isEnabled()
+{
+    return true;
+}
+
+int64_t now()
+{
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void record(const char* name, int64_t start, int64_t end)
+{
+    const auto index = s_writeIndex.fetch_add(1, std::memory_order_relaxed);
+    auto& event = s_events[index & (TRACE_BUFFER_SIZE - 1)];
+
+    event.sequence.store(0, std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.threadId.store(getThreadId(), std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.duration.store(end - start, std::memory_order_relaxed);
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+void clear()
+{
+    for (auto& event : s_events)
+        event.sequence.store(0, std::memory_order_relaxed);
+}
+
+bool writeChromeJson(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    const auto end = s_writeIndex.load(std::memory_order_acquire);
+    const auto begin = end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0;
+
+    file << "{\"traceEvents\":[";
+
+    bool bFirst = true;
+    for (auto index = begin; index < end; index++)
+    {
+        const auto& event = s_events[index & (TRACE_BUFFER_SIZE - 1)];
+        if (event.sequence.load(std::memory_order_acquire) != index + 1)
+            continue;
+
+        const auto* name = event.name.load(std::memory_order_relaxed);
+        const auto threadId = event.threadId.load(std::memory_order_relaxed);
+        const auto start = event.start.load(std::memory_order_relaxed);
+        const auto duration = event.duration.load(std::memory_order_relaxed);
+
+        // Overwritten while being copied
+        if (event.sequence.load(std::memory_order_acquire) != index + 1)
+            continue;
+
+        file << (bFirst ? "\n" : ",\n");
+        file << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << duration
+             << ",\"pid\":1,\"tid\":" << threadId << "}";
+        bFirst = false;
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return file.good();
+}
+
+#else
+
+bool isEnabled()
+{
+    return false;
+}
+
+int64_t now()
+{
+    return 0;
+}
+
+void record(const char* /*name*/, int64_t /*start*/, int64_t /*end*/)
+{
+}
+
+void clear()
+{
+}
+
+bool writeChromeJson(const std::string& /*path*/)
+{
+    return false;
+}
+
+#endif
+
+}
+}
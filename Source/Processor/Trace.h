@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "RealtimeCheck.h"
+
+// Set by the ENABLE_TRACING CMake option. Without it the trace events compile to nothing
+#ifndef GSVST_TRACING
+#define GSVST_TRACING 0
+#endif
+
+// Number of events kept, the oldest ones being overwritten. Power of two
+#define TRACE_BUFFER_SIZE (1 << 16)
+
+namespace GSVST {
+
+/*
+ * Scoped events of the render pipeline, recorded by any thread into a preallocated ring
+ * and exported in the Chrome trace_event format (chrome://tracing, ui.perfetto.dev).
+ */
+namespace Trace {
+
+bool isEnabled();
+
+// Microseconds since the first call
+int64_t now();
+
+// name has to outlive the trace: string literals only
+void record(const char* name, int64_t start, int64_t end);
+
+void clear();
+
+// Events still in the ring, oldest first. False if tracing is compiled out or the file can't be written
+bool writeChromeJson(const std::string& path);
+
+}
+
+class TraceScope
+{
+public:
+    TraceScope(const char* in_name)
+        : m_name(in_name)
+        , m_start(Trace::now())
+    {}
+
+    ~TraceScope()
+    {
+        Trace::record(m_name, m_start, Trace::now());
+    }
+
+private:
+    const char* m_name;
+    int64_t m_start;
+};
+
+}
+
+#if GSVST_TRACING
+#define GSVST_TRACE_CONCAT_IMPL(a, b) a##b
+#define GSVST_TRACE_CONCAT(a, b) GSVST_TRACE_CONCAT_IMPL(a, b)
+#define GSVST_TRACE_EVENT(name) GSVST::TraceScope GSVST_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define GSVST_TRACE_EVENT(name)
+#endif
+
+// The name is also the call site of the real-time check violations in the scope
+#define GSVST_TRACE_SCOPE(name) GSVST_TRACE_EVENT(name); GSVST_RT_TAG(name)
@@ -6,12 +6,29 @@
 // for increased quality we process in subframes (including the base frame)
 #define INTERFRAMES 4
 #define MAX_MIDI_CHANNELS 16
+// Voices per type for all the channels, a plugin setting (see Processor::setVoicePoolCapacity).
+// Past this, a note-on steals the oldest voice of its type
+#define DEFAULT_VOICE_POOL_CAPACITY 128
+#define MIN_VOICE_POOL_CAPACITY 16
+#define MAX_VOICE_POOL_CAPACITY 1024
+// Past this, a note-on steals the channel's oldest voice
+#define MAX_VOICES_PER_CHANNEL 128
+// Per voice or channel within a block. Past this, a volume change replaces the last one
+#define MAX_PENDING_VOL_CHANGES 32
+// Per voice within a block. Past this, note offs are dropped: the earliest one is already pending
+#define MAX_PENDING_NOTE_OFFS 4
+// Per block, for all the channels. Past this, note-ons are dropped
+#define MAX_PENDING_NOTE_ONS 256
 
 namespace GSVST {
 
 enum class EReverbType : uint8_t { None, Default, GS1, GS2, MGAT };
+#define NUM_REVERB_TYPES 5
 enum class ELfoType : uint8_t { Pitch = 0, Vol, Pan };
 
+// Storage of sample memory. Integer samples are on the int16 scale, int8 ones being the high byte
+enum class ESampleFormat : uint8_t { Float, Int16, Int8 };
+
 struct ADSR
 {
     ADSR(uint8_t att, uint8_t dec, uint8_t sus, uint8_t rel)
@@ -68,6 +85,7 @@ struct Note
     uint8_t midiKeyTrackData; // Midi note
     uint8_t midiKeyPitch; // Note pitch in the data
     uint8_t velocity = 100;
+    uint8_t midiVelocity = 127; // Before linearization, for the velocity layers
     //uint8_t priority;
     int8_t rhythmPan = 0;
     uint8_t pseudoEchoVol = 0;
@@ -80,15 +98,33 @@ struct sample {
     float right = 0.0f;
 };
 
+// Planar stereo samples: one float array per side (see AudioBus)
+struct StereoBuffer
+{
+    float* left = nullptr;
+    float* right = nullptr;
+
+    StereoBuffer operator+(size_t offset) const { return { left + offset, right + offset }; }
+    StereoBuffer& operator+=(size_t offset)
+    {
+        left += offset;
+        right += offset;
+        return *this;
+    }
+
+    explicit operator bool() const { return left != nullptr && right != nullptr; }
+};
+
 struct VolChange
 {
+    VolChange() = default;
     VolChange(int in_time, int in_vol)
         : timestamp(in_time)
         , volume(in_vol)
     {}
 
-    int timestamp;
-    int volume;
+    int timestamp = 0;
+    int volume = 0;
 };
 
 struct MixingArgs
@@ -97,6 +133,10 @@ struct MixingArgs
     float sampleRateInv;
     float samplesPerBufferInv;
     int samplesPerBufferForComputation;
+
+    // Channel slice of the processor's ScratchArena (temporary voice output)
+    StereoBuffer scratchBuffer;
+    size_t scratchSize = 0;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "VoicePool.h"
+
+#include <cassert>
+
+namespace GSVST {
+
+void VoicePoolDeleter::operator()(SampleInfo* info) const
+{
+    pool->destroySampleInfo(info);
+}
+
+void VoicePoolDeleter::operator()(Resampler* resampler) const
+{
+    pool->releaseResampler(resampler);
+}
+
+void VoicePool::prepare(size_t capacityPerType)
+{
+    m_capacityPerType = capacityPerType;
+
+    std::apply([&](auto&... pool) { (pool.init(capacityPerType), ...); }, m_voices);
+    std::apply([&](auto&... pool) { (pool.init(capacityPerType), ...); }, m_sampleInfos);
+
+    // One linear resampler per SoundfontSampleInstrument and one BLEP resampler per SquareChannel:
+    // a voice got from its pool always finds its resampler
+    m_linearResamplers.init(capacityPerType);
+    m_blepResamplers.init(capacityPerType);
+}
+
+bool VoicePool::isPrepared(size_t capacityPerType) const
+{
+    return m_capacityPerType == capacityPerType;
+}
+
+void VoicePool::setSampleRate(double sampleRate)
+{
+    if (m_blepKernels.getSampleRate() != sampleRate)
+        m_blepKernels.build(sampleRate);
+}
+
+void VoicePool::destroyVoice(Instrument* instr)
+{
+    [[maybe_unused]] const bool bReleased = std::apply([instr](auto&... pool) { return (pool.release(instr) || ...); }, m_voices);
+    assert(bReleased);
+}
+
+void VoicePool::destroySampleInfo(SampleInfo* info)
+{
+    [[maybe_unused]] const bool bReleased = std::apply([info](auto&... pool) { return (pool.release(info) || ...); }, m_sampleInfos);
+    assert(bReleased);
+}
+
+bool VoicePool::isFull(EDSPType type) const
+{
+    switch (type)
+    {
+    case EDSPType::PCM:
+    case EDSPType::PCMFixed: return std::get<ObjectPool<SoundfontSampleInstrument>>(m_voices).isFull();
+    case EDSPType::ModPulse: return std::get<ObjectPool<GSPWMSynth>>(m_voices).isFull();
+    case EDSPType::Saw:      return std::get<ObjectPool<GSSawSynth>>(m_voices).isFull();
+    case EDSPType::Tri:      return std::get<ObjectPool<GSTriangleSynth>>(m_voices).isFull();
+    case EDSPType::Square:   return std::get<ObjectPool<SquareChannel>>(m_voices).isFull();
+    }
+
+    return false;
+}
+
+bool VoicePool::isSamePool(EDSPType type, EDSPType other)
+{
+    // Both sample types are SoundfontSampleInstrument
+    auto isSample = [](EDSPType t) { return t == EDSPType::PCM || t == EDSPType::PCMFixed; };
+    return type == other || (isSample(type) && isSample(other));
+}
+
+PooledPtr<LinearResampler> VoicePool::acquireLinearResampler()
+{
+    auto* resampler = m_linearResamplers.acquire();
+    assert(resampler);
+    resampler->Reset();
+    return PooledPtr<LinearResampler>(resampler, VoicePoolDeleter{ this });
+}
+
+PooledPtr<Resampler> VoicePool::acquireBlepResampler()
+{
+    auto* resampler = m_blepResamplers.acquire();
+    assert(resampler);
+    resampler->Reset();
+    resampler->SetKernelBank(&m_blepKernels);
+    return PooledPtr<Resampler>(resampler, VoicePoolDeleter{ this });
+}
+
+void VoicePool::releaseResampler(Resampler* resampler)
+{
+    [[maybe_unused]] const bool bReleased = m_linearResamplers.release(resampler) || m_blepResamplers.release(resampler);
+    assert(bReleased);
+}
+
+size_t VoicePool::getNumOverflows() const
+{
+    size_t total = m_linearResamplers.getNumOverflows() + m_blepResamplers.getNumOverflows();
+    std::apply([&](const auto&... pool) { total += (pool.getNumOverflows() + ...); }, m_voices);
+    std::apply([&](const auto&... pool) { total += (pool.getNumOverflows() + ...); }, m_sampleInfos);
+    return total;
+}
+
+}
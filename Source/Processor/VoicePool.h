@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ObjectPool.h"
+#include "SampleInstrument.h"
+#include "CGBChannel.h"
+#include "GS/GSSynths.h"
+
+#include <tuple>
+
+namespace GSVST {
+
+/*
+ * Owns the voices created by the presets on note-on, and their sub-objects (sample info, resampler).
+ * Everything is preallocated in prepare() with one pool per concrete type, so note-on/note-off
+ * never allocate on the audio thread: once a pool is full, createVoice returns nullptr.
+ */
+class VoicePool
+{
+public:
+    VoicePool() = default;
+    VoicePool(const VoicePool&) = delete;
+    VoicePool& operator=(const VoicePool&) = delete;
+
+    void prepare(size_t capacityPerType);
+    bool isPrepared(size_t capacityPerType) const;
+    void setSampleRate(double sampleRate);
+
+    template<typename T, typename... Args>
+    T* createVoice(Args&&... args)
+    {
+        return std::get<ObjectPool<T>>(m_voices).acquire(std::forward<Args>(args)...);
+    }
+    void destroyVoice(Instrument* instr);
+
+    // No room left for a voice of this type
+    bool isFull(EDSPType type) const;
+    // Voices of both types come from the same pool
+    static bool isSamePool(EDSPType type, EDSPType other);
+
+    // Note-on order over all the channels, to find the oldest voice
+    uint32_t getNextSerial() { return m_nextSerial++; }
+
+    template<typename T>
+    T* createSampleInfo(const T& other)
+    {
+        return std::get<ObjectPool<T>>(m_sampleInfos).acquire(other);
+    }
+    void destroySampleInfo(SampleInfo* info);
+
+    PooledPtr<LinearResampler> acquireLinearResampler();
+    PooledPtr<Resampler> acquireBlepResampler();
+    void releaseResampler(Resampler* resampler);
+
+    size_t getNumOverflows() const;
+
+private:
+    std::tuple<
+        ObjectPool<SoundfontSampleInstrument>,
+        ObjectPool<GSPWMSynth>,
+        ObjectPool<GSSawSynth>,
+        ObjectPool<GSTriangleSynth>,
+        ObjectPool<SquareChannel>> m_voices;
+
+    std::tuple<
+        ObjectPool<SoundfontSampleInfo>> m_sampleInfos;
+
+    RecyclingPool<LinearResampler> m_linearResamplers;
+    RecyclingPool<BlepResampler> m_blepResamplers;
+    BlepKernelBank m_blepKernels;
+
+    size_t m_capacityPerType = 0;
+    uint32_t m_nextSerial = 0;
+};
+
+}
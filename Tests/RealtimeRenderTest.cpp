@@ -0,0 +1,262 @@
+#include <JuceHeader.h>
+
+#include "Processor/Processor.h"
+#include "Processor/RealtimeCheck.h"
+#include "Presets/PresetsHandler.h"
+#include "TestSoundfont.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Renders a scripted midi sequence through the processor in every render mode, with the real-time checks
+ * aborting on the first allocation, deallocation or lock in processBlock. Built with ENABLE_RT_CHECKS, run by ctest.
+ * The GS synths are played without a soundfont, then the samples and CGB channels of a generated one.
+ * Each pass starts from a new processor, so that the multi-threaded output can be compared with the single-threaded one.
+ */
+
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_BLOCK_SIZE 512
+#define TEST_NUM_BLOCKS 160
+#define TEST_NUM_CHANNELS 9
+
+namespace {
+
+using namespace GSVST;
+
+class TestPlayHead : public juce::AudioPlayHead
+{
+public:
+    juce::Optional<PositionInfo> getPosition() const override
+    {
+        PositionInfo info;
+        info.setTimeInSeconds(m_time);
+        info.setIsPlaying(true);
+        info.setBpm(120.0);
+        return info;
+    }
+
+    void advance(int numSamples) { m_time += numSamples / TEST_SAMPLE_RATE; }
+
+private:
+    double m_time = 0.0;
+};
+
+struct Scenario
+{
+    const char* name;
+    bool bSoundfont;
+    // The last channel plays the first one's program: its burst fills the pool of their voice type,
+    // which then steals the oldest voices of both channels
+    int programs[TEST_NUM_CHANNELS];
+    // Set from the editor during the render
+    int editorProgram;
+};
+
+const Scenario s_scenarios[] = {
+    // PWM, saw and triangle programs of bank 0
+    { "GS synths", false, { 80, 81, 83, 88, 82, 93, 85, 98, 80 }, 93 },
+    { "soundfont", true, {
+        static_cast<int>(ETestProgram::Looped),
+        static_cast<int>(ETestProgram::OneShot8Bit),
+        static_cast<int>(ETestProgram::KeySplit),
+        static_cast<int>(ETestProgram::FixedPitch),
+        static_cast<int>(ETestProgram::GBSquare),
+        static_cast<int>(ETestProgram::OutOfRange),
+        static_cast<int>(ETestProgram::GBSquare),
+        static_cast<int>(ETestProgram::KeySplit),
+        static_cast<int>(ETestProgram::Looped) },
+        static_cast<int>(ETestProgram::FixedPitch) },
+};
+
+int getNote(int block, int channel)
+{
+    return 48 + (block * 7 + channel * 5) % 24;
+}
+
+void addEvents(juce::MidiBuffer& midi, const Scenario& scenario, int block)
+{
+    if (block == 0)
+    {
+        for (int channel = 1; channel <= TEST_NUM_CHANNELS; channel++)
+        {
+            midi.addEvent(juce::MidiMessage::programChange(channel, scenario.programs[channel - 1]), 0);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 7, 100), 0);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 10, 16 * (channel % 8)), 0);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 91, 64), 0);
+        }
+
+        // Pitch bend range of 12 semitones
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, 101, 0), 1);
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, 100, 0), 1);
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, 6, 12), 1);
+    }
+
+    // Overlapping notes, each held for two blocks
+    for (int channel = 1; channel <= TEST_NUM_CHANNELS - 1; channel++)
+    {
+        const int offset = (channel * 37 + block * 11) % TEST_BLOCK_SIZE;
+        if ((block + channel) % 4 == 0)
+            midi.addEvent(juce::MidiMessage::noteOn(channel, getNote(block, channel), (juce::uint8)100), offset);
+        else if ((block + channel) % 4 == 2 && block >= 2)
+            midi.addEvent(juce::MidiMessage::noteOff(channel, getNote(block - 2, channel)), offset);
+    }
+
+    midi.addEvent(juce::MidiMessage::pitchWheel(1, (block * 1024) % 16384), TEST_BLOCK_SIZE / 2);
+
+    // More volume changes in one block than a voice keeps
+    for (int i = 0; i < MAX_PENDING_VOL_CHANGES + 8; i++)
+        midi.addEvent(juce::MidiMessage::controllerEvent(2, 7, 60 + (i + block) % 60), i * (TEST_BLOCK_SIZE / (MAX_PENDING_VOL_CHANGES + 8)));
+
+    // More notes on one channel than it can play: the oldest ones are stolen
+    if (block == 40)
+    {
+        for (int i = 0; i < MAX_VOICES_PER_CHANNEL + 32; i++)
+            midi.addEvent(juce::MidiMessage::noteOn(TEST_NUM_CHANNELS, 24 + i % 96, (juce::uint8)80), i % TEST_BLOCK_SIZE);
+    }
+
+    if (block == 60)
+        midi.addEvent(juce::MidiMessage::programChange(1, scenario.programs[2]), 0);
+
+    if (block == 100)
+        midi.addEvent(juce::MidiMessage::allNotesOff(1), 0);
+}
+
+// The soundfont is loaded on the presets thread
+bool waitForSoundfont(Processor& processor, const std::string& path)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        const auto* set = processor.getPresets().getPublishedPresetSet();
+        if (set && set->m_settings.soundFontPath == path && set->m_soundfont)
+            return true;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+// Renders the sequence with a new processor, the output being interleaved
+bool renderPass(const Scenario& scenario, const juce::File& soundfont, bool bMultiThreaded, bool bSharedReverb, std::vector<float>& out_output)
+{
+    Processor processor;
+
+    if (scenario.bSoundfont)
+    {
+        const auto path = soundfont.getFullPathName().toStdString();
+        processor.setSoundfont(path);
+        if (!waitForSoundfont(processor, path))
+        {
+            std::printf("%s: the soundfont wasn't loaded\n", scenario.name);
+            return false;
+        }
+    }
+
+    processor.setMultiThreaded(bMultiThreaded);
+    processor.setSharedReverb(bSharedReverb);
+
+    // As a host does before preparing the processor
+    processor.setRateAndBufferSizeDetails(TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+    processor.prepareToPlay(TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    TestPlayHead playHead;
+    processor.setPlayHead(&playHead);
+
+    juce::AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+    juce::MidiBuffer midi;
+    double sum = 0.0;
+
+    out_output.clear();
+    out_output.reserve(TEST_NUM_BLOCKS * TEST_BLOCK_SIZE * 2);
+
+    for (int block = 0; block < TEST_NUM_BLOCKS; block++)
+    {
+        // Editor changes, from this thread as from the message thread
+        if (block == 20)
+            processor.setChannelPreset(2, 0, scenario.editorProgram);
+        if (block == 80)
+            processor.applyReverbToAllChannels(EReverbType::GS2);
+
+        midi.clear();
+        addEvents(midi, scenario, block);
+        buffer.clear();
+
+        processor.processBlock(buffer, midi);
+        playHead.advance(TEST_BLOCK_SIZE);
+
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            out_output.push_back(buffer.getSample(0, i));
+            out_output.push_back(buffer.getSample(1, i));
+            sum += std::abs(buffer.getSample(0, i)) + std::abs(buffer.getSample(1, i));
+        }
+    }
+
+    processor.setPlayHead(nullptr);
+    processor.releaseResources();
+    processor.setMultiThreaded(false);
+
+    const auto stats = processor.getPerformanceStats().read();
+
+    std::printf("%s, multi-threaded %d, shared reverb %d: output %g, %llu voices stolen, %llu notes dropped\n",
+        scenario.name, bMultiThreaded ? 1 : 0, bSharedReverb ? 1 : 0, sum,
+        static_cast<unsigned long long>(stats.numStolenVoices), static_cast<unsigned long long>(stats.numPoolOverflows));
+
+    // Silence or no stealing would mean the sequence didn't go through the paths it is meant to check.
+    // A full pool steals a voice instead of dropping the note
+    return sum > 0.0 && std::isfinite(sum) && stats.numStolenVoices > 0 && stats.numPoolOverflows == 0;
+}
+
+}
+
+int main()
+{
+    if (!RealtimeCheck::isEnabled())
+    {
+        std::printf("Built without GSVST_RT_CHECKS\n");
+        return 1;
+    }
+
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    RealtimeCheck::setAbortOnViolation(true);
+
+    const auto soundfont = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("GoldenSunVST_test.sf2");
+    if (!writeTestSoundfont(soundfont))
+    {
+        std::printf("Can't write %s\n", soundfont.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    bool bSuccess = true;
+    for (const auto& scenario : s_scenarios)
+    {
+        for (bool bSharedReverb : { false, true })
+        {
+            std::vector<float> outputs[2];
+            for (bool bMultiThreaded : { false, true })
+                bSuccess &= renderPass(scenario, soundfont, bMultiThreaded, bSharedReverb, outputs[bMultiThreaded ? 1 : 0]);
+
+            // The render threads must not change a single sample
+            if (outputs[0].size() != outputs[1].size()
+                || std::memcmp(outputs[0].data(), outputs[1].data(), outputs[0].size() * sizeof(float)) != 0)
+            {
+                std::printf("%s, shared reverb %d: the multi-threaded output differs\n", scenario.name, bSharedReverb ? 1 : 0);
+                bSuccess = false;
+            }
+        }
+    }
+
+    if (RealtimeCheck::getNumViolations() > 0)
+    {
+        std::printf("%s", RealtimeCheck::getReport().c_str());
+        bSuccess = false;
+    }
+
+    return bSuccess ? 0 : 1;
+}
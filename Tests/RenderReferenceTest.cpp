@@ -0,0 +1,297 @@
+#include <JuceHeader.h>
+
+#include "Processor/Processor.h"
+#include "Processor/DSPKernels.h"
+#include "Presets/PresetsHandler.h"
+#include "TestSoundfont.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Renders scripted midi sequences with the scalar kernels, and compares the output sample for sample
+ * with the reference renders of Tests/Reference. Note-offs and volume changes fall in the middle of
+ * the sub-frames, where the voices are advanced per run. The references were rendered by the engine
+ * that still advanced the voices sample by sample. The soundfont is also played memory-mapped.
+ * Usage: RenderReferenceTest <reference directory> [--write], --write replacing the references.
+ */
+
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_BLOCK_SIZE 256
+#define TEST_NUM_BLOCKS 48
+#define TEST_NUM_CHANNELS 8
+// Blocks between the program changes of the gs_programs scenario
+#define TEST_PROGRAM_BLOCKS 16
+
+namespace {
+
+using namespace GSVST;
+
+class TestPlayHead : public juce::AudioPlayHead
+{
+public:
+    juce::Optional<PositionInfo> getPosition() const override
+    {
+        PositionInfo info;
+        info.setTimeInSeconds(m_time);
+        info.setIsPlaying(true);
+        info.setBpm(120.0);
+        return info;
+    }
+
+    void advance(int numSamples) { m_time += numSamples / TEST_SAMPLE_RATE; }
+
+private:
+    double m_time = 0.0;
+};
+
+struct Scenario
+{
+    const char* name;
+    bool bSoundfont;
+    // Every reverb type in turn, with a different send per channel
+    bool bReverb;
+    // Every GS synth program in turn, instead of the programs below
+    bool bAllGSPrograms;
+    int programs[TEST_NUM_CHANNELS];
+};
+
+const Scenario s_scenarios[] = {
+    // PWM, saw and triangle programs of bank 0, there without a soundfont
+    { "gs_synths", false, false, false, { 80, 83, 84, 81, 88, 93, 98, 85 } },
+    { "gs_programs", false, false, true, {} },
+    { "reverb", false, true, false, { 80, 83, 84, 81, 88, 93, 98, 85 } },
+    { "soundfont", true, false, false, {
+        static_cast<int>(ETestProgram::Looped),
+        static_cast<int>(ETestProgram::OneShot8Bit),
+        static_cast<int>(ETestProgram::KeySplit),
+        static_cast<int>(ETestProgram::FixedPitch),
+        static_cast<int>(ETestProgram::GBSquare),
+        static_cast<int>(ETestProgram::KeySplit),
+        static_cast<int>(ETestProgram::GBSquare),
+        static_cast<int>(ETestProgram::Looped) } },
+};
+
+// PWM, saw and triangle programs, each with its own wave loop
+const int s_gsPrograms[] = {
+    80, 81, 82, 85, 86, 87, 90, 91, 92, 95, 96, 97,
+    83, 88, 93, 98,
+    84, 89, 94, 99,
+};
+
+int getNote(int block, int channel)
+{
+    return 48 + (block * 7 + channel * 5) % 24;
+}
+
+void addEvents(juce::MidiBuffer& midi, const Scenario& scenario, int block)
+{
+    for (int channel = 1; channel <= TEST_NUM_CHANNELS; channel++)
+    {
+        // Three programs per channel, so that each GS program is played
+        if (scenario.bAllGSPrograms && block % TEST_PROGRAM_BLOCKS == 0)
+        {
+            const auto program = s_gsPrograms[(channel - 1 + TEST_NUM_CHANNELS * (block / TEST_PROGRAM_BLOCKS)) % static_cast<int>(std::size(s_gsPrograms))];
+            midi.addEvent(juce::MidiMessage::programChange(channel, program), 0);
+        }
+
+        if (block == 0)
+        {
+            if (!scenario.bAllGSPrograms)
+                midi.addEvent(juce::MidiMessage::programChange(channel, scenario.programs[channel - 1]), 0);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 7, 100), 0);
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 10, 16 * channel - 8), 0);
+
+            if (scenario.bReverb)
+                midi.addEvent(juce::MidiMessage::controllerEvent(channel, 91, 24 + channel * 12), 0);
+        }
+
+        // Each note is held for three blocks, released at any point of a sub-frame
+        if ((block + channel) % 5 == 0)
+        {
+            const auto velocity = static_cast<juce::uint8>(60 + (block * 13 + channel * 7) % 60);
+            midi.addEvent(juce::MidiMessage::noteOn(channel, getNote(block, channel), velocity), (channel * 37 + block * 53) % TEST_BLOCK_SIZE);
+        }
+        else if ((block - 3 + channel) % 5 == 0 && block >= 3)
+        {
+            midi.addEvent(juce::MidiMessage::noteOff(channel, getNote(block - 3, channel)), (channel * 91 + block * 29) % TEST_BLOCK_SIZE);
+        }
+
+        if (channel % 2 == 1)
+            midi.addEvent(juce::MidiMessage::controllerEvent(channel, 7, 40 + (block * 11 + channel * 3) % 87), (block * 61 + channel * 17) % TEST_BLOCK_SIZE);
+    }
+
+    if (block % 4 == 2)
+        midi.addEvent(juce::MidiMessage::pitchWheel(2, (block * 1500) % 16384), TEST_BLOCK_SIZE / 3);
+
+    if (block == 10)
+        midi.addEvent(juce::MidiMessage::controllerEvent(3, 1, 64), 100);
+
+    if (block == 1)
+        midi.addEvent(juce::MidiMessage::controllerEvent(1, 91, 64), 0);
+}
+
+// The soundfont is loaded on the presets thread
+bool waitForSoundfont(Processor& processor, const std::string& path, bool bMapped)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        const auto* set = processor.getPresets().getPublishedPresetSet();
+        if (set && set->m_settings.soundFontPath == path && set->m_settings.bMappedSoundfont == bMapped && set->m_soundfont)
+            return true;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+// Interleaved stereo output, empty if the soundfont couldn't be loaded
+std::vector<float> render(const Scenario& scenario, const juce::File& soundfont, bool bMapped)
+{
+    Processor processor;
+
+    if (scenario.bSoundfont)
+    {
+        const auto path = soundfont.getFullPathName().toStdString();
+        processor.setMappedSoundfont(bMapped);
+        processor.setSoundfont(path);
+        if (!waitForSoundfont(processor, path, bMapped))
+            return {};
+    }
+
+    processor.setRateAndBufferSizeDetails(TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+    processor.prepareToPlay(TEST_SAMPLE_RATE, TEST_BLOCK_SIZE);
+
+    TestPlayHead playHead;
+    processor.setPlayHead(&playHead);
+
+    juce::AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+    juce::MidiBuffer midi;
+    std::vector<float> output;
+    output.reserve(TEST_NUM_BLOCKS * TEST_BLOCK_SIZE * 2);
+
+    for (int block = 0; block < TEST_NUM_BLOCKS; block++)
+    {
+        // Default, GS1, GS2 then MGAT
+        if (scenario.bReverb && block % (TEST_NUM_BLOCKS / 4) == 0)
+            processor.applyReverbToAllChannels(static_cast<EReverbType>(1 + block / (TEST_NUM_BLOCKS / 4)));
+
+        midi.clear();
+        addEvents(midi, scenario, block);
+        buffer.clear();
+
+        processor.processBlock(buffer, midi);
+        playHead.advance(TEST_BLOCK_SIZE);
+
+        for (int i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            output.push_back(buffer.getSample(0, i));
+            output.push_back(buffer.getSample(1, i));
+        }
+    }
+
+    processor.setPlayHead(nullptr);
+    processor.releaseResources();
+    return output;
+}
+
+bool compare(const char* name, const std::vector<float>& output, const juce::MemoryBlock& reference)
+{
+    if (reference.getSize() != output.size() * sizeof(float))
+    {
+        std::printf("%s: %d bytes of reference for %d samples\n", name, static_cast<int>(reference.getSize()), static_cast<int>(output.size()));
+        return false;
+    }
+
+    const auto* referenceSamples = static_cast<const char*>(reference.getData());
+    size_t numDifferences = 0;
+    for (size_t i = 0; i < output.size(); i++)
+    {
+        // Bitwise: the output must be identical, not just close
+        float expected;
+        std::memcpy(&expected, referenceSamples + i * sizeof(float), sizeof(float));
+        if (std::memcmp(&expected, &output[i], sizeof(float)) == 0)
+            continue;
+
+        if (numDifferences == 0)
+        {
+            const auto frame = static_cast<int>(i / 2);
+            std::printf("%s: first difference in block %d, sample %d, %s side: %.9g instead of %.9g\n", name,
+                frame / TEST_BLOCK_SIZE, frame % TEST_BLOCK_SIZE, i % 2 == 0 ? "left" : "right", output[i], expected);
+        }
+        numDifferences++;
+    }
+
+    std::printf("%s: %d samples, %d different\n", name, static_cast<int>(output.size()), static_cast<int>(numDifferences));
+    return numDifferences == 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::printf("Usage: RenderReferenceTest <reference directory> [--write]\n");
+        return 1;
+    }
+
+    // juce::File wants an absolute path
+    const auto referenceDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argv[1]);
+    const bool bWrite = (argc > 2 && std::strcmp(argv[2], "--write") == 0);
+
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    // The reference is the scalar path: the SIMD kernels sum in a different order
+    setSIMDMode(ESIMDMode::Scalar);
+
+    const auto soundfont = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("GoldenSunVST_test.sf2");
+    if (!writeTestSoundfont(soundfont))
+    {
+        std::printf("Can't write %s\n", soundfont.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    bool bSuccess = true;
+    for (const auto& scenario : s_scenarios)
+    {
+        const auto referenceFile = referenceDirectory.getChildFile(juce::String(scenario.name) + ".raw");
+        juce::MemoryBlock reference;
+        if (!bWrite && !referenceFile.loadFileAsData(reference))
+        {
+            std::printf("%s: no reference at %s\n", scenario.name, referenceFile.getFullPathName().toRawUTF8());
+            bSuccess = false;
+            continue;
+        }
+
+        // The memory-mapped loading mode must give the same output
+        for (bool bMapped : { false, true })
+        {
+            if (bMapped && (!scenario.bSoundfont || bWrite))
+                continue;
+
+            const auto name = juce::String(scenario.name) + (bMapped ? " (mapped)" : "");
+            const auto output = render(scenario, soundfont, bMapped);
+            if (output.empty())
+            {
+                std::printf("%s: the soundfont wasn't loaded\n", name.toRawUTF8());
+                bSuccess = false;
+                continue;
+            }
+
+            if (bWrite)
+                bSuccess &= referenceFile.replaceWithData(output.data(), output.size() * sizeof(float));
+            else
+                bSuccess &= compare(name.toRawUTF8(), output, reference);
+        }
+    }
+
+    return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,482 @@
+#include <JuceHeader.h>
+
+#include "Processor/DSPKernels.h"
+#include "Processor/Resampler.h"
+#include "Processor/SampleInstrument.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+/*
+ * Compares LinearResampler::Process, which reads its source through the fixed-size fetch window,
+ * sample for sample with the resampler it replaced, which grew and erased a vector of fetched samples.
+ * Then compares LinearResampler::ProcessDirect, which reads guarded soundfont samples in place,
+ * with Process reading the same samples through the fetch callback.
+ * Each source is played in blocks of varying sizes until its end, for every kernel set of the CPU.
+ */
+
+#define TEST_SOURCE_LENGTH 3000
+#define TEST_MAX_BLOCKS 400
+
+namespace {
+
+using namespace GSVST;
+
+// Source of the fetch callbacks, read as SampleInstrument reads the SF2 samples
+struct TestSource
+{
+    std::vector<float> left;
+    std::vector<float> right;
+    uint32_t loopPos = 0;
+    uint32_t endPos = 0;
+    bool loopEnabled = false;
+    uint32_t pos = 0;
+};
+
+struct SourceSettings
+{
+    const char* name;
+    uint32_t loopPos;
+    uint32_t endPos;
+    bool loopEnabled;
+};
+
+const SourceSettings s_sources[] = {
+    { "one-shot", 0, TEST_SOURCE_LENGTH, false },
+    { "looped", 1000, 2600, true },
+    // Wraps several times within a single fetch
+    { "short loop", 40, 43, true },
+};
+
+// Output samples per call, the render sub-frame being 185 samples at 44100 Hz
+const size_t s_blockSizes[] = { 185, 256, 1, 64, 17, 512, 185, 2 };
+
+// Ratios beyond 512 / 256 need several passes of the fetch window
+const float s_phaseIncs[] = { 0.25f, 0.5f, 0.7937f, 1.0f, 1.3348f, 1.9999f, 3.7f, 9.5f, 31.3f };
+
+TestSource createSource(const SourceSettings& settings)
+{
+    TestSource source;
+    source.loopPos = settings.loopPos;
+    source.endPos = settings.endPos;
+    source.loopEnabled = settings.loopEnabled;
+
+    // Noise on the right side, so that any offset between the two paths shows
+    uint32_t seed = 12345;
+    for (int i = 0; i < TEST_SOURCE_LENGTH; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        source.left.push_back(std::sin(static_cast<float>(i) * 0.05f) * 0.8f);
+        source.right.push_back(static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+    }
+
+    return source;
+}
+
+/*
+ * The linear resampler before the fetch window, and its SF2 sample callback.
+ * Kept as it was, as the reference of the fetch window.
+ */
+typedef bool (*vector_fetch_cb)(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata);
+
+class VectorLinearResampler
+{
+public:
+    bool Process(sample* outData, size_t numBlocks, float phaseInc, vector_fetch_cb cbPtr, void* cbdata)
+    {
+        if (numBlocks == 0)
+            return true;
+
+        size_t samplesRequired = static_cast<size_t>(
+                phase + phaseInc * static_cast<float>(numBlocks));
+        // be sure and fetch one more sample in case of odd rounding errors
+        samplesRequired += 1;
+        // fetch one more for linear interpolation
+        samplesRequired += 1;
+        bool result = cbPtr(fetchBuffer, samplesRequired, cbdata);
+
+        auto getSample = [&](float& a, float& b)
+        {
+            return (a + phase * (b - a));
+        };
+
+        int i = 0;
+        do {
+            float sampleLeft = getSample(fetchBuffer[i].left, fetchBuffer[i + 1].left);
+            float sampleRight = getSample(fetchBuffer[i].right, fetchBuffer[i + 1].right);
+
+            phase += phaseInc;
+            int istep = static_cast<int>(phase);
+            phase -= static_cast<float>(istep);
+            i += istep;
+
+            outData->left = sampleLeft;
+            outData->right = sampleRight;
+            outData++;
+        } while (--numBlocks > 0);
+
+        // remove first i elements from the fetch buffer since they are no longer needed
+        fetchBuffer.erase(fetchBuffer.begin(), fetchBuffer.begin() + i);
+
+        return result;
+    }
+
+private:
+    std::vector<sample> fetchBuffer;
+    float phase = 0.0f;
+};
+
+bool vectorFetchCallback(std::vector<sample>& fetchBuffer, size_t samplesRequired, void* cbdata)
+{
+    if (fetchBuffer.size() >= samplesRequired)
+        return true;
+    auto* source = static_cast<TestSource*>(cbdata);
+    size_t samplesToFetch = samplesRequired - fetchBuffer.size();
+    size_t i = fetchBuffer.size();
+    fetchBuffer.resize(samplesRequired);
+
+    do {
+        size_t samplesTilLoop = source->endPos - source->pos;
+        size_t thisFetch = std::min(samplesTilLoop, samplesToFetch);
+
+        samplesToFetch -= thisFetch;
+        do {
+            fetchBuffer[i].left = source->left[source->pos];
+            fetchBuffer[i].right = source->right[source->pos];
+
+            source->pos++;
+            i++;
+        } while (--thisFetch > 0);
+
+        if (source->pos >= source->endPos)
+        {
+            if (source->loopEnabled) {
+                source->pos = source->loopPos;
+            }
+            else {
+                std::fill(fetchBuffer.begin() + i, fetchBuffer.end(), sample());
+                return false;
+            }
+        }
+    } while (samplesToFetch > 0);
+    return true;
+}
+
+// SampleInstrument::sampleFetchCallback for float samples
+bool windowFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata)
+{
+    if (fetchBuffer.size() >= samplesRequired)
+        return true;
+    auto* source = static_cast<TestSource*>(cbdata);
+    size_t samplesToFetch = samplesRequired - fetchBuffer.size();
+
+    do {
+        size_t samplesTilLoop = source->endPos - source->pos;
+        size_t thisFetch = std::min(samplesTilLoop, samplesToFetch);
+
+        samplesToFetch -= thisFetch;
+        for (size_t k = 0; k < thisFetch; k++)
+            fetchBuffer.push(source->left[source->pos + k], source->right[source->pos + k]);
+        source->pos += static_cast<uint32_t>(thisFetch);
+
+        if (source->pos >= source->endPos)
+        {
+            if (source->loopEnabled) {
+                source->pos = source->loopPos;
+            }
+            else {
+                while (fetchBuffer.size() < samplesRequired)
+                    fetchBuffer.push(0.0f, 0.0f);
+                return false;
+            }
+        }
+    } while (samplesToFetch > 0);
+    return true;
+}
+
+bool isSameSample(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Plays the source with both resamplers until the end of the stream, or TEST_MAX_BLOCKS calls
+bool compareFetchWindow(const SourceSettings& settings, float phaseInc)
+{
+    auto vectorSource = createSource(settings);
+    auto windowSource = createSource(settings);
+
+    VectorLinearResampler vectorResampler;
+    LinearResampler windowResampler;
+
+    std::vector<sample> expected(512);
+    std::vector<float> left(512);
+    std::vector<float> right(512);
+
+    for (int call = 0; call < TEST_MAX_BLOCKS; call++)
+    {
+        const auto numBlocks = s_blockSizes[call % std::size(s_blockSizes)];
+
+        const bool bExpectedRunning = vectorResampler.Process(expected.data(), numBlocks, phaseInc, vectorFetchCallback, &vectorSource);
+        const bool bRunning = windowResampler.Process({ left.data(), right.data() }, numBlocks, phaseInc, windowFetchCallback, &windowSource);
+
+        for (size_t i = 0; i < numBlocks; i++)
+        {
+            if (!isSameSample(left[i], expected[i].left) || !isSameSample(right[i], expected[i].right))
+            {
+                std::printf("%s, ratio %g: call %d, sample %d: (%.9g, %.9g) instead of (%.9g, %.9g)\n", settings.name, phaseInc, call,
+                    static_cast<int>(i), left[i], right[i], expected[i].left, expected[i].right);
+                return false;
+            }
+        }
+
+        if (bRunning != bExpectedRunning)
+        {
+            std::printf("%s, ratio %g: call %d ends the stream %s\n", settings.name, phaseInc, call, bRunning ? "late" : "early");
+            return false;
+        }
+
+        // A voice is killed at the end of its stream
+        if (!bRunning)
+            break;
+    }
+
+    return true;
+}
+
+// Guarded samples of a DirectSource, as PresetsHandler copies them out of the soundfont
+struct GuardedSource
+{
+    std::vector<float> samplesFloat;
+    std::vector<int16_t> samples16;
+    std::vector<int8_t> samples8;
+    DirectSource source;
+};
+
+template <typename T>
+void appendGuardedSamples(std::vector<T>& samples, const std::vector<int16_t>& src, int scale, const SourceSettings& settings)
+{
+    for (uint32_t i = 0; i < settings.endPos; i++)
+        samples.push_back(static_cast<T>(src[i] / scale));
+
+    // What the resampler reads after the end: the loop start, or silence
+    for (uint32_t i = 0; i < SAMPLE_GUARD_SIZE; i++)
+    {
+        if (settings.loopEnabled)
+            samples.push_back(static_cast<T>(src[settings.loopPos + i % (settings.endPos - settings.loopPos)] / scale));
+        else
+            samples.push_back(0);
+    }
+}
+
+GuardedSource createGuardedSource(const SourceSettings& settings, ESampleFormat format)
+{
+    // Int8 samples are in the high byte of the soundfont samples
+    std::vector<int16_t> src;
+    uint32_t seed = 6789;
+    for (int i = 0; i < TEST_SOURCE_LENGTH; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const auto value = static_cast<int>(std::sin(static_cast<float>(i) * 0.07f) * 20000.0f) + static_cast<int>(seed >> 20) - 2048;
+        src.push_back(static_cast<int16_t>(format == ESampleFormat::Int8 ? value & ~0xFF : value));
+    }
+
+    GuardedSource guarded;
+    guarded.source.format = format;
+    guarded.source.loopPos = settings.loopPos;
+    guarded.source.endPos = settings.endPos;
+    guarded.source.loopEnabled = settings.loopEnabled;
+
+    switch (format)
+    {
+    case ESampleFormat::Float:
+        appendGuardedSamples(guarded.samplesFloat, src, 1, settings);
+        for (auto& value : guarded.samplesFloat)
+            value /= SOUNDFONT_SAMPLE_DIVISOR;
+        guarded.source.data = guarded.samplesFloat.data();
+        break;
+    case ESampleFormat::Int16:
+        appendGuardedSamples(guarded.samples16, src, 1, settings);
+        guarded.source.data = guarded.samples16.data();
+        guarded.source.divisor = SOUNDFONT_SAMPLE_DIVISOR;
+        break;
+    case ESampleFormat::Int8:
+        appendGuardedSamples(guarded.samples8, src, 256, settings);
+        guarded.source.data = guarded.samples8.data();
+        guarded.source.divisor = SOUNDFONT_SAMPLE_DIVISOR;
+        break;
+    }
+
+    return guarded;
+}
+
+struct DirectFetchSource
+{
+    const DirectSource* source;
+    uint32_t pos = 0;
+};
+
+// SampleInstrument::sampleFetchCallback for mono samples, which never reads the guard samples
+bool directFetchCallback(FetchWindow& fetchBuffer, size_t samplesRequired, void* cbdata)
+{
+    if (fetchBuffer.size() >= samplesRequired)
+        return true;
+    auto* fetchSource = static_cast<DirectFetchSource*>(cbdata);
+    const auto& source = *fetchSource->source;
+    const auto& kernels = getDSPKernels();
+    size_t samplesToFetch = samplesRequired - fetchBuffer.size();
+
+    do {
+        size_t samplesTilLoop = source.endPos - fetchSource->pos;
+        size_t thisFetch = std::min(samplesTilLoop, samplesToFetch);
+
+        samplesToFetch -= thisFetch;
+        while (thisFetch > 0)
+        {
+            float converted[64];
+            const size_t count = std::min(thisFetch, std::size(converted));
+            const auto pos = fetchSource->pos;
+
+            switch (source.format)
+            {
+            case ESampleFormat::Float:
+                std::memcpy(converted, static_cast<const float*>(source.data) + pos, count * sizeof(float));
+                break;
+            case ESampleFormat::Int16:
+                kernels.convertInt16(converted, static_cast<const int16_t*>(source.data) + pos, count, source.divisor);
+                break;
+            case ESampleFormat::Int8:
+                kernels.convertInt8(converted, static_cast<const int8_t*>(source.data) + pos, count, source.divisor);
+                break;
+            }
+
+            for (size_t k = 0; k < count; k++)
+                fetchBuffer.push(converted[k], converted[k]);
+
+            fetchSource->pos += static_cast<uint32_t>(count);
+            thisFetch -= count;
+        }
+
+        if (fetchSource->pos >= source.endPos)
+        {
+            if (source.loopEnabled) {
+                fetchSource->pos = source.loopPos;
+            }
+            else {
+                while (fetchBuffer.size() < samplesRequired)
+                    fetchBuffer.push(0.0f, 0.0f);
+                return false;
+            }
+        }
+    } while (samplesToFetch > 0);
+    return true;
+}
+
+const char* getFormatName(ESampleFormat format)
+{
+    switch (format)
+    {
+    case ESampleFormat::Float: return "float";
+    case ESampleFormat::Int16: return "int16";
+    case ESampleFormat::Int8:  return "int8";
+    }
+
+    return "";
+}
+
+// Plays the source with ProcessDirect and with Process until the end of the stream, or TEST_MAX_BLOCKS calls
+bool compareDirectRead(const SourceSettings& settings, ESampleFormat format, float phaseInc)
+{
+    const auto guarded = createGuardedSource(settings, format);
+    DirectFetchSource fetchSource { &guarded.source };
+    uint32_t directPos = 0;
+
+    LinearResampler fetchResampler;
+    LinearResampler directResampler;
+
+    std::vector<float> left(512);
+    std::vector<float> right(512);
+    std::vector<float> direct(512);
+
+    for (int call = 0; call < TEST_MAX_BLOCKS; call++)
+    {
+        const auto numBlocks = s_blockSizes[call % std::size(s_blockSizes)];
+
+        const bool bExpectedRunning = fetchResampler.Process({ left.data(), right.data() }, numBlocks, phaseInc, directFetchCallback, &fetchSource);
+        const bool bRunning = directResampler.ProcessDirect(direct.data(), numBlocks, phaseInc, guarded.source, directPos);
+
+        for (size_t i = 0; i < numBlocks; i++)
+        {
+            if (!isSameSample(direct[i], left[i]) || !isSameSample(left[i], right[i]))
+            {
+                std::printf("%s %s, ratio %g: call %d, sample %d: %.9g instead of %.9g\n", getFormatName(format), settings.name, phaseInc,
+                    call, static_cast<int>(i), direct[i], left[i]);
+                return false;
+            }
+        }
+
+        if (bRunning != bExpectedRunning)
+        {
+            std::printf("%s %s, ratio %g: call %d ends the stream %s\n", getFormatName(format), settings.name, phaseInc,
+                call, bRunning ? "late" : "early");
+            return false;
+        }
+
+        if (!bRunning)
+            break;
+    }
+
+    return true;
+}
+
+const char* getModeName(ESIMDMode mode)
+{
+    switch (mode)
+    {
+    case ESIMDMode::Scalar: return "scalar";
+    case ESIMDMode::SSE2:   return "SSE2";
+    case ESIMDMode::AVX2:   return "AVX2";
+    default:                return "auto";
+    }
+}
+
+}
+
+int main()
+{
+    bool bSuccess = true;
+    for (auto mode : { ESIMDMode::Scalar, ESIMDMode::SSE2, ESIMDMode::AVX2 })
+    {
+        if (!isSIMDModeSupported(mode))
+            continue;
+
+        setSIMDMode(mode);
+
+        int numFailures = 0;
+        for (const auto& settings : s_sources)
+        {
+            for (float phaseInc : s_phaseIncs)
+                numFailures += compareFetchWindow(settings, phaseInc) ? 0 : 1;
+        }
+
+        std::printf("%s kernels: %d fetch window comparisons failed\n", getModeName(mode), numFailures);
+        bSuccess &= numFailures == 0;
+
+        numFailures = 0;
+        for (auto format : { ESampleFormat::Float, ESampleFormat::Int16, ESampleFormat::Int8 })
+        {
+            for (const auto& settings : s_sources)
+            {
+                for (float phaseInc : s_phaseIncs)
+                    numFailures += compareDirectRead(settings, format, phaseInc) ? 0 : 1;
+            }
+        }
+
+        std::printf("%s kernels: %d direct read comparisons failed\n", getModeName(mode), numFailures);
+        bSuccess &= numFailures == 0;
+    }
+
+    return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,368 @@
+#include "TestSoundfont.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GSVST {
+
+namespace {
+
+// SF2 generator operators
+#define GEN_ATTACK_VOL_ENV 34
+#define GEN_DECAY_VOL_ENV 36
+#define GEN_SUSTAIN_VOL_ENV 37
+#define GEN_RELEASE_VOL_ENV 38
+#define GEN_INSTRUMENT 41
+#define GEN_KEY_RANGE 43
+#define GEN_SAMPLE_ID 53
+#define GEN_SAMPLE_MODES 54
+#define GEN_SCALE_TUNING 56
+
+// Zero samples the specification requires after each sample
+#define SAMPLE_PADDING 46
+
+struct TestSample
+{
+    std::string name;
+    std::vector<int16_t> data;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    uint32_t sampleRate = 22050;
+    uint8_t originalPitch = 60;
+};
+
+struct SampleHeader
+{
+    std::string name;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    uint32_t sampleRate = 22050;
+    uint8_t originalPitch = 60;
+};
+
+typedef std::vector<std::pair<uint16_t, uint16_t>> Generators;
+
+struct TestInstrument
+{
+    std::string name;
+    // One zone per sample, its generators coming before the sample id
+    std::vector<std::pair<Generators, uint16_t>> zones;
+};
+
+class RiffWriter
+{
+public:
+    void writeU8(uint8_t value) { m_data.push_back(static_cast<char>(value)); }
+    void writeU16(uint16_t value) { writeU8(value & 0xFF); writeU8(value >> 8); }
+    void writeU32(uint32_t value) { writeU16(value & 0xFFFF); writeU16(value >> 16); }
+    void writeFourCC(const char* id) { m_data.insert(m_data.end(), id, id + 4); }
+
+    // Zero padded to 20 bytes
+    void writeName(const std::string& name)
+    {
+        for (size_t i = 0; i < 20; i++)
+            writeU8(i < name.size() ? static_cast<uint8_t>(name[i]) : 0);
+    }
+
+    // Returns the position of the size, written by endChunk
+    size_t beginChunk(const char* id)
+    {
+        writeFourCC(id);
+        writeU32(0);
+        return m_data.size() - 4;
+    }
+
+    size_t beginList(const char* id, const char* type)
+    {
+        const auto sizePos = beginChunk(id);
+        writeFourCC(type);
+        return sizePos;
+    }
+
+    void endChunk(size_t sizePos)
+    {
+        const auto size = static_cast<uint32_t>(m_data.size() - sizePos - 4);
+        for (int i = 0; i < 4; i++)
+            m_data[sizePos + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+
+        if (size % 2 != 0)
+            writeU8(0);
+    }
+
+    const std::vector<char>& getData() const { return m_data; }
+
+private:
+    std::vector<char> m_data;
+};
+
+int16_t toInt16(double value)
+{
+    return static_cast<int16_t>(std::lround(std::max(-32767.0, std::min(32767.0, value))));
+}
+
+std::vector<TestSample> createSamples()
+{
+    const double pi = 3.14159265358979323846;
+    std::vector<TestSample> samples(7);
+
+    // Three periods looped after a short attack, with low bytes so that it stays 16-bit
+    samples[0].name = "looped";
+    for (int i = 0; i < 400; i++)
+        samples[0].data.push_back(toInt16(12000.0 * std::sin(2.0 * pi * i / 100.0) + 3000.0 * std::sin(6.0 * pi * i / 100.0) + (i * 7) % 13));
+    samples[0].loopStart = 100;
+    samples[0].loopEnd = 400;
+
+    samples[1].name = "oneshot 8bit";
+    samples[1].sampleRate = 13379;
+    for (int i = 0; i < 600; i++)
+        samples[1].data.push_back(static_cast<int16_t>(((i * 5) % 200 - 100) * (600 - i) / 600 * 256));
+
+    samples[2].name = "split low";
+    samples[2].sampleRate = 16000;
+    samples[2].originalPitch = 48;
+    for (int i = 0; i < 256; i++)
+        samples[2].data.push_back(toInt16(20000.0 * (1.0 - std::abs(i - 128) / 64.0)));
+    samples[2].loopEnd = 256;
+
+    samples[3].name = "split high";
+    samples[3].sampleRate = 32000;
+    samples[3].originalPitch = 72;
+    for (int i = 0; i < 128; i++)
+        samples[3].data.push_back(toInt16(-15000.0 + 30000.0 * i / 128.0));
+    samples[3].loopEnd = 128;
+
+    samples[4].name = "fixed";
+    samples[4].sampleRate = 11025;
+    uint32_t noise = 12345;
+    for (int i = 0; i < 300; i++)
+    {
+        noise = noise * 1103515245 + 12345;
+        samples[4].data.push_back(static_cast<int16_t>((noise >> 16) & 0x3FFF) - 0x2000);
+    }
+    samples[4].loopEnd = 300;
+
+    samples[5].name = "square 50%";
+    for (int i = 0; i < 64; i++)
+        samples[5].data.push_back(i < 32 ? 16000 : -16000);
+    samples[5].loopEnd = 64;
+
+    // Last in the chunk: its loop end is moved past it
+    samples[6].name = "late loop";
+    for (int i = 0; i < 200; i++)
+        samples[6].data.push_back(toInt16(10000.0 * std::sin(2.0 * pi * i / 50.0)));
+    samples[6].loopStart = 50;
+    samples[6].loopEnd = 200;
+
+    return samples;
+}
+
+}
+
+bool writeTestSoundfont(const juce::File& file)
+{
+    const auto samples = createSamples();
+
+    // Sample chunk, and the headers pointing into it
+    std::vector<int16_t> smpl;
+    std::vector<SampleHeader> headers;
+    for (const auto& testSample : samples)
+    {
+        SampleHeader header;
+        header.name = testSample.name;
+        header.start = static_cast<uint32_t>(smpl.size());
+        header.end = header.start + static_cast<uint32_t>(testSample.data.size());
+        header.loopStart = header.start + testSample.loopStart;
+        header.loopEnd = header.start + testSample.loopEnd;
+        header.sampleRate = testSample.sampleRate;
+        header.originalPitch = testSample.originalPitch;
+        headers.push_back(header);
+
+        smpl.insert(smpl.end(), testSample.data.begin(), testSample.data.end());
+        smpl.insert(smpl.end(), SAMPLE_PADDING, 0);
+    }
+
+    const auto smplCount = static_cast<uint32_t>(smpl.size());
+    headers[6].loopEnd = smplCount + 1000;
+
+    // Out of the chunk, and looping before its start
+    SampleHeader pastEnd = headers[0];
+    pastEnd.name = "past end";
+    pastEnd.start = smplCount + 100;
+    pastEnd.end = smplCount + 300;
+    pastEnd.loopStart = pastEnd.start;
+    pastEnd.loopEnd = pastEnd.end;
+    headers.push_back(pastEnd);
+
+    SampleHeader loopBeforeStart = headers[0];
+    loopBeforeStart.name = "loop before start";
+    loopBeforeStart.start = headers[0].start + 200;
+    loopBeforeStart.loopStart = headers[0].start + 20;
+    headers.push_back(loopBeforeStart);
+
+    const uint16_t fullKeyRange = 0 | (127 << 8);
+    const Generators looped = { { GEN_SAMPLE_MODES, 1 }, { GEN_RELEASE_VOL_ENV, static_cast<uint16_t>(-1200) } };
+
+    // Same order as ETestProgram
+    std::vector<TestInstrument> instruments;
+    instruments.push_back({ "Looped", { { looped, 0 } } });
+    instruments.push_back({ "One shot 8-bit", { { { { GEN_RELEASE_VOL_ENV, static_cast<uint16_t>(-2400) } }, 1 } } });
+    instruments.push_back({ "Key split", {
+        { { { GEN_KEY_RANGE, 0 | (59 << 8) }, { GEN_SAMPLE_MODES, 1 } }, 2 },
+        { { { GEN_KEY_RANGE, 60 | (127 << 8) }, { GEN_SAMPLE_MODES, 1 } }, 3 } } });
+    instruments.push_back({ "Fixed pitch", { { { { GEN_SAMPLE_MODES, 1 }, { GEN_SCALE_TUNING, 0 } }, 4 } } });
+    // 0.2s attack, 1.4s decay, 10dB sustain and 0.4s release: 1, 2, 5 and 2 as CGB envelope steps
+    instruments.push_back({ "GB square", { { { { GEN_SAMPLE_MODES, 1 }, { GEN_ATTACK_VOL_ENV, static_cast<uint16_t>(-2786) },
+        { GEN_DECAY_VOL_ENV, 583 }, { GEN_SUSTAIN_VOL_ENV, 100 }, { GEN_RELEASE_VOL_ENV, static_cast<uint16_t>(-1586) } }, 5 } } });
+    instruments.push_back({ "Out of range", {
+        { { { GEN_KEY_RANGE, fullKeyRange }, { GEN_SAMPLE_MODES, 1 } }, 7 },
+        { { { GEN_KEY_RANGE, fullKeyRange }, { GEN_SAMPLE_MODES, 1 } }, 8 },
+        { { { GEN_KEY_RANGE, fullKeyRange }, { GEN_SAMPLE_MODES, 1 } }, 6 } } });
+
+    RiffWriter writer;
+    const auto riff = writer.beginList("RIFF", "sfbk");
+
+    const auto info = writer.beginList("LIST", "INFO");
+    const auto ifil = writer.beginChunk("ifil");
+    writer.writeU16(2);
+    writer.writeU16(1);
+    writer.endChunk(ifil);
+    const auto inam = writer.beginChunk("INAM");
+    for (char c : std::string("GoldenSunVST test"))
+        writer.writeU8(static_cast<uint8_t>(c));
+    writer.writeU8(0);
+    writer.endChunk(inam);
+    writer.endChunk(info);
+
+    const auto sdta = writer.beginList("LIST", "sdta");
+    const auto smplChunk = writer.beginChunk("smpl");
+    for (auto value : smpl)
+        writer.writeU16(static_cast<uint16_t>(value));
+    writer.endChunk(smplChunk);
+    writer.endChunk(sdta);
+
+    const auto pdta = writer.beginList("LIST", "pdta");
+
+    // One preset zone per instrument
+    auto chunk = writer.beginChunk("phdr");
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        writer.writeName(instruments[i].name);
+        writer.writeU16(static_cast<uint16_t>(i));
+        writer.writeU16(0);
+        writer.writeU16(static_cast<uint16_t>(i));
+        writer.writeU32(0);
+        writer.writeU32(0);
+        writer.writeU32(0);
+    }
+    writer.writeName("EOP");
+    writer.writeU16(0);
+    writer.writeU16(0);
+    writer.writeU16(static_cast<uint16_t>(instruments.size()));
+    writer.writeU32(0);
+    writer.writeU32(0);
+    writer.writeU32(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("pbag");
+    for (size_t i = 0; i <= instruments.size(); i++)
+    {
+        writer.writeU16(static_cast<uint16_t>(i));
+        writer.writeU16(0);
+    }
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("pmod");
+    for (int i = 0; i < 10; i++)
+        writer.writeU8(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("pgen");
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        writer.writeU16(GEN_INSTRUMENT);
+        writer.writeU16(static_cast<uint16_t>(i));
+    }
+    writer.writeU32(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("inst");
+    uint16_t numZones = 0;
+    for (const auto& instrument : instruments)
+    {
+        writer.writeName(instrument.name);
+        writer.writeU16(numZones);
+        numZones += static_cast<uint16_t>(instrument.zones.size());
+    }
+    writer.writeName("EOI");
+    writer.writeU16(numZones);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("ibag");
+    uint16_t numGenerators = 0;
+    for (const auto& instrument : instruments)
+    {
+        for (const auto& zone : instrument.zones)
+        {
+            writer.writeU16(numGenerators);
+            writer.writeU16(0);
+            numGenerators += static_cast<uint16_t>(zone.first.size() + 1);
+        }
+    }
+    writer.writeU16(numGenerators);
+    writer.writeU16(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("imod");
+    for (int i = 0; i < 10; i++)
+        writer.writeU8(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("igen");
+    for (const auto& instrument : instruments)
+    {
+        for (const auto& zone : instrument.zones)
+        {
+            for (const auto& generator : zone.first)
+            {
+                writer.writeU16(generator.first);
+                writer.writeU16(generator.second);
+            }
+            writer.writeU16(GEN_SAMPLE_ID);
+            writer.writeU16(zone.second);
+        }
+    }
+    writer.writeU32(0);
+    writer.endChunk(chunk);
+
+    chunk = writer.beginChunk("shdr");
+    for (const auto& header : headers)
+    {
+        writer.writeName(header.name);
+        writer.writeU32(header.start);
+        writer.writeU32(header.end);
+        writer.writeU32(header.loopStart);
+        writer.writeU32(header.loopEnd);
+        writer.writeU32(header.sampleRate);
+        writer.writeU8(header.originalPitch);
+        writer.writeU8(0);
+        writer.writeU16(0);
+        writer.writeU16(1);
+    }
+    writer.writeName("EOS");
+    for (int i = 0; i < 26; i++)
+        writer.writeU8(0);
+    writer.endChunk(chunk);
+
+    writer.endChunk(pdta);
+    writer.endChunk(riff);
+
+    const auto& data = writer.getData();
+    return file.replaceWithData(data.data(), data.size());
+}
+
+}
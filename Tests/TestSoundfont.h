@@ -0,0 +1,28 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace GSVST {
+
+// Programs of bank 0 in the test soundfont
+enum class ETestProgram : int
+{
+    // 16-bit sample, looped
+    Looped = 0,
+    // 8-bit sample stored in the high byte, as the GBA rippers do, played once
+    OneShot8Bit,
+    // Two looped samples split at middle C, each with its own root key
+    KeySplit,
+    // Played at its sample rate whatever the note
+    FixedPitch,
+    // "square 50%" sample, replaced by a CGB square channel
+    GBSquare,
+    // Regions starting past the sample chunk or looping before their start, which are skipped,
+    // and one looping past the end of the chunk
+    OutOfRange,
+};
+
+// Writes a small SF2 file with the ETestProgram presets, the samples being generated
+bool writeTestSoundfont(const juce::File& file);
+
+}